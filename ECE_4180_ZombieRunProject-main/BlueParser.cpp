@@ -0,0 +1,203 @@
+#include "BlueParser.h"
+#include "Profiler.h"
+
+static bool
+decode_button(const char *p, BlueEvent *evt)
+{
+    if (p[0] < '1' || p[0] > '8' || (p[1] != '0' && p[1] != '1')) return false;
+    evt->button = p[0];
+    evt->pressed = (p[1] == '1');
+    return true;
+}
+
+static bool
+decode_colour(const char *p, BlueEvent *evt)
+{
+    for (int i = 0; i < 3; i++) evt->rgb[i] = (uint8_t)p[i];
+    return true;
+}
+
+// Floats are byte copied through the union, never read through a cast
+// pointer: the payload is at odd offsets and the M3 faults on unaligned
+// float loads.
+static bool
+decode_floats(const char *p, int n, BlueEvent *evt)
+{
+    union f_or_char x;
+    
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < 4; j++) x.c[j] = p[i * 4 + j];
+        // NaN is not equal to itself, infinity is bigger than any float.
+        if (x.f != x.f || x.f > 3.4e38f || x.f < -3.4e38f) return false;
+        evt->v[i] = x.f;
+    }
+    return true;
+}
+
+static bool
+decode_xyz(const char *p, BlueEvent *evt)
+{
+    return decode_floats(p, 3, evt);
+}
+
+static bool
+decode_quaternion(const char *p, BlueEvent *evt)
+{
+    return decode_floats(p, 4, evt);
+}
+
+static bool
+decode_location(const char *p, BlueEvent *evt)
+{
+    if (!decode_floats(p, 3, evt)) return false;
+    return evt->v[0] >= -90.0f && evt->v[0] <= 90.0f && evt->v[1] >= -180.0f && evt->v[1] <= 180.0f;
+}
+
+// Whole packet lengths by type, '!' and checksum included.
+static const struct {
+    char type;
+    int  len;
+    bool (*decode)(const char *payload, BlueEvent *evt);
+} packet_types[] = {
+    { 'B',  5, decode_button },     // control pad button: number, '1' pressed / '0' released
+    { 'C',  6, decode_colour },     // colour picker: r, g, b
+    { 'L', 15, decode_location },   // location: lat, lon, alt floats
+    { 'A', 15, decode_xyz },        // accelerometer
+    { 'G', 15, decode_xyz },        // gyro
+    { 'M', 15, decode_xyz },        // magnetometer
+    { 'Q', 19, decode_quaternion }, // quaternion: x, y, z, w floats
+};
+
+static int
+packet_entry(char type)
+{
+    for (int i = 0; i < (int)(sizeof(packet_types) / sizeof(packet_types[0])); i++) {
+        if (packet_types[i].type == type) return i;
+    }
+    return -1;
+}
+
+BlueParser::BlueParser(RawSerial &serial) : _serial(serial), _thread(osPriorityAboveNormal, 1024)
+{
+    _head = _tail = 0;
+    _len = _want = 0;
+    _packets = _errors = _invalid = _overflows = _dropped = 0;
+}
+
+void
+BlueParser::start(void)
+{
+    _thread.start(mbed::Callback<void()>(this, &BlueParser::run));
+    _serial.attach(mbed::Callback<void()>(this, &BlueParser::rx_irq), SerialBase::RxIrq);
+}
+
+void
+BlueParser::rx_irq(void)
+{
+    PROFILE_ISR(profileIsrBlueRx);
+    while (_serial.readable()) {
+        char c = _serial.getc();
+        uint32_t next = (_head + 1) & (BLUE_RX_BUFFER - 1);
+        if (next == _tail) {
+            _overflows++;
+        } else {
+            _rx[_head] = c;
+            _head = next;
+        }
+    }
+    _thread.signal_set(BLUE_SIG_RX);
+}
+
+void
+BlueParser::run(void)
+{
+    Profiler::attach("bluefruit", &_thread);
+    while (1) {
+        Thread::signal_wait(BLUE_SIG_RX);
+        while (_tail != _head) {
+            char c = _rx[_tail];
+            _tail = (_tail + 1) & (BLUE_RX_BUFFER - 1);
+            feed(c);
+        }
+    }
+}
+
+void
+BlueParser::feed(char c)
+{
+    if (_len == 0) {
+        // Hunting for the start of a packet.
+        if (c == '!') _pkt[_len++] = c;
+        return;
+    }
+    
+    _pkt[_len++] = c;
+    if (_len == 2) {
+        _entry = packet_entry(c);
+        if (_entry < 0) {
+            resync();
+            return;
+        }
+        _want = packet_types[_entry].len;
+        return;
+    }
+    if (_len < _want) return;
+    
+    char sum = 0;
+    for (int i = 0; i < _len - 1; i++) sum += _pkt[i];
+    if ((char)~sum == _pkt[_len - 1]) {
+        deliver();
+        _len = 0;
+    } else {
+        _errors++;
+        resync();
+    }
+}
+
+// Drop the packet start and run what followed it back through from the
+// next '!'. That is at most one packet of bytes, so this only recurses
+// as deep as the packet is long.
+void
+BlueParser::resync(void)
+{
+    char held[BLUE_MAX_PACKET];
+    int n = _len;
+    int i;
+    
+    memcpy(held, _pkt, n);
+    _len = 0;
+    for (i = 1; i < n && held[i] != '!'; i++);
+    for (; i < n; i++) feed(held[i]);
+}
+
+void
+BlueParser::deliver(void)
+{
+    BlueEvent *evt = _events.calloc(0);
+    
+    if (evt == NULL) {
+        _dropped++;
+        return;
+    }
+    evt->type = _pkt[1];
+    evt->stamp_us = us_ticker_read();
+    if (!packet_types[_entry].decode(&_pkt[2], evt)) {
+        _events.free(evt);
+        _invalid++;
+        return;
+    }
+    _events.put(evt);
+    _packets++;
+}
+
+bool
+BlueParser::get(BlueEvent *evt, uint32_t ms)
+{
+    osEvent e = _events.get(ms);
+    
+    if (e.status != osEventMail) return false;
+    BlueEvent *p = (BlueEvent *)e.value.p;
+    *evt = *p;
+    _events.free(p);
+    return true;
+}
@@ -0,0 +1,137 @@
+#ifndef BLUE_PARSER_H
+#define BLUE_PARSER_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+// Receive ring, must be a power of two. 64 bytes is over 60ms at 9600 baud.
+#ifndef BLUE_RX_BUFFER
+#define BLUE_RX_BUFFER 64
+#endif
+
+// Parsed packets waiting for the game.
+#ifndef BLUE_EVENTS
+#define BLUE_EVENTS 8
+#endif
+
+// Longest packet, '!' + type + payload + checksum.
+#define BLUE_MAX_PACKET 21
+
+// Signal from the RX interrupt to the parser thread.
+#define BLUE_SIG_RX 0x1
+
+// Floats arrive as four little endian bytes, the same as ours.
+union f_or_char {
+    float f;
+    char  c[4];
+};
+
+/** A packet from the Bluefruit Connect app.
+ *
+ * Which fields are set depends on the type:
+ * - 'B' control pad: button, pressed.
+ * - 'C' colour picker: rgb.
+ * - 'L' location: v[0] latitude, v[1] longitude (degrees),
+ *   v[2] altitude (m).
+ * - 'A' accelerometer (m/s/s), 'G' gyro (rad/s), 'M' magnetometer
+ *   (uT): v[0..2] x, y, z.
+ * - 'Q' quaternion: v[0..3] x, y, z, w.
+ */
+struct BlueEvent {
+    //! Packet type.
+    char type;
+    //! Button '1'..'8'.
+    char button;
+    //! True when pressed, false when released.
+    bool pressed;
+    //! Colour.
+    uint8_t rgb[3];
+    //! Sensor values.
+    float v[4];
+    //! us_ticker_read() when the packet was complete.
+    uint32_t stamp_us;
+};
+
+/** BlueParser reads Bluefruit Connect packets from a serial port.
+ *
+ * The RX interrupt only copies bytes into a ring and signals the parser
+ * thread, which sleeps until then. The thread runs the bytes through a
+ * state machine that keeps its place between calls, so a packet can
+ * arrive in any number of pieces, and posts each packet whose checksum
+ * is good to a Mail queue. Packet lengths and decoders come from one
+ * table, a payload that decodes to nonsense (a button that isn't one, a
+ * float that isn't finite) is thrown away as well. If a byte is lost
+ * the checksum fails and the parser restarts from the next '!' it has
+ * already seen, not from the next one on the wire, so one lost byte
+ * costs one packet.
+ *
+ * Example:
+ * @code
+ * RawSerial blue(p13, p14);
+ * BlueParser bluefruit(blue);
+ * BlueEvent evt;
+ *
+ * bluefruit.start();
+ * while (bluefruit.get(&evt)) {
+ *     if (evt.type == 'B' && evt.pressed) myled = evt.button - '0';
+ * }
+ * @endcode
+ */
+class BlueParser {
+public:
+
+    BlueParser(RawSerial &serial);
+    
+    //! Attach the RX interrupt and start the parser thread.
+    void start(void);
+    
+    //! Wait up to ms for a packet, false on timeout.
+    bool get(BlueEvent *evt, uint32_t ms = osWaitForever);
+    
+    //! Run one byte through the parser, the parser thread calls this.
+    void feed(char c);
+    
+    //! Packets delivered.
+    uint32_t packets(void) { return _packets; }
+    
+    //! Packets with a bad checksum.
+    uint32_t errors(void) { return _errors; }
+    
+    //! Packets with a good checksum but a payload that made no sense.
+    uint32_t invalid(void) { return _invalid; }
+    
+    //! Bytes lost because the ring was full.
+    uint32_t overflows(void) { return _overflows; }
+    
+    //! Packets lost because nobody was reading them.
+    uint32_t dropped(void) { return _dropped; }
+
+protected:
+
+    RawSerial &_serial;
+    Thread    _thread;
+    Mail<BlueEvent, BLUE_EVENTS> _events;
+    
+    // Written by the RX interrupt only.
+    char              _rx[BLUE_RX_BUFFER];
+    volatile uint32_t _head;
+    volatile uint32_t _overflows;
+    
+    // Parser thread only.
+    volatile uint32_t _tail;
+    char     _pkt[BLUE_MAX_PACKET];
+    int      _len;
+    int      _want;
+    int      _entry;
+    uint32_t _packets;
+    uint32_t _errors;
+    uint32_t _invalid;
+    uint32_t _dropped;
+    
+    void rx_irq(void);
+    void run(void);
+    void deliver(void);
+    void resync(void);
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "CourseEngine.h"
+
+// mm per 1e-7 degree of latitude (mean earth radius 6371 km).
+#define MM_PER_E7_LAT 11.1194926f
+#define DEG_TO_RAD    0.01745329252f
+
+CourseEngine::CourseEngine(float max_hdop, float uere)
+{
+    _max_hdop_x10 = (int)(max_hdop * 10.0f + 0.5f);
+    _uere_mm = (int32_t)(uere * 100.0f + 0.5f);
+    reset();
+}
+
+void
+CourseEngine::clear(void)
+{
+    _started = false;
+    _locked = false;
+    _lat0 = 0;
+    _lon0 = 0;
+    _ky = 0;
+    _kx = 0;
+    _ue = 0;
+    _un = 0;
+    _length_mm = 0;
+    _progress_mm = 0;
+    _best_mm = 0;
+    _cross_mm = 0;
+    _rejected = 0;
+}
+
+void
+CourseEngine::reset(void)
+{
+    clear();
+    _mode = courseAuto;
+}
+
+void
+CourseEngine::reset(float bearing)
+{
+    clear();
+    _mode = courseBearing;
+    _bearing = bearing;
+}
+
+void
+CourseEngine::reset(int32_t lat_e7, int32_t lon_e7)
+{
+    clear();
+    _mode = courseWaypoint;
+    _wp_lat = lat_e7;
+    _wp_lon = lon_e7;
+}
+
+// Offset from the start in mm, equirectangular about the start.
+void
+CourseEngine::to_mm(int32_t lat_e7, int32_t lon_e7, int32_t *e, int32_t *n)
+{
+    *n = (int32_t)(((int64_t)(lat_e7 - _lat0) * _ky) >> 16);
+    *e = (int32_t)(((int64_t)(lon_e7 - _lon0) * _kx) >> 16);
+}
+
+// Point the course along (e, n) mm.
+void
+CourseEngine::direction(int32_t e, int32_t n)
+{
+    float len = sqrtf((float)e * (float)e + (float)n * (float)n);
+    
+    _ue = (int32_t)((float)e * 16384.0f / len);
+    _un = (int32_t)((float)n * 16384.0f / len);
+    _locked = true;
+}
+
+void
+CourseEngine::start(int32_t lat_e7, int32_t lon_e7)
+{
+    int32_t e, n;
+    float b;
+    
+    _lat0 = lat_e7;
+    _lon0 = lon_e7;
+    _ky = (int32_t)(MM_PER_E7_LAT * 65536.0f);
+    _kx = (int32_t)(MM_PER_E7_LAT * 65536.0f * cosf((float)lat_e7 * 1.0e-7f * DEG_TO_RAD));
+    _started = true;
+    
+    switch (_mode) {
+        case courseBearing:
+            b = _bearing * DEG_TO_RAD;
+            _ue = (int32_t)(sinf(b) * 16384.0f);
+            _un = (int32_t)(cosf(b) * 16384.0f);
+            _locked = true;
+            break;
+        case courseWaypoint:
+            to_mm(_wp_lat, _wp_lon, &e, &n);
+            if (e || n) {
+                direction(e, n);
+                _length_mm = (int32_t)sqrtf((float)e * (float)e + (float)n * (float)n);
+            }
+            break;
+    }
+}
+
+bool
+CourseEngine::update(int32_t lat_e7, int32_t lon_e7, int hdop_x10, int quality)
+{
+    int32_t e, n, margin;
+    
+    if (quality == 0 || hdop_x10 <= 0 || hdop_x10 > _max_hdop_x10) {
+        _rejected++;
+        return false;
+    }
+    
+    if (!_started) {
+        start(lat_e7, lon_e7);
+        return true;
+    }
+    
+    to_mm(lat_e7, lon_e7, &e, &n);
+    
+    if (!_locked) {
+        // Compare squares, no root until the course is set.
+        int64_t lock = (int64_t)(COURSE_LOCK_M * 1000.0f);
+        if ((int64_t)e * e + (int64_t)n * n < lock * lock) return true;
+        direction(e, n);
+    }
+    
+    _progress_mm = (int32_t)(((int64_t)e * _ue + (int64_t)n * _un) >> 14);
+    _cross_mm    = (int32_t)(((int64_t)e * _un - (int64_t)n * _ue) >> 14);
+    
+    // Jitter forward must not count, only a move beyond the noise radius.
+    margin = hdop_x10 * _uere_mm;
+    if (_progress_mm - _best_mm > margin) _best_mm = _progress_mm;
+    return true;
+}
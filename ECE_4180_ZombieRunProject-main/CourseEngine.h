@@ -0,0 +1,124 @@
+#ifndef COURSE_ENGINE_H
+#define COURSE_ENGINE_H
+
+#include "mbed.h"
+
+// Fixes with a worse HDOP than this are not used at all.
+#ifndef COURSE_MAX_HDOP
+#define COURSE_MAX_HDOP 4.0f
+#endif
+
+// User equivalent range error, metres of horizontal error per unit of HDOP.
+#ifndef COURSE_UERE_M
+#define COURSE_UERE_M   2.5f
+#endif
+
+// With no bearing given, the course follows the first move this far from the start.
+#ifndef COURSE_LOCK_M
+#define COURSE_LOCK_M   10.0f
+#endif
+
+/** CourseEngine measures progress along a straight course.
+ *
+ * Summing hops (even gated ones, see DistanceEngine) credits zig-zags
+ * and jitter as distance. Here the first good fix after reset() is the
+ * start and progress is the fix's offset from it projected onto the
+ * course direction, so only ground made good towards the safe zone
+ * counts. The direction is a bearing, a waypoint, or (the default) the
+ * direction of the player's first COURSE_LOCK_M metres.
+ *
+ * best() only moves forward, so it must not follow the noise: like the
+ * DistanceEngine anchor it is raised to a fix's progress only once that
+ * is further than the fix's noise radius, HDOP * UERE, beyond it. A
+ * player standing still stays put, one running is credited in steps
+ * and best() lags the true progress by at most a noise radius.
+ *
+ * The projection is set up once with trig in float, after that each fix
+ * is integer only: 1e-7 degree deltas scaled to mm, a dot product with
+ * a Q14 unit vector and the margin from the HDOP in tenths. There is no
+ * trig or floating point in update(), so a replay on any host gives the
+ * same numbers as the target.
+ *
+ * Example:
+ * @code
+ * CourseEngine course;
+ * GPS_Geodetic fix;
+ *
+ * course.reset();
+ * gps.geodetic(&fix);
+ * course.update(fix.lat_e7, fix.lon_e7, (int)(fix.hdop * 10.0 + 0.5), fix.gps_satellite_quality);
+ * pc.printf("%.1f m made good\r\n", course.best());
+ * @endcode
+ */
+class CourseEngine {
+public:
+
+    CourseEngine(float max_hdop = COURSE_MAX_HDOP, float uere = COURSE_UERE_M);
+    
+    //! Forget the start, the course follows the player's first move.
+    void reset(void);
+    
+    //! Forget the start, the course runs on a bearing (degrees true).
+    void reset(float bearing);
+    
+    //! Forget the start, the course runs to a waypoint.
+    void reset(int32_t lat_e7, int32_t lon_e7);
+    
+    //! Feed one fix, the HDOP in tenths, returns true if it was used.
+    bool update(int32_t lat_e7, int32_t lon_e7, int hdop_x10, int quality);
+    
+    //! Metres along the course at the last fix (negative if behind the start).
+    float progress(void) { return (float)_progress_mm * 0.001f; }
+    
+    //! The furthest metres along the course surely reached since reset().
+    float best(void) { return (float)_best_mm * 0.001f; }
+    
+    //! Metres off the course at the last fix, + is to the right.
+    float crossTrack(void) { return (float)_cross_mm * 0.001f; }
+    
+    //! Metres to the waypoint along the course, 0 without one.
+    float remaining(void) { return _length_mm ? (float)(_length_mm - _progress_mm) * 0.001f : 0.0f; }
+    
+    //! True once the course has a start and a direction.
+    bool locked(void) { return _locked; }
+    
+    //! Number of fixes rejected on quality/HDOP since reset().
+    int rejected(void) { return _rejected; }
+
+protected:
+
+    enum courseMode { courseAuto = 0, courseBearing, courseWaypoint };
+
+    //! Worst HDOP used, in tenths.
+    int     _max_hdop_x10;
+    //! UERE in mm per tenth of HDOP.
+    int32_t _uere_mm;
+    int     _mode;
+    float   _bearing;
+    int32_t _wp_lat;
+    int32_t _wp_lon;
+    
+    bool    _started;
+    bool    _locked;
+    int32_t _lat0;
+    int32_t _lon0;
+    //! mm per 1e-7 degree north and east at the start, Q16.
+    int32_t _ky;
+    int32_t _kx;
+    //! Course unit vector east and north, Q14.
+    int32_t _ue;
+    int32_t _un;
+    int32_t _length_mm;
+    
+    int32_t _progress_mm;
+    int32_t _best_mm;
+    int32_t _cross_mm;
+    int     _rejected;
+    
+    void clear(void);
+    void start(int32_t lat_e7, int32_t lon_e7);
+    void to_mm(int32_t lat_e7, int32_t lon_e7, int32_t *e, int32_t *n);
+    void direction(int32_t e, int32_t n);
+};
+
+#endif
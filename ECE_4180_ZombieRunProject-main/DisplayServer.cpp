@@ -0,0 +1,142 @@
+#include "DisplayServer.h"
+#include "Profiler.h"
+
+DisplayServer::DisplayServer(uLCD_4DGL &lcd, RawSerial &pc) : _lcd(lcd), _pc(pc), _thread(osPriorityBelowNormal, 1536)
+{
+    _npending = 0;
+    _posted = _dropped = _drawn = _coalesced = 0;
+    _max_depth = 0;
+    _max_latency = _last_latency = 0;
+}
+
+void
+DisplayServer::start(void)
+{
+    _thread.start(mbed::Callback<void()>(this, &DisplayServer::run));
+}
+
+bool
+DisplayServer::screen(int background, int foreground, char size, const char *format, ...)
+{
+    va_list args;
+    bool ok;
+    
+    va_start(args, format);
+    ok = post(true, DISPLAY_SLOT_SCREEN, displayHigh, background, foreground, size, format, args);
+    va_end(args);
+    return ok;
+}
+
+bool
+DisplayServer::log(uint8_t slot, const char *format, ...)
+{
+    va_list args;
+    bool ok;
+    
+    va_start(args, format);
+    ok = post(false, slot, displayLow, 0, 0, 0, format, args);
+    va_end(args);
+    return ok;
+}
+
+bool
+DisplayServer::post(bool screen, uint8_t slot, uint8_t priority, int background, int foreground, char size, const char *format, va_list args)
+{
+    DisplayRequest *r = _mail.alloc(0);
+    
+    if (r == NULL) {
+        __disable_irq();
+        _dropped++;
+        __enable_irq();
+        return false;
+    }
+    r->screen = screen;
+    r->slot = slot;
+    r->priority = priority;
+    r->background = background;
+    r->foreground = foreground;
+    r->size = size;
+    vsnprintf(r->text, DISPLAY_TEXT, format, args);
+    r->queued_us = us_ticker_read();
+    __disable_irq();
+    _posted++;
+    __enable_irq();
+    _mail.put(r);
+    return true;
+}
+
+// Move one request from the mail into the list, replacing a waiting
+// one for the same slot. False if there was nothing or no room.
+bool
+DisplayServer::take(uint32_t ms)
+{
+    DisplayRequest *dst = NULL;
+    osEvent evt;
+    
+    if (_npending == DISPLAY_QUEUE) return false;
+    evt = _mail.get(ms);
+    if (evt.status != osEventMail) return false;
+    DisplayRequest *r = (DisplayRequest *)evt.value.p;
+    
+    if (r->slot != DISPLAY_SLOT_NONE) {
+        for (int i = 0; i < _npending; i++) {
+            if (_pending[i].slot == r->slot) {
+                dst = &_pending[i];
+                _coalesced++;
+                break;
+            }
+        }
+    }
+    if (dst == NULL) dst = &_pending[_npending++];
+    *dst = *r;
+    _mail.free(r);
+    
+    // Everything posted and not yet drawn.
+    int depth = (int)(_posted - _drawn - _coalesced);
+    if (depth > _max_depth) _max_depth = depth;
+    return true;
+}
+
+void
+DisplayServer::draw(const DisplayRequest *r)
+{
+    if (r->screen) {
+        _lcd.background_color(r->background);
+        _lcd.cls();
+        _lcd.color(r->foreground);
+        _lcd.text_width(r->size);
+        _lcd.text_height(r->size);
+        _lcd.printf("%s", r->text);
+    } else {
+        _pc.puts(r->text);
+    }
+}
+
+void
+DisplayServer::run(void)
+{
+    Profiler::attach("display", &_thread);
+    int best;
+    
+    while (1) {
+        if (_npending == 0) take(osWaitForever);
+        while (take(0));
+        if (_npending == 0) continue;
+        
+        // Highest priority first, then the order they were posted.
+        best = 0;
+        for (int i = 1; i < _npending; i++) {
+            if (_pending[i].priority > _pending[best].priority ||
+                (_pending[i].priority == _pending[best].priority &&
+                 (int32_t)(_pending[i].queued_us - _pending[best].queued_us) < 0)) {
+                best = i;
+            }
+        }
+        draw(&_pending[best]);
+        
+        _last_latency = us_ticker_read() - _pending[best].queued_us;
+        if (_last_latency > _max_latency) _max_latency = _last_latency;
+        _drawn++;
+        _pending[best] = _pending[--_npending];
+    }
+}
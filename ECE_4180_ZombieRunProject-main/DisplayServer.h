@@ -0,0 +1,117 @@
+#ifndef DISPLAY_SERVER_H
+#define DISPLAY_SERVER_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "uLCD_4DGL.h"
+
+// Requests that can be waiting, posts beyond this are dropped.
+#ifndef DISPLAY_QUEUE
+#define DISPLAY_QUEUE 8
+#endif
+
+// Longest text in one request, longer is cut short.
+#ifndef DISPLAY_TEXT
+#define DISPLAY_TEXT 192
+#endif
+
+// Coalescing slots: a request replaces a waiting one with the same slot.
+#define DISPLAY_SLOT_SCREEN 0   // every full screen, only the newest matters
+#define DISPLAY_SLOT_STATUS 1   // the GPS status line on pc
+#define DISPLAY_SLOT_NONE   0xFF
+
+enum displayPriority {
+    displayLow = 0,
+    displayHigh
+};
+
+/** One thing to draw. */
+struct DisplayRequest {
+    //! True for a uLCD screen, false for a line on pc.
+    bool     screen;
+    uint8_t  slot;
+    uint8_t  priority;
+    //! Screen colours and text size.
+    int      background;
+    int      foreground;
+    char     size;
+    uint32_t queued_us;
+    char     text[DISPLAY_TEXT];
+};
+
+/** DisplayServer owns the uLCD and the pc port.
+ *
+ * Other threads post requests and carry on: posting formats into a Mail
+ * slot without waiting and drops the request if the queue is full. The
+ * server thread drains the queue into its own list, where a request
+ * replaces an older one for the same slot (a screen nobody saw yet is
+ * not worth drawing), then draws the highest priority, oldest first.
+ * It drains again before every draw so a late high priority screen
+ * overtakes waiting pc lines.
+ *
+ * The server runs below normal priority, the slow 9600 baud uLCD never
+ * holds up the GPS thread, and nothing else takes a lock on it.
+ *
+ * Example:
+ * @code
+ * DisplayServer display(uLCD, pc);
+ *
+ * display.start();
+ * display.screen(WHITE, GREEN, 2, "\n\nZOMBIE\nGAME");
+ * display.log(DISPLAY_SLOT_NONE, "queue %d, %u us\r\n", display.maxDepth(), display.maxLatencyUs());
+ * @endcode
+ */
+class DisplayServer {
+public:
+
+    DisplayServer(uLCD_4DGL &lcd, RawSerial &pc);
+    
+    //! Start the server thread.
+    void start(void);
+    
+    //! Clear the uLCD and print a screen, high priority.
+    bool screen(int background, int foreground, char size, const char *format, ...);
+    
+    //! Print a line on pc, low priority, coalesced on slot.
+    bool log(uint8_t slot, const char *format, ...);
+    
+    //! Requests posted, dropped because the queue was full, and replaced before they were drawn.
+    uint32_t posted(void) { return _posted; }
+    uint32_t dropped(void) { return _dropped; }
+    uint32_t coalesced(void) { return _coalesced; }
+    
+    //! Most requests ever waiting at once.
+    int maxDepth(void) { return _max_depth; }
+    
+    //! Longest from post to drawn, and the last one, us.
+    uint32_t maxLatencyUs(void) { return _max_latency; }
+    uint32_t lastLatencyUs(void) { return _last_latency; }
+
+protected:
+
+    uLCD_4DGL &_lcd;
+    RawSerial &_pc;
+    Thread     _thread;
+    Mail<DisplayRequest, DISPLAY_QUEUE> _mail;
+    
+    // Server thread only.
+    DisplayRequest _pending[DISPLAY_QUEUE];
+    int            _npending;
+    
+    // Any poster, counted with interrupts off.
+    volatile uint32_t _posted;
+    volatile uint32_t _dropped;
+    
+    uint32_t          _drawn;
+    uint32_t          _coalesced;
+    int               _max_depth;
+    uint32_t          _max_latency;
+    uint32_t          _last_latency;
+    
+    bool post(bool screen, uint8_t slot, uint8_t priority, int background, int foreground, char size, const char *format, va_list args);
+    bool take(uint32_t ms);
+    void draw(const DisplayRequest *r);
+    void run(void);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "DistanceEngine.h"
+
+// Metres per degree of latitude (mean earth radius 6371 km).
+#define M_PER_DEG_LAT 111194.9f
+#define DEG_TO_RAD    0.01745329252f
+
+DistanceEngine::DistanceEngine(float max_hdop, float uere)
+{
+    _max_hdop = max_hdop;
+    _uere = uere;
+    reset();
+}
+
+void
+DistanceEngine::reset(void)
+{
+    _metres = 0.0f;
+    _anchored = false;
+    _anchor_lat = 0.0;
+    _anchor_lon = 0.0;
+    _m_per_deg_lon = M_PER_DEG_LAT;
+    _rejected = 0;
+    _held = 0;
+}
+
+float
+DistanceEngine::update(double lat, double lon, double hdop, int quality)
+{
+    float dx, dy, d, noise;
+    
+    if (quality == 0 || hdop <= 0.0 || hdop > _max_hdop) {
+        _rejected++;
+        return 0.0f;
+    }
+    
+    if (!_anchored) {
+        _anchor_lat = lat;
+        _anchor_lon = lon;
+        _m_per_deg_lon = M_PER_DEG_LAT * cosf((float)lat * DEG_TO_RAD);
+        _anchored = true;
+        return 0.0f;
+    }
+    
+    // Over a few metres an equirectangular projection is exact enough
+    // and needs no trig per fix. Subtract in double, the degrees are large.
+    dy = (float)(lat - _anchor_lat) * M_PER_DEG_LAT;
+    dx = (float)(lon - _anchor_lon) * _m_per_deg_lon;
+    d  = sqrtf((dx * dx) + (dy * dy));
+    
+    noise = (float)hdop * _uere;
+    if (d < noise) {
+        _held++;
+        return 0.0f;
+    }
+    
+    _anchor_lat = lat;
+    _anchor_lon = lon;
+    _metres += d;
+    return d;
+}
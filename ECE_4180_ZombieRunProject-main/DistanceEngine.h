@@ -0,0 +1,69 @@
+#ifndef DISTANCE_ENGINE_H
+#define DISTANCE_ENGINE_H
+
+#include "mbed.h"
+
+// Fixes with a worse HDOP than this are not used at all.
+#ifndef DIST_MAX_HDOP
+#define DIST_MAX_HDOP   4.0f
+#endif
+
+// User equivalent range error, metres of horizontal error per unit of HDOP.
+#ifndef DIST_UERE_M
+#define DIST_UERE_M     2.5f
+#endif
+
+/** DistanceEngine accumulates the distance run from a stream of GGA fixes.
+ *
+ * Summing the hop between every pair of raw fixes credits the receiver's
+ * jitter as distance, a player standing still racks up tens of metres.
+ * Instead each fix is gated on its HDOP and compared with an anchor (the
+ * last credited position). A step is only credited once the player has
+ * moved further from the anchor than the noise radius of the fix,
+ * HDOP * UERE, and the anchor then moves to the new fix.
+ *
+ * Example:
+ * @code
+ * DistanceEngine dist;
+ * GPS_Geodetic fix;
+ *
+ * gps.geodetic(&fix);
+ * dist.update(fix.lat, fix.lon, fix.hdop, fix.gps_satellite_quality);
+ * pc.printf("%.1f m\r\n", dist.metres());
+ * @endcode
+ */
+class DistanceEngine {
+public:
+
+    DistanceEngine(float max_hdop = DIST_MAX_HDOP, float uere = DIST_UERE_M);
+    
+    //! Forget the anchor and zero the distance, call at the start of a run.
+    void reset(void);
+    
+    //! Feed one fix, returns the metres credited by it (0 when gated).
+    float update(double lat, double lon, double hdop, int quality);
+    
+    //! The total credited distance in metres.
+    float metres(void) { return _metres; }
+    
+    //! Number of fixes rejected on quality/HDOP since reset().
+    int rejected(void) { return _rejected; }
+    
+    //! Number of fixes inside the noise radius since reset().
+    int held(void) { return _held; }
+
+protected:
+
+    float  _max_hdop;
+    float  _uere;
+    float  _metres;
+    bool   _anchored;
+    double _anchor_lat;
+    double _anchor_lon;
+    //! Metres per degree of longitude at the anchor latitude.
+    float  _m_per_deg_lon;
+    int    _rejected;
+    int    _held;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "GameSession.h"
+#include "us_ticker_api.h"
+
+volatile uint32_t GameSession::_idle_us = 0;
+uint32_t GameSession::_window_us = 0;
+
+GameSession::GameSession() : _timer(mbed::Callback<void()>(this, &GameSession::expired), osTimerOnce)
+{
+    static const SessionInterval single = { 10000, 0 };
+    
+    _owner = (osThreadId)NULL;
+    _phase_ms = 0;
+    configure(&single, 1);
+}
+
+bool
+GameSession::configure(const SessionInterval *iv, int n)
+{
+    if (n < 1 || n > SESSION_MAX_INTERVALS) return false;
+    memcpy(_iv, iv, n * sizeof(SessionInterval));
+    _n = n;
+    return true;
+}
+
+void
+GameSession::expired(void)
+{
+    signal(SESSION_SIG_PHASE);
+}
+
+void
+GameSession::arm(uint32_t ms)
+{
+    // A phase end or catch left over from the last phase doesn't count.
+    if (_owner) osSignalClear(_owner, SESSION_SIG_PHASE | SESSION_SIG_CAUGHT);
+    _armed_us = us_ticker_read();
+    _phase_ms = ms;
+    _timer.start(ms);
+}
+
+void
+GameSession::disarm(void)
+{
+    _timer.stop();
+    _phase_ms = 0;
+}
+
+uint32_t
+GameSession::remainingMs(void)
+{
+    uint32_t gone = (us_ticker_read() - _armed_us) / 1000;
+    
+    return gone < _phase_ms ? _phase_ms - gone : 0;
+}
+
+void
+GameSession::signal(int32_t sig)
+{
+    if (_owner) osSignalSet(_owner, sig);
+}
+
+int32_t
+GameSession::waitFor(int32_t mask)
+{
+    osEvent evt;
+    
+    do {
+        evt = Thread::signal_wait(0);
+    }
+    while (evt.status != osEventSignal || !(evt.value.signals & mask));
+    return evt.value.signals & mask;
+}
+
+bool
+GameSession::sleep(uint32_t ms)
+{
+    osEvent evt = Thread::signal_wait(SESSION_SIG_QUIT, ms);
+    return evt.status == osEventSignal;
+}
+
+// Runs in the RTOS idle thread. The core clock stops in sleep so the
+// time is taken from the us ticker, which keeps counting.
+void
+GameSession::idle_hook(void)
+{
+    uint32_t t = us_ticker_read();
+    ::sleep();
+    _idle_us += us_ticker_read() - t;
+}
+
+void
+GameSession::idleStart(void)
+{
+    rtos_attach_idle_hook(&GameSession::idle_hook);
+    _idle_us = 0;
+    _window_us = us_ticker_read();
+}
+
+float
+GameSession::idlePercent(void)
+{
+    uint32_t window = us_ticker_read() - _window_us;
+    
+    if (window == 0) return 0.0f;
+    return (float)_idle_us * 100.0f / (float)window;
+}
+
+float
+GameSession::modelMa(void)
+{
+    float idle = idlePercent() * 0.01f;
+    return SESSION_ACTIVE_MA * (1.0f - idle) + SESSION_SLEEP_MA * idle;
+}
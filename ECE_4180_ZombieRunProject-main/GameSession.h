@@ -0,0 +1,122 @@
+#ifndef GAME_SESSION_H
+#define GAME_SESSION_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+// Signals sent to the thread running the session.
+#define SESSION_SIG_PHASE   0x1
+#define SESSION_SIG_QUIT    0x2
+#define SESSION_SIG_CAUGHT  0x4
+
+// Most run/rest intervals in a round.
+#define SESSION_MAX_INTERVALS 8
+
+// Board current running and sleeping, mA, for modelMa(). Nobody has
+// measured these, they are rough figures for an mbed LPC1768 at 96MHz.
+// Measure yours and set them.
+#ifndef SESSION_ACTIVE_MA
+#define SESSION_ACTIVE_MA   140.0f
+#endif
+
+#ifndef SESSION_SLEEP_MA
+#define SESSION_SLEEP_MA    110.0f
+#endif
+
+/** One interval of a round: run, then rest, in ms. */
+struct SessionInterval {
+    uint32_t run_ms;
+    uint32_t rest_ms;
+};
+
+/** GameSession times the phases of a round without polling.
+ *
+ * A round is a list of run/rest intervals, one 10 second run by default.
+ * The phase timer is a one shot RtosTimer that signals the owning thread,
+ * which sleeps in waitFor() until the phase ends or it is told to quit
+ * or that the player was caught. Nothing spins, so the RTOS idle thread
+ * runs between events and the idle hook sleeps the core there, counting
+ * how long for idlePercent().
+ *
+ * Example:
+ * @code
+ * static const SessionInterval rounds[] = { { 60000, 30000 }, { 120000, 0 } };
+ * GameSession session;
+ *
+ * session.attach(osThreadGetId());
+ * session.configure(rounds, 2);
+ * session.idleStart();
+ * session.arm(session.interval(0)->run_ms);
+ * int32_t why = session.waitFor(SESSION_SIG_PHASE | SESSION_SIG_QUIT);
+ * pc.printf("idle %.1f%%\r\n", GameSession::idlePercent());
+ * @endcode
+ */
+class GameSession {
+public:
+
+    GameSession();
+    
+    //! The thread signalled by the session.
+    void attach(osThreadId owner) { _owner = owner; }
+    
+    //! Set the intervals of a round, false if there are too many.
+    bool configure(const SessionInterval *iv, int n);
+    
+    //! Number of intervals in a round.
+    int intervals(void) { return _n; }
+    
+    //! Interval i of a round.
+    const SessionInterval *interval(int i) { return &_iv[i]; }
+    
+    //! Start the phase timer, SESSION_SIG_PHASE is sent in ms.
+    void arm(uint32_t ms);
+    
+    //! Stop the phase timer.
+    void disarm(void);
+    
+    //! ms left until the phase timer fires, 0 when it is stopped.
+    uint32_t remainingMs(void);
+    
+    //! Send a signal to the owner, safe from an ISR.
+    void signal(int32_t sig);
+    
+    //! Sleep until one of the signals in mask arrives and return it.
+    int32_t waitFor(int32_t mask);
+    
+    //! Sleep for ms, returns true if SESSION_SIG_QUIT cut it short.
+    bool sleep(uint32_t ms);
+    
+    //! Hook the RTOS idle thread and start a new idle measurement.
+    static void idleStart(void);
+    
+    //! Percentage of the time since idleStart() the core slept.
+    static float idlePercent(void);
+    
+    /** Board current since idleStart() by a model, not a measurement.
+     *
+     * The model is a mix of SESSION_ACTIVE_MA and SESSION_SLEEP_MA in
+     * the proportion the core ran and slept. It assumes those two
+     * figures are right for the board, that the core's sleep is the
+     * only thing that changes the current, and that the mbed interface
+     * chip draws the same throughout. The GPS, SD card, Bluefruit,
+     * speaker and LCD are left out.
+     */
+    static float modelMa(void);
+
+protected:
+
+    RtosTimer       _timer;
+    osThreadId      _owner;
+    SessionInterval _iv[SESSION_MAX_INTERVALS];
+    int             _n;
+    uint32_t        _armed_us;
+    uint32_t        _phase_ms;
+    
+    void expired(void);
+    
+    static void idle_hook(void);
+    static volatile uint32_t _idle_us;
+    static uint32_t _window_us;
+};
+
+#endif
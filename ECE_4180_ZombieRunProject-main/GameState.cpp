@@ -0,0 +1,21 @@
+#include "GameState.h"
+
+GameState::GameState()
+{
+    GameSettings s;
+    
+    // Four zombies at a brisk walk, as if player A chose nothing.
+    s.zombies = 4;
+    s.speed = 1.85f;
+    settings.publish(s);
+    _mode = 0;
+    _run = 0;
+    _quit = 0;
+}
+
+void
+GameState::startRun(void)
+{
+    __DMB();
+    _run = _run + 1;
+}
@@ -0,0 +1,132 @@
+#ifndef GAME_STATE_H
+#define GAME_STATE_H
+
+#include "mbed.h"
+
+/** StateLatch hands a small struct from one writer thread to any readers.
+ *
+ * There are two copies. The writer fills the one readers are not using
+ * and then flips the index, so a reader is never looking at a half
+ * written copy while the writer is parked on it. Each copy has a version
+ * that is odd while it is being written; a reader that was preempted by
+ * two whole publishes sees the version change and copies again. On one
+ * core that only happens when a higher priority writer actually ran, so
+ * a reader never spins waiting on a lower priority writer, the trap a
+ * plain seqlock falls into on an RTOS.
+ *
+ * Only one thread (or ISR) may publish to a latch.
+ */
+template <typename T>
+class StateLatch {
+public:
+
+    StateLatch() { _seq = 0; _ver[0] = _ver[1] = 0; memset(_slot, 0, sizeof(_slot)); }
+    
+    //! Make v the current value, writer only.
+    void publish(const T &v) {
+        uint32_t i = (_seq + 1) & 1;
+        _ver[i]++;
+        __DMB();
+        _slot[i] = v;
+        __DMB();
+        _ver[i]++;
+        __DMB();
+        _seq = _seq + 1;
+    }
+    
+    //! Copy out the current value, never torn.
+    void consume(T *v) const {
+        uint32_t i, ver;
+        do {
+            i = _seq & 1;
+            ver = _ver[i];
+            __DMB();
+            *v = _slot[i];
+            __DMB();
+        }
+        while ((ver & 1) || _ver[i] != ver);
+    }
+    
+    //! Number of publishes, a reader can tell it has seen them all.
+    uint32_t sequence(void) const { return _seq; }
+
+protected:
+
+    T                 _slot[2];
+    volatile uint32_t _ver[2];
+    volatile uint32_t _seq;
+};
+
+/** What player A chose, published by the Bluefruit thread. */
+struct GameSettings {
+    int   zombies;
+    float speed;
+};
+
+/** How the run is going, published by the GPS thread. */
+struct GameProgress {
+    //! Metres made good towards the safe zone.
+    float ran;
+    //! Metres to the closest zombie.
+    float gap;
+    //! Player speed, m/s.
+    float speed;
+    bool  caught;
+};
+
+/** GameState is everything the game's threads share.
+ *
+ * Each value has one writer:
+ * - settings: blue_thread_button.
+ * - progress: readGPS.
+ * - mode and run: the main game loop.
+ * - quit: the pushbutton ISR.
+ *
+ * Multi-word values go through a StateLatch. mode, run and quit are
+ * single aligned words, which the Cortex-M3 reads and writes whole.
+ * Readers are wait-free, nothing here takes a lock, so any of it can be
+ * read from an ISR.
+ *
+ * A new run is started by bumping run(); readGPS resets its engines and
+ * the progress when it sees the number change, so only it writes them.
+ *
+ * Example:
+ * @code
+ * GameState state;
+ * GameSettings set;
+ *
+ * state.settings.consume(&set);
+ * state.startRun();
+ * state.setMode(1);
+ * @endcode
+ */
+class GameState {
+public:
+
+    GameState();
+    
+    StateLatch<GameSettings> settings;
+    StateLatch<GameProgress> progress;
+    
+    //! 0 picking zombies, 1 running.
+    int mode(void) { return _mode; }
+    void setMode(int m) { _mode = m; }
+    
+    //! Number of the current run.
+    uint32_t run(void) { return _run; }
+    
+    //! Start the next run, main loop only.
+    void startRun(void);
+    
+    //! True once the quit button was pressed.
+    bool quit(void) { return _quit != 0; }
+    void setQuit(void) { _quit = 1; }
+
+protected:
+
+    volatile int32_t  _mode;
+    volatile uint32_t _run;
+    volatile int32_t  _quit;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "KalmanTracker.h"
+#include "DistanceEngine.h"
+
+#define M_PER_DEG_LAT 111194.9f
+#define DEG_TO_RAD    0.01745329252f
+#define KPH_TO_MPS    0.277777778f
+
+// Initial velocity variance, a cold start knows nothing about speed.
+#define KF_VEL_VAR0   25.0f
+
+void
+KalmanAxis::init(float pos, float pos_var, float vel_var)
+{
+    p = pos;
+    v = 0.0f;
+    P00 = pos_var;
+    P01 = 0.0f;
+    P11 = vel_var;
+}
+
+void
+KalmanAxis::predict(float dt, float q)
+{
+    float dt2 = dt * dt;
+    
+    // x = F x, P = F P F' + Q with F = [1 dt; 0 1] and a white
+    // acceleration Q = q [dt^4/4 dt^3/2; dt^3/2 dt^2].
+    p   += v * dt;
+    P00 += dt * (2.0f * P01 + dt * P11) + q * dt2 * dt2 * 0.25f;
+    P01 += dt * P11 + q * dt2 * dt * 0.5f;
+    P11 += q * dt2;
+}
+
+void
+KalmanAxis::update_pos(float z, float r)
+{
+    float s  = P00 + r;
+    float k0 = P00 / s;
+    float k1 = P01 / s;
+    float y  = z - p;
+    
+    p   += k0 * y;
+    v   += k1 * y;
+    P11 -= k1 * P01;
+    P01 *= (1.0f - k0);
+    P00 *= (1.0f - k0);
+}
+
+void
+KalmanAxis::update_vel(float z, float r)
+{
+    float s  = P11 + r;
+    float k0 = P01 / s;
+    float k1 = P11 / s;
+    float y  = z - v;
+    
+    p   += k0 * y;
+    v   += k1 * y;
+    P00 -= k0 * P01;
+    P01 *= (1.0f - k1);
+    P11 *= (1.0f - k1);
+}
+
+KalmanTracker::KalmanTracker(float accel_noise, float output_hz)
+{
+    _q = accel_noise * accel_noise;
+    setOutputRate(output_hz);
+    _max_cycles = 0;
+    _over_budget = 0;
+    _cycles = 0;
+    
+    // Enable the DWT cycle counter used to keep the updates on budget.
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    
+    reset();
+}
+
+void
+KalmanTracker::reset(void)
+{
+    _valid = false;
+    _metres = 0.0f;
+    _last_us = 0;
+    _out_us = 0;
+    _ahead = 0.0f;
+    _ahead_m = 0.0f;
+    _e.init(0.0f, 0.0f, KF_VEL_VAR0);
+    _n.init(0.0f, 0.0f, KF_VEL_VAR0);
+}
+
+float
+KalmanTracker::speed(void)
+{
+    return sqrtf((_e.v * _e.v) + (_n.v * _n.v));
+}
+
+// Move the state forward to a measurement's stamp.
+void
+KalmanTracker::propagate(uint32_t now_us)
+{
+    // Signed subtraction copes with the microsecond counter wrapping, and
+    // a measurement stamped before the last one is applied in place.
+    int32_t us = (int32_t)(now_us - _last_us);
+    float dt = (float)us * 1.0e-6f;
+    float s;
+    
+    if (us <= 0) return;
+    
+    // Distance is the integral of the filtered speed, so position jitter
+    // only counts to the extent it survives the filter.
+    s = speed();
+    if (s >= KF_MIN_SPEED) _metres += s * dt;
+    _e.predict(dt, _q);
+    _n.predict(dt, _q);
+    _last_us = now_us;
+}
+
+// From the state to the output time, nothing in the state changes.
+void
+KalmanTracker::extrapolate(void)
+{
+    int32_t us = (int32_t)(_out_us - _last_us);
+    float s = speed();
+    
+    _ahead = us > 0 ? (float)us * 1.0e-6f : 0.0f;
+    _ahead_m = s >= KF_MIN_SPEED ? s * _ahead : 0.0f;
+}
+
+void
+KalmanTracker::account(uint32_t start)
+{
+    _cycles = DWT->CYCCNT - start;
+    if (_cycles > _max_cycles) _max_cycles = _cycles;
+    if (_cycles > KF_CYCLE_BUDGET) _over_budget++;
+}
+
+bool
+KalmanTracker::position(double lat, double lon, double hdop, int quality, uint32_t now_us)
+{
+    uint32_t start = DWT->CYCCNT;
+    float sigma, r, e, n;
+    
+    if (quality == 0 || hdop <= 0.0 || hdop > DIST_MAX_HDOP) return false;
+    
+    sigma = (float)hdop * DIST_UERE_M;
+    r = sigma * sigma;
+    
+    if (!_valid) {
+        _origin_lat = lat;
+        _origin_lon = lon;
+        _m_per_deg_lon = M_PER_DEG_LAT * cosf((float)lat * DEG_TO_RAD);
+        _e.init(0.0f, r, KF_VEL_VAR0);
+        _n.init(0.0f, r, KF_VEL_VAR0);
+        _last_us = now_us;
+        _out_us = now_us;
+        _valid = true;
+        extrapolate();
+        account(start);
+        return true;
+    }
+    
+    n = (float)(lat - _origin_lat) * M_PER_DEG_LAT;
+    e = (float)(lon - _origin_lon) * _m_per_deg_lon;
+    
+    propagate(now_us);
+    _e.update_pos(e, r);
+    _n.update_pos(n, r);
+    extrapolate();
+    account(start);
+    return true;
+}
+
+bool
+KalmanTracker::velocity(double kph, double track, uint32_t now_us)
+{
+    uint32_t start = DWT->CYCCNT;
+    float mps, rad, r;
+    
+    if (!_valid) return false;
+    
+    mps = (float)kph * KPH_TO_MPS;
+    rad = (float)track * DEG_TO_RAD;
+    r   = KF_VTG_SIGMA * KF_VTG_SIGMA;
+    
+    propagate(now_us);
+    _e.update_vel(mps * sinf(rad), r);
+    _n.update_vel(mps * cosf(rad), r);
+    extrapolate();
+    account(start);
+    return true;
+}
+
+void
+KalmanTracker::advance(uint32_t now_us)
+{
+    if (!_valid) return;
+    _out_us = now_us;
+    extrapolate();
+}
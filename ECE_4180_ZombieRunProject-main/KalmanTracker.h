@@ -0,0 +1,137 @@
+#ifndef KALMAN_TRACKER_H
+#define KALMAN_TRACKER_H
+
+#include "mbed.h"
+
+// Process noise, the expected random acceleration of a runner (m/s^2).
+#ifndef KF_ACCEL_NOISE
+#define KF_ACCEL_NOISE      1.5f
+#endif
+
+// Default rate the filter is propagated and distance/speed are output at.
+#ifndef KF_OUTPUT_HZ
+#define KF_OUTPUT_HZ        5.0f
+#endif
+
+// 1-sigma error of a VTG speed over ground, metres per second.
+#ifndef KF_VTG_SIGMA
+#define KF_VTG_SIGMA        0.3f
+#endif
+
+// Below this filtered speed the player is treated as standing still.
+#ifndef KF_MIN_SPEED
+#define KF_MIN_SPEED        0.4f
+#endif
+
+// Cycles one measurement update is allowed to take on the LPC1768.
+#ifndef KF_CYCLE_BUDGET
+#define KF_CYCLE_BUDGET     4000
+#endif
+
+/** One axis of a constant velocity Kalman filter, state [position, velocity].
+ *
+ * The east and north axes of a runner are independent enough that two
+ * 2-state filters do the job of one 4-state filter at a fraction of the
+ * cost, no matrix inverse is needed, just a scalar divide per update.
+ */
+struct KalmanAxis {
+    float p;
+    float v;
+    float P00, P01, P11;
+    
+    void init(float pos, float pos_var, float vel_var);
+    void predict(float dt, float q);
+    void update_pos(float z, float r);
+    void update_vel(float z, float r);
+};
+
+/** KalmanTracker fuses GGA positions with VTG speed/heading.
+ *
+ * Positions are projected into a local east/north frame (metres) around
+ * the first accepted fix. GGA fixes update position with a noise of
+ * (HDOP * UERE)^2, VTG sentences update velocity.
+ *
+ * The state is kept at the time of the last measurement and only moves
+ * forward to the next one's stamp, integrating the filtered speed into
+ * distance on the way, so each update sees its true dt however late it
+ * is picked up. advance() sets the time outputs are wanted for, east(),
+ * north() and metres() extrapolate to it from the state; it should be
+ * called at outputPeriodMs() intervals. A measurement stamped before
+ * the last one is applied in place.
+ *
+ * Example:
+ * @code
+ * KalmanTracker kf;
+ *
+ * kf.position(fix.lat, fix.lon, fix.hdop, fix.gps_satellite_quality, now_us);
+ * kf.velocity(vtg.velocity_kph(), vtg.track_true(), now_us);
+ * kf.advance(now_us);
+ * pc.printf("%.1f m @ %.2f m/s\r\n", kf.metres(), kf.speed());
+ * @endcode
+ */
+class KalmanTracker {
+public:
+
+    KalmanTracker(float accel_noise = KF_ACCEL_NOISE, float output_hz = KF_OUTPUT_HZ);
+    
+    //! Drop the state, the next accepted fix restarts the filter.
+    void reset(void);
+    
+    //! Zero the distance without disturbing the filter, call at the start of a run.
+    void resetDistance(void) { _metres = -_ahead_m; }
+    
+    // All times are us_ticker_read() microseconds, ideally the fix
+    // timestamps from GPS_Geodetic/GPS_VTG rather than the time read.
+    
+    //! Feed a GGA fix. Returns false if it was gated out on quality/HDOP.
+    bool position(double lat, double lon, double hdop, int quality, uint32_t now_us);
+    
+    //! Feed a VTG speed (km/h) and true track (degrees).
+    bool velocity(double kph, double track, uint32_t now_us);
+    
+    //! Output for now_us, the state stays at the last measurement.
+    void advance(uint32_t now_us);
+    
+    //! Set the rate advance() is expected to be called at.
+    void setOutputRate(float hz) { _output_ms = (int)(1000.0f / hz); }
+    int  outputPeriodMs(void) { return _output_ms; }
+    
+    bool  valid(void)  { return _valid; }
+    float metres(void) { return _metres + _ahead_m; }
+    float speed(void);
+    float east(void)   { return _e.p + _e.v * _ahead; }
+    float north(void)  { return _n.p + _n.v * _ahead; }
+    
+    //! Cycles taken by the last measurement update.
+    uint32_t cycles(void) { return _cycles; }
+    //! Worst case cycles of any measurement update.
+    uint32_t maxCycles(void) { return _max_cycles; }
+    //! Number of updates that went over KF_CYCLE_BUDGET.
+    int overBudget(void) { return _over_budget; }
+
+protected:
+
+    void propagate(uint32_t now_us);
+    void extrapolate(void);
+    void account(uint32_t start);
+    
+    KalmanAxis _e;
+    KalmanAxis _n;
+    float      _q;
+    int        _output_ms;
+    bool       _valid;
+    uint32_t   _last_us;
+    uint32_t   _out_us;
+    //! From the state to the output, seconds and metres.
+    float      _ahead;
+    float      _ahead_m;
+    double     _origin_lat;
+    double     _origin_lon;
+    float      _m_per_deg_lon;
+    float      _metres;
+    uint32_t   _cycles;
+    uint32_t   _max_cycles;
+    int        _over_budget;
+};
+
+#endif
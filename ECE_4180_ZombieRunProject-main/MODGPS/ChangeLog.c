@@ -89,4 +89,83 @@
       before it gets processed (mangled).
       See setRmc(), setGga(), setVtg() and setUkn().
             
+1.17 - 18/10/2026
+
+    * Added GSA (DOP and active satellites) and GSV (satellites in view
+      with SNR) sentences. See gsa(), gsv(), pdop(), hdop() and vdop().
+    * GGA HDOP is now kept alongside the position in GPS_Geodetic, parsed
+      in the same strtok() pass as the rest of the sentence.
+    * _ukn is now initialised in the constructor.
+            
+1.18 - 18/10/2026
+
+    * Added receiver configuration, setUpdateRate(), setReceiverBaud() and
+      setSentences(), using either MTK $PMTK or u-blox UBX commands. Each
+      command waits for the ACK and is verified by reading the setting back.
+      A TX pin is needed, e.g. GPS gps(p28, p27);
+    * Added GPS_UBX, a UBX binary frame decoder run from rx_irq() so UBX
+      replies can share the UART with NMEA.
+            
+1.19 - 18/10/2026
+
+    * Every sentence is stamped with us_ticker_read() as its '\n' arrives.
+      With a 1PPS attached the stamp is corrected to PPS edge + the UTC
+      fraction of the fix. See fixTimestamp(), GPS_Geodetic::timestamp_us
+      and GPS_VTG::timestamp_us.
+    * GPS_Geodetic::seq counts GGA fixes.
+    * ppsUnattach() now clears the InterruptIn pointer it deletes.
+            
+1.20 - 18/10/2026
+
+    * Added UBX NAV-PVT as an alternative to the NMEA sentences, see
+      setUbxPvt(). The binary solution is decoded straight into the
+      geodetic/VTG/time data and raises the GGA/VTG/RMC callbacks.
+            
+1.21 - 18/10/2026
+
+    * convert_lat_coord()/convert_lon_coord() no longer assume exactly
+      four decimal minutes. They parse any length into the new integer
+      lat_e7/lon_e7 (1e-7 degree) with integer ops only, the doubles are
+      one multiply from those. A malformed field keeps the last value.
+            
+1.22 - 18/10/2026
+
+    * Added GPS_Log, records the received bytes and 1PPS edges with
+      their receive time, and GPS_Replay to feed a recording back in at
+      real time, faster, or as fast as possible with the original stamps.
+    * rx_irq() split into rx_byte(), pps_irq() into pps_event() and the
+      sentence handling out of ticktock() into poll() so a replay takes
+      the same path as the UART.
+            
+1.23 - 18/10/2026
+
+    * Added GPS_Bench, DWT cycle timing of any sentence parser over a
+      corpus of good and malformed sentences, and example4.cpp using it.
+    * nmea_gga() and nmea_rmc() no longer dereference NULL when a
+      sentence is short of fields, nmea_rmc() checks the time/date length.
+            
+1.24 - 18/10/2026
+
+    * GPS_Time now runs on a 64 bit ms count since 1970. The 10ms tick
+      is one add and carries into the seconds, a 1PPS edge snaps to the
+      nearest second (ppsEdge()). The fields are filled by timeNow() or
+      decompose(), set() and compose() go the other way.
+    * Fixed the date never wrapping from month 13 back to January.
+    * julian_date() was half a day early, to_C_tm() no longer uses mktime().
+            
+1.25 - 18/10/2026
+
+    * Added GPS_Time::gmstDegrees(), sidereal time worked out once per
+      time fix and advanced with the clock after that. siderealDegrees()
+      and siderealHA() on a GPS_Time use it.
+    * siderealDegrees(NULL, lon) used the current time of a new, leaked
+      GPS_Time (always 01/01/2000). It now means this object.
+            
+1.26 - 18/10/2026
+
+    * The RTC is no longer set from the 10ms ticker. rtcDiscipline(),
+      called from a low priority thread, steps the RTC on a GPS second
+      boundary when it is far out, otherwise trims its rate with the
+      calibration register. rtcStats() returns the drift figures.
+            
 */
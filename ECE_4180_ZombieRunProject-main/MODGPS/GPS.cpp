@@ -21,6 +21,8 @@
 */
 
 #include "GPS.h"
+#include "Profiler.h"
+#include "us_ticker_api.h"
 
 int _uidx = 1;
 
@@ -36,6 +38,17 @@ GPS::GPS(PinName tx, PinName rx, const char *name) : Serial(tx, rx, name)
     
     _vtg = (char *)NULL;
     
+    _ukn = (char *)NULL;
+    
+    _txInUse = (tx != NC);
+    _cfgProto = cfgPMTK;
+    _baudrate = 9600;
+    _ubxAck = 0;
+    _ubxRespReady = false;
+    _pmtkAckCmd = 0;
+    _pmtkAckFlag = 0;
+    _pmtkRespReady = false;
+    
     switch(_uidx) {
         case 1:   _base = LPC_UART1; break;
         case 2:   _base = LPC_UART2; break;
@@ -45,6 +58,21 @@ GPS::GPS(PinName tx, PinName rx, const char *name) : Serial(tx, rx, name)
     
     _pps = NULL;
     _ppsInUse = false;
+    _ppsStamp = 0;
+    _ppsSeen = false;
+    _vtgPending = false;
+    _vtgRxStamp = 0;
+    _pvtReady = false;
+    _pvtCount = 0;
+    _dopH = 0;
+    _dopItow = 0;
+    _dopSeen = false;
+    memset(&_rtc, 0, sizeof(GPS_RtcStats));
+    _rtcSynced = false;
+    rtc_fit_reset(0, 0);
+    _log = (GPS_Log *)NULL;
+    _rxLive = true;
+    _polling = false;
     
     if (_base != NULL) attach(this, &GPS::rx_irq);
     
@@ -66,7 +94,9 @@ void
 GPS::ppsUnattach(void) 
 {
     if (_pps != NULL) delete(_pps);
+    _pps = NULL;
     _ppsInUse = false;
+    _ppsSeen = false;
 }
     
 double 
@@ -125,17 +155,126 @@ GPS::vtg(GPS_VTG *q)
     return q;
 }
 
+double 
+GPS::hdop(void)  
+{ 
+    double a, b;
+    do { a = thePlace.hdop; b = thePlace.hdop; } while (a != b);
+    return a; 
+}
+
+GPS_GSA *
+GPS::gsa(GPS_GSA *q)
+{
+    GPS_GSA a;
+    
+    if (q == NULL) q = new GPS_GSA;
+    
+    do {
+        memcpy(&a, &theGSA, sizeof(GPS_GSA));
+        memcpy(q,  &theGSA, sizeof(GPS_GSA));
+    }
+    while (memcmp(&a, q, sizeof(GPS_GSA)) != 0);
+    
+    return q;
+}
+
+GPS_GSV *
+GPS::gsv(GPS_GSV *q)
+{
+    GPS_GSV a;
+    
+    if (q == NULL) q = new GPS_GSV;
+    
+    do {
+        memcpy(&a, &theGSV, sizeof(GPS_GSV));
+        memcpy(q,  &theGSV, sizeof(GPS_GSV));
+    }
+    while (memcmp(&a, q, sizeof(GPS_GSV)) != 0);
+    
+    return q;
+}
+
+uint32_t
+GPS::fixTimestamp(uint32_t rx_us, int ms, bool *locked)
+{
+    uint32_t pps = _ppsStamp;
+    uint32_t fix;
+    
+    *locked = false;
+    if (!_ppsSeen || ms < 0) return rx_us;
+    
+    // The PPS edge marks the top of the second the fix belongs to. If the
+    // sentence ends after the next edge (high rates, long sentences) the
+    // last edge is one second too late.
+    fix = pps + (uint32_t)ms * 1000;
+    if ((int32_t)(rx_us - fix) < 0) fix -= 1000000;
+    
+    if ((uint32_t)(rx_us - fix) > GPS_PPS_MAX_LATENCY) return rx_us;
+    *locked = true;
+    return fix;
+}
+
 void
 GPS::ticktock(void)
 {
-    int i;
+    // The sentence parsing and callbacks below are part of its time.
+    PROFILE_ISR(profileIsrGpsTick);
     
     // Increment the time structure by 1/100th of a second.
     ++theTime; 
     
-    // Test the serial queue.
+    // Test the serial queue, unless poll() is already doing so.
+    if (!_polling) process_sentence();
+}
+
+void
+GPS::poll(void)
+{
+    // ticktock() is an interrupt so it either runs to completion before
+    // this sees the flag or sees the flag and leaves the buffer alone.
+    _polling = true;
+    process_sentence();
+    _polling = false;
+}
+
+// Stamp the waiting VTG, from its GGA when paired, and hand it out.
+void
+GPS::vtg_release(bool paired)
+{
+    if (paired) {
+        theVTG.timestamp_us = thePlace.timestamp_us;
+        theVTG.pps_locked = thePlace.pps_locked;
+    }
+    else {
+        theVTG.timestamp_us = _vtgRxStamp;
+        theVTG.pps_locked = false;
+    }
+    _vtgPending = false;
+    cb_vtg.call();
+}
+
+void
+GPS::process_sentence(void)
+{
+    int i;
+    uint32_t rx_us;
+    bool locked;
+    
+    // A binary solution waiting to be decoded.
+    if (_pvtReady) {
+        nav_pvt(_pvt.payload, _pvtStamp);
+        _pvtReady = false;
+    }
+    
     if (process_required) {
         char *s = buffer[active_buffer == 0 ? 1 : 0];
+        rx_us = buffer_stamp[active_buffer == 0 ? 1 : 0];
+        // A VTG whose GGA didn't come in time. Going by the stamps, not
+        // us_ticker, keeps a replay at any speed the same.
+        if (_vtgPending && (uint32_t)(rx_us - _vtgRxStamp) >= GPS_EPOCH_WINDOW) {
+            vtg_release(false);
+        }
         if (!strncmp(s, "$GPRMC", 6)) {
             if (_rmc) {
                 for(i = 0; s[i] != '\n'; i++) {
@@ -143,9 +282,12 @@ GPS::ticktock(void)
                 }
                 _rmc[i++] = '\n'; _rmc[i] = '\0';
             }
+            // A 5 or 10Hz RMC has its own fraction, only a whole second
+            // one is squared up to the second. Read before strtok().
+            bool whole = GPS_Time::nmea_ms(s + 7) <= 0;
             theTime.nmea_rmc(s);
             cb_rmc.call();
-            if (!_ppsInUse) theTime.fractionalReset();
+            if (!_ppsInUse && whole) theTime.fractionalReset();
         }
         else if (!strncmp(s, "$GPGGA", 6)) {
             if (_gga) {
@@ -154,8 +296,15 @@ GPS::ticktock(void)
                 }
                 _gga[i++] = '\n'; _gga[i] = '\0';
             }            
+            // The time field is read before strtok() mangles the sentence.
+            thePlace.timestamp_us = fixTimestamp(rx_us, GPS_Time::nmea_ms(s + 7), &locked);
+            thePlace.pps_locked = locked;
             thePlace.nmea_gga(s);            
+            thePlace.seq++;
             cb_gga.call();
+            if (_vtgPending && (uint32_t)(rx_us - _vtgRxStamp) < GPS_EPOCH_WINDOW) {
+                vtg_release(true);
+            }
         }
         else if (!strncmp(s, "$GPVTG", 6)) {
             if (_vtg) {
@@ -164,8 +313,21 @@ GPS::ticktock(void)
                 }
                 _vtg[i++] = '\n'; _vtg[i] = '\0';
             }
-            theVTG.nmea_vtg(s);            
-            cb_vtg.call();
+            // VTG carries no time, it waits for the GGA that follows it.
+            if (_vtgPending) vtg_release(false);
+            theVTG.nmea_vtg(s);
+            _vtgRxStamp = rx_us;
+            _vtgPending = true;
+        }
+        else if (!strncmp(s, "$GPGSA", 6)) {
+            theGSA.nmea_gsa(s);
+            cb_gsa.call();
+        }
+        else if (!strncmp(s, "$GPGSV", 6)) {
+            if (theGSV.nmea_gsv(s)) cb_gsv.call();
+        }
+        else if (!strncmp(s, "$PMTK", 5)) {
+            nmea_pmtk(s);
         }
         else {
             if (_ukn) {
@@ -178,21 +340,77 @@ GPS::ticktock(void)
         }
         process_required = false;
     }
+}
+
+// Decode a UBX NAV-PVT payload into the same objects the NMEA
+// sentences fill. Every field is at a fixed offset, no text involved.
+void
+GPS::nav_pvt(const uint8_t *p, uint32_t rx_us)
+{
+    uint32_t itow   = GPS_UBX::u32(&p[0]);
+    uint8_t  valid  = p[11];
+    uint8_t  fix    = p[20];
+    uint8_t  flags  = p[21];
+    int32_t  gspeed = GPS_UBX::i32(&p[60]);
+    int32_t  nano   = GPS_UBX::i32(&p[16]);
+    int      ms, ms_of_s;
+    bool     locked;
+    
+    // The UTC time is sec + nano, and nano is -1e9 to 1e9 ns so the
+    // solution can be just before the second in sec. Without a valid
+    // time GPS and UTC seconds differ by whole leap seconds, so the
+    // millisecond of the GPS time of week is that of the UTC time too.
+    if (valid & 0x02) ms = (int)((nano + (nano < 0 ? -500000 : 500000)) / 1000000);
+    else ms = (int)(itow % 1000);
+    ms_of_s = ms < 0 ? ms + 1000 : ms >= 1000 ? ms - 1000 : ms;
+    
+    thePlace.timestamp_us = fixTimestamp(rx_us, ms_of_s, &locked);
+    thePlace.pps_locked   = locked;
+    thePlace.lon_e7 = GPS_UBX::i32(&p[24]);
+    thePlace.lat_e7 = GPS_UBX::i32(&p[28]);
+    thePlace.lon  = (double)thePlace.lon_e7 * 1.0e-7;
+    thePlace.lat  = (double)thePlace.lat_e7 * 1.0e-7;
+    thePlace.alt  = (double)GPS_UBX::i32(&p[36]) * 1.0e-6;     // mm to km
+    // The epoch's NAV-DOP has the same iTOW, one from the last second will do.
+    if (_dopSeen && itow - _dopItow <= 1000) thePlace.hdop = (double)_dopH * 0.01;
+    else thePlace.hdop = (double)GPS_UBX::u16(&p[76]) * 0.01;   // PDOP, no HDOP in PVT
+    thePlace.num_of_gps_sats = p[23];
+    thePlace.gps_satellite_quality = ((flags & 0x01) && fix >= 2) ? 1 : 0;
+    thePlace.seq++;
+    cb_gga.call();
     
-    // If we have a valid GPS time then, once per minute, set the RTC.
-    if (theTime.status == 'A' && theTime.second == 0 && theTime.tenths == 0 && theTime.hundreths == 0) {
-        // set_time() is defined in rtc_time.h
-        // http://mbed.org/projects/libraries/svn/mbed/trunk/rtc_time.h
-        set_time(theTime.to_C_tm());        
+    theVTG.timestamp_us    = thePlace.timestamp_us;
+    theVTG.pps_locked      = locked;
+    theVTG._velocity_kph   = (double)gspeed * 0.0036;
+    theVTG._velocity_knots = (double)gspeed * 0.00194384449;
+    theVTG._track_true     = (double)GPS_UBX::i32(&p[64]) * 1.0e-5;
+    cb_vtg.call();
+    
+    // validDate and validTime
+    if ((valid & 0x03) == 0x03) {
+        theTime.set(GPS_UBX::u16(&p[4]), p[6], p[7], p[8], p[9], p[10], ms);
+        theTime.velocity  = theVTG._velocity_knots;
+        theTime.track     = theVTG._track_true;
+        theTime.status    = thePlace.gps_satellite_quality ? 'A' : 'V';
+        cb_rmc.call();
     }
     
+    _pvtCount++;
 }
 
 void 
 GPS::pps_irq(void)
 {
-    theTime.fractionalReset();
-    theTime++; // Increment the time/date by one second. 
+    pps_event(us_ticker_read());
+}
+
+void
+GPS::pps_event(uint32_t now)
+{
+    if (_log) _log->pps(now);
+    _ppsStamp = now;
+    _ppsSeen = true;
+    theTime.ppsEdge(); // The top of the second, ticks since may be early or late.
     cb_pps.call();
 }
 
@@ -200,39 +418,60 @@ void
 GPS::rx_irq(void)
 {
     uint32_t iir __attribute__((unused));
+    uint32_t now;
     char c;
     
+    PROFILE_ISR(profileIsrGpsRx);
     if (_base) {
         iir = (uint32_t)*((char *)_base + GPS_IIR); 
+        
+        // One stamp per interrupt, the FIFO holds at most a few bytes.
+        now = us_ticker_read();
         while((int)(*((char *)_base + GPS_LSR) & 0x1)) {
             c = (char)(*((char *)_base + GPS_RBR) & 0xFF);             
-            
-            // strtok workaround. 
-            // Found that ,, together (which some NMEA sentences
-            // contain for a null/empty field) confuses strtok()
-            // function. Solution:- Push a "zero" into the string 
-            // for missing/empty fields.
-            if (c == ',' && _lastByte == ',') {
-                buffer[active_buffer][rx_buffer_in] = '0';
-                if (++rx_buffer_in >= GPS_BUFFER_LEN) rx_buffer_in = 0;
-            }
-            
-            // Debugging/dumping data. 
-            if (_nmeaOnUart0) LPC_UART0->RBR = c; 
-            
-            // Put the byte into the string.
-            buffer[active_buffer][rx_buffer_in] = c;
-            if (++rx_buffer_in >= GPS_BUFFER_LEN) rx_buffer_in = 0;
-            
-            // Save for next time an irq occurs. See strtok() above.
-            _lastByte = c;
-            
-            // If end of NMEA sentence flag for processing.
-            if (c == '\n') {
-                active_buffer = active_buffer == 0 ? 1 : 0;
-                process_required = true;
-                rx_buffer_in = 0;                
-            }            
+            if (_rxLive) rx_byte(c, now);
         }
     }
-}      
+}
+
+void
+GPS::rx_byte(char c, uint32_t now)
+{
+    if (_log) _log->put((uint8_t)c, now);
+    
+    // UBX binary frames share the UART with NMEA, they never
+    // reach the sentence buffers.
+    switch (_ubx.feed((uint8_t)c)) {
+        case GPS_UBX::ubxFrame: ubx_frame(now); return;
+        case GPS_UBX::ubxMore:  return;
+        default: break;
+    }
+    
+    // strtok workaround. 
+    // Found that ,, together (which some NMEA sentences
+    // contain for a null/empty field) confuses strtok()
+    // function. Solution:- Push a "zero" into the string 
+    // for missing/empty fields.
+    if (c == ',' && _lastByte == ',') {
+        buffer[active_buffer][rx_buffer_in] = '0';
+        if (++rx_buffer_in >= GPS_BUFFER_LEN) rx_buffer_in = 0;
+    }
+    
+    // Debugging/dumping data. 
+    if (_nmeaOnUart0) LPC_UART0->RBR = c; 
+    
+    // Put the byte into the string.
+    buffer[active_buffer][rx_buffer_in] = c;
+    if (++rx_buffer_in >= GPS_BUFFER_LEN) rx_buffer_in = 0;
+    
+    // Save for next time an irq occurs. See strtok() above.
+    _lastByte = c;
+    
+    // If end of NMEA sentence flag for processing.
+    if (c == '\n') {
+        buffer_stamp[active_buffer] = now;
+        active_buffer = active_buffer == 0 ? 1 : 0;
+        process_required = true;
+        rx_buffer_in = 0;                
+    }            
+}
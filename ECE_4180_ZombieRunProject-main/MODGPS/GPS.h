@@ -27,6 +27,10 @@
 #include "GPS_VTG.h"
 #include "GPS_Time.h"
 #include "GPS_Geodetic.h"
+#include "GPS_GSA.h"
+#include "GPS_GSV.h"
+#include "GPS_UBX.h"
+#include "GPS_Log.h"
 
 #define GPS_RBR  0x00
 #define GPS_THR  0x00
@@ -46,6 +50,65 @@
 #define GPS_BUFFER_LEN  128
 #define GPS_TICKTOCK    10000
 
+// A fix older than this when its sentence ends is not trusted to the PPS.
+#define GPS_PPS_MAX_LATENCY 900000
+
+// A GGA this soon after a VTG belongs to the same fix. Under the 100ms
+// between fixes at 10Hz, over a GGA's 75ms on the wire at 9600 baud.
+#define GPS_EPOCH_WINDOW    90000
+
+// RTC discipline, see rtcDiscipline().
+#define GPS_RTC_CTC     0x04
+
+#ifndef GPS_RTC_STEP_MS
+#define GPS_RTC_STEP_MS     1500
+#endif
+
+#ifndef GPS_RTC_TRIM_PPM
+#define GPS_RTC_TRIM_PPM    2.0f
+#endif
+
+#ifndef GPS_RTC_TRIM_WINDOW
+#define GPS_RTC_TRIM_WINDOW 3600000
+#endif
+
+// Fewest offsets in a window for its rate to be trusted.
+#ifndef GPS_RTC_FIT_MIN
+#define GPS_RTC_FIT_MIN     30
+#endif
+
+// How late past a GPS second boundary a step may still be made, ms.
+#ifndef GPS_RTC_STEP_LATE
+#define GPS_RTC_STEP_LATE   20
+#endif
+
+/** RTC drift statistics, see GPS::rtcDiscipline(). */
+struct GPS_RtcStats {
+    //! Last RTC minus GPS time, ms.
+    int32_t offsetMs;
+    int32_t minOffsetMs;
+    int32_t maxOffsetMs;
+    //! Crystal rate error fitted over the last window, ppm (+ is fast).
+    float ppm;
+    //! Rate correction the RTC calibration applies, ppm, 0 when off.
+    float trimPpm;
+    uint32_t samples;
+    uint32_t steps;
+    uint32_t trims;
+};
+
+// How long to wait for a receiver to acknowledge a configuration command.
+#define GPS_CFG_TIMEOUT 1000
+
+// Sentence masks for setSentences().
+#define GPS_MSG_GGA     0x01
+#define GPS_MSG_GLL     0x02
+#define GPS_MSG_GSA     0x04
+#define GPS_MSG_GSV     0x08
+#define GPS_MSG_RMC     0x10
+#define GPS_MSG_VTG     0x20
+#define GPS_MSG_ZDA     0x40
+
 /** @defgroup API The MODGPS API */
 
 /** GPS module
@@ -106,6 +169,12 @@ public:
         ppsFall         /*!< Use the falling edge. */
     };
     
+    //! The command set used to configure the receiver.
+    enum cfgProtocol {
+        cfgPMTK = 0,    /*!< MediaTek $PMTK sentences (default). */
+        cfgUBX          /*!< u-blox UBX binary, e.g. NEO-6M/GT-U7. */
+    };
+    
     //! A copy of the Serial parity enum
     enum Parity {
         None = 0
@@ -351,6 +420,88 @@ public:
      */
     GPS_Geodetic *geodetic(void) { return geodetic(NULL); }
     
+    //! What was the last reported horizontal dilution of precision.
+    /**
+     * Method returns the HDOP reported in the last GGA sentence, the value
+     * that belongs to the current position. Lower is better, 1.0 is ideal
+     * and anything over 5.0 is poor. 99.99 is returned before any fix.
+     *
+     * @code
+     *     // Assuming we have a GPS object previously created...
+     *     GPS gps(NC, p9); 
+     *
+     *     if (gps.hdop() < 2.0) {
+     *         // Good enough to use for distance.
+     *     }
+     *     
+     * @endcode
+     *
+     * @ingroup API
+     * @return double HDOP
+     */
+    double hdop(void);
+    
+    //! What was the last reported position dilution of precision (from GSA).
+    /**
+     * @ingroup API
+     * @return double PDOP
+     */
+    double pdop(void) { GPS_GSA g; return gsa(&g)->pdop(); }
+    
+    //! What was the last reported vertical dilution of precision (from GSA).
+    /**
+     * @ingroup API
+     * @return double VDOP
+     */
+    double vdop(void) { GPS_GSA g; return gsa(&g)->vdop(); }
+    
+    //! Get the DOP and active satellites (GSA) together.
+    /**
+     * Pass a pointer to a GPS_GSA object and the current
+     * GPS data will be copied into it.
+     *
+     * @code
+     *     // Assuming we have a GPS object previously created...
+     *     GPS gps(NC, p9); 
+     *
+     *     // Then get the data...
+     *     GPS_GSA p;
+     *     gps.gsa(&p);
+     *     printf("PDOP = %.1f HDOP = %.1f VDOP = %.1f", p.pdop(), p.hdop(), p.vdop());
+     *     printf("Fix = %dD using %d sats", p.fix_type, p.numUsed());
+     *
+     * @endcode
+     *
+     * @ingroup API
+     * @param g A GPS_GSA pointer to an existing GPS_GSA object.
+     * @return GPS_GSA * The pointer passed in.
+     */
+    GPS_GSA *gsa(GPS_GSA *g);
+    
+    //! Get the satellites in view (GSV) table.
+    /**
+     * Pass a pointer to a GPS_GSV object and the last complete
+     * satellites in view report will be copied into it.
+     *
+     * @code
+     *     // Assuming we have a GPS object previously created...
+     *     GPS gps(NC, p9); 
+     *
+     *     // Then get the data...
+     *     GPS_GSV p;
+     *     gps.gsv(&p);
+     *     for (int i = 0; i < p.num_sats; i++) {
+     *         printf("PRN %d SNR %d\r\n", p.sats[i].prn, p.sats[i].snr);
+     *     }
+     *
+     * @endcode
+     *
+     * @ingroup API
+     * @param g A GPS_GSV pointer to an existing GPS_GSV object.
+     * @return GPS_GSV * The pointer passed in.
+     */
+    GPS_GSV *gsv(GPS_GSV *g);
+    
     //! Take a snap shot of the current time.
     /**
      * Pass a pointer to a GPS_Time object to get a copy of the current
@@ -494,6 +645,90 @@ public:
     //! GPS pps interrupt handler.
     void pps_irq(void);
     
+    //! Handle one received byte.
+    /**
+     * Everything rx_irq() does with a byte from the UART. Public so a
+     * GPS_Replay can feed a recording in through the same path.
+     *
+     * @param c The byte.
+     * @param now The us_ticker time it was received.
+     */
+    void rx_byte(char c, uint32_t now);
+    
+    //! Handle a 1PPS edge at the given us_ticker time.
+    void pps_event(uint32_t now);
+    
+    //! Bring the RTC into line with GPS time.
+    /**
+     * Call every few seconds to minutes from a low priority thread, the
+     * ticker no longer touches the RTC. Compares the RTC, to the ms with
+     * its 32kHz prescaler, against GPS time and
+     * - steps it, on a GPS second boundary, when it has never been set
+     *   or is more than GPS_RTC_STEP_MS out,
+     * - otherwise fits its rate to the offsets over GPS_RTC_TRIM_WINDOW
+     *   and, if that is more than GPS_RTC_TRIM_PPM from the trim, trims
+     *   it with the RTC calibration register. That adds or drops one
+     *   whole second every so many seconds, which is why the step
+     *   threshold is over 1s, and can't correct less than about 7.6ppm.
+     *
+     * A step sleeps up to a second for the GPS second boundary, a few
+     * more if the thread is held up past it. Steps are counted, only
+     * samples within the threshold go into the offset figures.
+     *
+     * @code
+     *     void rtc_task(void) {
+     *         while (1) {
+     *             Thread::wait(10000);
+     *             gps.rtcDiscipline();
+     *         }
+     *     }
+     * @endcode
+     *
+     * @ingroup API
+     * @return bool false if there was no valid GPS time to compare with.
+     */
+    bool rtcDiscipline(void);
+    
+    //! Copy the RTC drift statistics.
+    void rtcStats(GPS_RtcStats *s) { memcpy(s, &_rtc, sizeof(GPS_RtcStats)); }
+    
+    //! Process a completed sentence now rather than on the next 10ms tick.
+    void poll(void);
+    
+    //! Stop (false) or restart (true) taking bytes from the UART, e.g. while replaying.
+    void rxLive(bool b) { _rxLive = b; }
+    
+    //! Record everything received into a GPS_Log, NULL to stop.
+    void attachLog(GPS_Log *log) { _log = log; }
+    
+    //! Work out when the fix in a sentence was measured.
+    /**
+     * Every sentence is stamped with us_ticker_read() when its '\n' is
+     * received. With a 1PPS attached the stamp is moved back to the PPS
+     * edge plus the fraction of a second in the sentence's UTC time,
+     * removing the receiver's variable output latency. Without a PPS the
+     * receive stamp is used as is.
+     *
+     * The result is held in GPS_Geodetic::timestamp_us and
+     * GPS_VTG::timestamp_us so integrators can use the true dt between
+     * fixes rather than assume a fixed rate.
+     *
+     * A VTG has no time of its own. u-blox receivers send it just before
+     * the GGA of the same fix, so it is held until a GGA arrives within
+     * GPS_EPOCH_WINDOW and takes that GGA's stamp, its callback follows
+     * the GGA's. With no GGA in time it is let go when the next sentence
+     * arrives, with its own receive stamp and not PPS locked.
+     *
+     * @param rx_us The receive stamp of the sentence.
+     * @param ms The millisecond of the second in the sentence, or -1.
+     * @param locked Set true if the PPS was used.
+     * @return uint32_t The us_ticker time of the fix.
+     */
+    uint32_t fixTimestamp(uint32_t rx_us, int ms, bool *locked);
+    
+    //! us_ticker time of the last 1PPS edge.
+    uint32_t lastPps(void) { return _ppsStamp; }
+    
     //! A pointer to the UART peripheral base address being used.
     void *_base;
     
@@ -509,6 +744,9 @@ public:
     //! Boolean flag set when the "passive" buffer is full and needs processing.
     bool process_required;
     
+    //! us_ticker time each buffer's '\n' was received.
+    uint32_t buffer_stamp[2];
+    
     //! 10ms Ticker callback.
     void ticktock(void);
     
@@ -697,6 +935,51 @@ public:
     //! A callback object for the NMEA RMS message processed signal user API.
     FunctionPointer cb_vtg;
     
+    //! Attach a user callback function to the NMEA GSA message processed signal.
+    /**
+     * @see attach_gga()
+     *
+     * @ingroup API 
+     * @param tptr pointer to the object to call the member function on
+     * @param mptr pointer to the member function to be called
+     */
+    template<typename T>
+    void attach_gsa(T* tptr, void (T::*mptr)(void)) { cb_gsa.attach(tptr, mptr); }
+    
+    //! Attach a user callback function to the NMEA GSA message processed signal.
+    /**
+     * @ingroup API 
+     * @param fptr Callback function pointer.
+     */
+    void attach_gsa(void (*fptr)(void)) { cb_gsa.attach(fptr); } 
+    
+    //! A callback object for the NMEA GSA message processed signal user API.
+    FunctionPointer cb_gsa;
+    
+    //! Attach a user callback function to the NMEA GSV report complete signal.
+    /**
+     * Called once per complete satellites in view report, i.e. after the
+     * last sentence of a GSV sequence has been processed.
+     *
+     * @see attach_gga()
+     *
+     * @ingroup API 
+     * @param tptr pointer to the object to call the member function on
+     * @param mptr pointer to the member function to be called
+     */
+    template<typename T>
+    void attach_gsv(T* tptr, void (T::*mptr)(void)) { cb_gsv.attach(tptr, mptr); }
+    
+    //! Attach a user callback function to the NMEA GSV report complete signal.
+    /**
+     * @ingroup API 
+     * @param fptr Callback function pointer.
+     */
+    void attach_gsv(void (*fptr)(void)) { cb_gsv.attach(fptr); } 
+    
+    //! A callback object for the NMEA GSV report complete signal user API.
+    FunctionPointer cb_gsv;
+    
     //! Attach a user callback function to the unknown NMEA message.
     /**
      * Attach a user callback object/method to call when an unknown NMEA packet. 
@@ -780,7 +1063,7 @@ public:
      * @ingroup API 
      * @param baudrate The baudrate to set.
      */
-    void baud(int baudrate) { Serial::baud(baudrate); }
+    void baud(int baudrate) { _baudrate = baudrate; Serial::baud(baudrate); }
     
    //! Set the serial port format the GPS module is using. 
    /**
@@ -795,6 +1078,109 @@ public:
     */
     void format(int bits, Parity parity, int stop_bits) { Serial::format(bits, (Serial::Parity)parity, stop_bits); }
     
+    //! Select the command set the receiver understands.
+    /**
+     * Configuration commands are only sent if the GPS object was
+     * created with a TX pin, e.g. GPS gps(p28, p27);
+     *
+     * @ingroup API 
+     * @param p GPS::cfgPMTK or GPS::cfgUBX
+     */
+    void setConfigProtocol(cfgProtocol p) { _cfgProto = p; }
+    
+    //! Set the navigation/output rate of the receiver.
+    /**
+     * Sends the rate command, waits for the receiver to acknowledge it
+     * and then reads the rate back to verify it was applied.
+     *
+     * At 5Hz or 10Hz the default 9600 baud is too slow for more than a
+     * couple of sentences, raise it with setReceiverBaud() first.
+     *
+     * @code
+     *     GPS gps(p28, p27);
+     *
+     *     gps.setConfigProtocol(GPS::cfgUBX);
+     *     gps.setReceiverBaud(38400);
+     *     // RMC is the only sentence with the date, keep it for the time.
+     *     gps.setSentences(GPS_MSG_GGA | GPS_MSG_VTG | GPS_MSG_RMC);
+     *     if (!gps.setUpdateRate(10)) {
+     *         // Receiver refused or did not answer.
+     *     }
+     * @endcode
+     *
+     * @ingroup API 
+     * @param hz Fixes per second, 1 to 10.
+     * @return bool true if acknowledged and verified.
+     */
+    bool setUpdateRate(int hz);
+    
+    //! Read back the receiver's measurement period.
+    /**
+     * @ingroup API 
+     * @return int The period in milliseconds, or 0 on no answer.
+     */
+    int readUpdatePeriod(void);
+    
+    //! Change the receiver baud rate and follow it on the Mbed UART.
+    /**
+     * The receiver switches immediately so the acknowledgement may be
+     * lost, instead the link is verified by reading back the update
+     * rate at the new baud rate. If that fails the Mbed UART is put
+     * back on the old baud rate.
+     *
+     * @ingroup API 
+     * @param baudrate The new baud rate, 4800 to 115200.
+     * @return bool true if the receiver answers at the new rate.
+     */
+    bool setReceiverBaud(int baudrate);
+    
+    //! Enable only the given NMEA sentences.
+    /**
+     * @ingroup API 
+     * @param mask An OR of GPS_MSG_GGA, GPS_MSG_VTG, etc.
+     * @return bool true if acknowledged and verified.
+     */
+    bool setSentences(int mask);
+    
+    //! Turn the UBX NAV-PVT binary solution on or off.
+    /**
+     * NAV-PVT carries position, velocity, time and accuracy in one fixed
+     * layout little endian frame which is decoded without any string
+     * conversion. It is fed into the same data as GGA/VTG/RMC and calls
+     * the same attach_gga()/attach_vtg() callbacks, so an application
+     * does not need to know which protocol is in use.
+     *
+     * NAV-PVT has no HDOP, only PDOP, so NAV-DOP is turned on with it and
+     * its hDOP goes in the geodetic's hdop. If the epoch's NAV-DOP is
+     * missing the PDOP is used, which is never less than the HDOP.
+     *
+     * Per fix a u-blox 8 sends 100 bytes of NAV-PVT and 26 of NAV-DOP
+     * against roughly 110 bytes of GGA+VTG (180 with RMC), and the decode
+     * is a handful of loads where the NMEA path runs strtok()/atof() over
+     * every field; TESTS/gps/pvt compares the two. Usually combined with
+     * setSentences(0) to turn the NMEA off.
+     *
+     * @code
+     *     gps.setConfigProtocol(GPS::cfgUBX);
+     *     if (gps.setUbxPvt(true)) gps.setSentences(0);
+     * @endcode
+     *
+     * @ingroup API 
+     * @param on true to output NAV-PVT and NAV-DOP every fix.
+     * @return bool true if both were acknowledged.
+     */
+    bool setUbxPvt(bool on);
+    
+    //! Number of NAV-PVT solutions decoded.
+    uint32_t pvtCount(void) { return _pvtCount; }
+    
+    //! Read back which NMEA sentences the receiver outputs.
+    /**
+     * @ingroup API 
+     * @return int A GPS_MSG_xxx mask, or -1 on no answer.
+     */
+    int readSentences(void);
+    
    //! Send incoming GPS bytes to Uart0
    /**
     * Send incoming GPS bytes to Uart0
@@ -821,9 +1207,38 @@ protected:
     //! An InterruptIn object to "trigger" on the PPS edge.
     InterruptIn *_pps;
     
+    //! us_ticker time of the last PPS edge.
+    volatile uint32_t _ppsStamp;
+    
+    //! Set once a PPS edge has been seen.
+    volatile bool _ppsSeen;
+    
+    //! A parsed VTG waiting for its GGA, and when it was received.
+    bool _vtgPending;
+    uint32_t _vtgRxStamp;
+    
+    void vtg_release(bool paired);
+    
     //! A Ticker object called every 10ms.
     Ticker      *_second100;
     
+    //! RTC discipline state.
+    GPS_RtcStats _rtc;
+    bool _rtcSynced;
+    //! Start of the rate window, and the whole calibration seconds since.
+    int32_t _rtcBaseOffset;
+    uint64_t _rtcBaseMs;
+    int32_t _rtcLastOffset;
+    int32_t _rtcSeconds;
+    //! Least squares sums of offset (ms) against time (s) in the window.
+    uint32_t _rtcFitN;
+    double _rtcFitT, _rtcFitY, _rtcFitTT, _rtcFitTY;
+    
+    int64_t rtc_ms(void);
+    bool rtc_step(void);
+    void rtc_trim(float ppm);
+    void rtc_fit_reset(uint64_t gps, int32_t offset);
+    
     //! A GPS_Time object used to hold the last parsed time/date data.
     GPS_Time     theTime;
     
@@ -833,6 +1248,12 @@ protected:
     //! A GPS_VTG object used to hold vector data.
     GPS_VTG      theVTG; 
     
+    //! A GPS_GSA object used to hold the DOP/active satellite data.
+    GPS_GSA      theGSA;
+    
+    //! A GPS_GSV object used to hold the satellites in view data.
+    GPS_GSV      theGSV;
+    
     //! Used to record the previous byte received.
     char _lastByte;
     
@@ -843,6 +1264,67 @@ protected:
     
     //! Used for debugging.
     bool _nmeaOnUart0;      
+    
+    //! Recording of the received bytes, or NULL.
+    GPS_Log *_log;
+    
+    //! Cleared while bytes come from a replay instead of the UART.
+    bool _rxLive;
+    
+    //! Set while poll() is processing so ticktock() leaves the buffer alone.
+    volatile bool _polling;
+    
+    void process_sentence(void);
+    
+    //! Set when a TX pin was given so commands can be sent.
+    bool _txInUse;
+    
+    //! The command set used for configuration.
+    cfgProtocol _cfgProto;
+    
+    //! The baud rate the UART is currently set to.
+    int _baudrate;
+    
+    //! UBX frame decoder, runs in the serial ISR.
+    GPS_UBX _ubx;
+    
+    //! Last UBX ACK (1) or NAK (-1) received, 0 while waiting.
+    volatile int _ubxAck;
+    uint8_t _ubxAckCls;
+    uint8_t _ubxAckId;
+    
+    //! Last non-ACK UBX frame, used for poll responses.
+    GPS_UBX_Msg _ubxResp;
+    volatile bool _ubxRespReady;
+    
+    //! Last $PMTK001 acknowledgement, command number and flag.
+    volatile int _pmtkAckCmd;
+    volatile int _pmtkAckFlag;
+    
+    //! Last other $PMTK sentence, used for query responses.
+    char _pmtkResp[GPS_BUFFER_LEN];
+    volatile bool _pmtkRespReady;
+    
+    //! The last NAV-PVT frame, handed from rx_irq() to ticktock().
+    GPS_UBX_Msg _pvt;
+    uint32_t _pvtStamp;
+    volatile bool _pvtReady;
+    uint32_t _pvtCount;
+    
+    //! hDOP (0.01) and iTOW of the last NAV-DOP, which comes before its epoch's NAV-PVT.
+    uint16_t _dopH;
+    uint32_t _dopItow;
+    bool _dopSeen;
+    
+    void ubx_frame(uint32_t now);
+    void nav_pvt(const uint8_t *p, uint32_t rx_us);
+    void nmea_pmtk(char *s);
+    void send(const uint8_t *b, int len);
+    void sendPmtk(const char *body);
+    bool sendUbx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len, bool ack);
+    bool waitPmtkAck(int cmd);
+    bool waitPmtkResp(const char *prefix);
+    bool pollUbx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len, uint16_t echo = 0);
 };
 
 #endif
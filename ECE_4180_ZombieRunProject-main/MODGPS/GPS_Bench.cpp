@@ -0,0 +1,98 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include "GPS_Bench.h"
+#include "GPS.h"
+
+const char *const GPS_Bench::corpus[] = {
+    // u-blox 7, 5 minute decimals.
+    "$GPGGA,092750.00,5321.68020,N,00630.33720,W,1,08,1.03,61.7,M,55.2,M,,*76\r\n",
+    "$GPRMC,092750.00,A,5321.68020,N,00630.33720,W,0.023,,181026,,,A*6C\r\n",
+    "$GPVTG,,T,,M,0.023,N,0.043,K,A*23\r\n",
+    // SiRF/MTK, 4 minute decimals.
+    "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n",
+    "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n",
+    "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n",
+    // Southern/eastern hemisphere, 6 minute decimals.
+    "$GPGGA,002153.000,3342.658731,S,15109.123456,E,2,11,0.70,44.2,M,21.3,M,0.8,0000*5C\r\n",
+    "$GPRMC,002153.000,A,3342.658731,S,15109.123456,E,1.26,287.55,010124,,,D*71\r\n",
+    "$GPVTG,287.55,T,,M,1.26,N,2.33,K,D*3A\r\n",
+    // No fix yet.
+    "$GPGGA,000012.00,,,,,0,00,99.99,,,,,,*66\r\n",
+    "$GPRMC,000012.00,V,,,,,,,,,,N*7E\r\n",
+    "$GPVTG,,,,,,,,,N*30\r\n",
+    // Malformed: truncated, missing fields, garbage.
+    "$GPGGA,092750.00,5321.68\r\n",
+    "$GPGGA,092750.00,5321.68020,N,00630.33720\r\n",
+    "$GPRMC,0927\r\n",
+    "$GPRMC,092750.00,A,5321.68020,N,00630.33720,W,,,18\r\n",
+    "$GPVTG,\r\n",
+    "$GPGGA,aaaaaa,bbbb.cc,N,ccccc.dd,W,x,yy,z,q,M,,M,,*00\r\n",
+    "$GPGGA\r\n",
+    "",
+};
+
+const int GPS_Bench::corpusLen = sizeof(GPS_Bench::corpus) / sizeof(GPS_Bench::corpus[0]);
+
+// Static so constructors are not part of the timing.
+static GPS_Geodetic bench_place;
+static GPS_Time     bench_time;
+static GPS_VTG      bench_vtg;
+
+void GPS_Bench::gga(char *s) { bench_place.nmea_gga(s); }
+void GPS_Bench::rmc(char *s) { bench_time.nmea_rmc(s); }
+void GPS_Bench::vtg(char *s) { bench_vtg.nmea_vtg(s); }
+
+void
+GPS_Bench::run(GPS_BenchResult *r, const char *name, GPS_BenchFn fn, 
+               const char *const *sentences, int n, int repeat)
+{
+    char work[GPS_BUFFER_LEN];
+    uint32_t start, cycles;
+    int i, j;
+    
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    
+    r->name = name;
+    r->sentences = 0;
+    r->minCycles = 0xFFFFFFFF;
+    r->maxCycles = 0;
+    r->totalCycles = 0;
+    
+    for (j = 0; j < repeat; j++) {
+        for (i = 0; i < n; i++) {
+            strncpy(work, sentences[i], GPS_BUFFER_LEN - 1);
+            work[GPS_BUFFER_LEN - 1] = '\0';
+            
+            start = DWT->CYCCNT;
+            fn(work);
+            cycles = DWT->CYCCNT - start;
+            
+            if (cycles < r->minCycles) r->minCycles = cycles;
+            if (cycles > r->maxCycles) r->maxCycles = cycles;
+            r->totalCycles += cycles;
+            r->sentences++;
+        }
+    }
+}
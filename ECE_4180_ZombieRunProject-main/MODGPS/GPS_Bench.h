@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#ifndef GPS_BENCH_H
+#define GPS_BENCH_H
+
+#include "mbed.h"
+
+/** A parser under test, takes a sentence it may modify (strtok). */
+typedef void (*GPS_BenchFn)(char *s);
+
+/** Results of one GPS_Bench::run(). */
+struct GPS_BenchResult {
+    const char *name;
+    uint32_t sentences;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint32_t totalCycles;
+    
+    //! Mean cycles per sentence.
+    uint32_t meanCycles(void) { return sentences ? totalCycles / sentences : 0; }
+    
+    //! Mean ns per sentence at the core clock.
+    uint32_t meanNs(void) { return (uint32_t)((uint64_t)meanCycles() * 1000000000ULL / SystemCoreClock); }
+};
+
+/** GPS_Bench definition.
+ *
+ * Times a sentence parser over a corpus with the Cortex-M3 DWT cycle
+ * counter. Each sentence is copied to a work buffer before the count
+ * starts, so only the parser is measured. Any function taking a char *
+ * can be timed, so a replacement tokenizer or number parser is compared
+ * against the current one on the same corpus.
+ *
+ * The built in corpus is typical GGA/RMC/VTG output in the styles of
+ * several receivers plus malformed sentences (truncated, empty fields,
+ * garbage) which the parsers must survive. The sentences are as sent,
+ * without the '0' rx_irq() puts between ",," so strtok() shifts the
+ * fields of the sparse ones, another error path.
+ *
+ * The counts are cycles, so only mean something on the target; meanNs()
+ * converts at the core clock. Off the target the DWT isn't there and
+ * the counts are 0, TESTS/gps/bench times the same corpus and wrappers
+ * with the wall clock and gives ns per sentence on either.
+ *
+ * @code
+ * GPS_BenchResult r;
+ * GPS_Bench::run(&r, "gga", GPS_Bench::gga, GPS_Bench::corpus, GPS_Bench::corpusLen, 100);
+ * pc.printf("%s %lu cycles %lu ns\r\n", r.name, r.meanCycles(), r.meanNs());
+ * @endcode
+ */
+class GPS_Bench {
+public:
+    
+    //! The built in corpus.
+    static const char *const corpus[];
+    static const int corpusLen;
+    
+    //! Wrappers around the MODGPS parsers.
+    static void gga(char *s);
+    static void rmc(char *s);
+    static void vtg(char *s);
+    
+    /** Time a parser over a corpus.
+     *
+     * @param r Where to put the results.
+     * @param name A label for the results.
+     * @param fn The parser.
+     * @param sentences The corpus.
+     * @param n Number of sentences in the corpus.
+     * @param repeat How many times to go round the corpus.
+     */
+    static void run(GPS_BenchResult *r, const char *name, GPS_BenchFn fn, 
+                    const char *const *sentences, int n, int repeat);
+};
+
+#endif
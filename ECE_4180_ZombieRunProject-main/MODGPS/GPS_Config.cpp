@@ -0,0 +1,347 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include "GPS.h"
+
+// PMTK314 field position of each sentence, see the MTK NMEA packet manual.
+static const struct { int mask; int pmtk; uint8_t ubx; } gps_msgs[] = {
+    { GPS_MSG_GLL, 0,  0x01 },
+    { GPS_MSG_RMC, 1,  0x04 },
+    { GPS_MSG_VTG, 2,  0x05 },
+    { GPS_MSG_GGA, 3,  0x00 },
+    { GPS_MSG_GSA, 4,  0x02 },
+    { GPS_MSG_GSV, 5,  0x03 },
+    { GPS_MSG_ZDA, 17, 0x08 }
+};
+
+#define GPS_NUM_MSGS    (int)(sizeof(gps_msgs) / sizeof(gps_msgs[0]))
+#define PMTK314_FIELDS  19
+
+// Called from rx_irq() with a complete, checksummed UBX frame.
+void
+GPS::ubx_frame(uint32_t now)
+{
+    GPS_UBX_Msg *m = &_ubx.msg;
+    
+    if (m->cls == UBX_CLASS_ACK && m->len >= 2) {
+        _ubxAckCls = m->payload[0];
+        _ubxAckId  = m->payload[1];
+        _ubxAck    = (m->id == UBX_ACK_ACK) ? 1 : -1;
+    }
+    else if (m->cls == UBX_CLASS_NAV && m->id == UBX_NAV_DOP) {
+        if (m->len >= UBX_NAV_DOP_LEN) {
+            _dopItow = GPS_UBX::u32(&m->payload[0]);
+            _dopH    = GPS_UBX::u16(&m->payload[12]);
+            _dopSeen = true;
+        }
+    }
+    else if (m->cls == UBX_CLASS_NAV && m->id == UBX_NAV_PVT) {
+        // Decoded in ticktock(), if it is still busy with the last one
+        // this one is dropped rather than torn.
+        if (m->len >= UBX_NAV_PVT_MIN_LEN && !_pvtReady) {
+            memcpy(_pvt.payload, m->payload, UBX_NAV_PVT_MIN_LEN);
+            _pvt.len  = m->len;
+            _pvtStamp = now;
+            _pvtReady = true;
+        }
+    }
+    else if (!_ubxRespReady) {
+        // Latched until the waiting thread has looked at it.
+        memcpy(&_ubxResp, m, sizeof(GPS_UBX_Msg));
+        _ubxRespReady = true;
+    }
+}
+
+// Called from ticktock() with a $PMTK sentence.
+// $PMTK001,220,3*30
+void
+GPS::nmea_pmtk(char *s)
+{
+    char *p;
+    
+    if (!strncmp(s, "$PMTK001,", 9)) {
+        p = strchr(s + 9, ',');
+        _pmtkAckFlag = p ? atoi(p + 1) : 0;
+        _pmtkAckCmd  = atoi(s + 9);
+    }
+    else if (!_pmtkRespReady) {
+        strncpy(_pmtkResp, s, GPS_BUFFER_LEN - 1);
+        _pmtkResp[GPS_BUFFER_LEN - 1] = '\0';
+        _pmtkRespReady = true;
+    }
+}
+
+void
+GPS::send(const uint8_t *b, int len)
+{
+    for (int i = 0; i < len; i++) Serial::putc(b[i]);
+}
+
+void
+GPS::sendPmtk(const char *body)
+{
+    char buf[GPS_BUFFER_LEN];
+    uint8_t cs = 0;
+    int i;
+    
+    for (i = 0; body[i]; i++) cs ^= (uint8_t)body[i];
+    i = snprintf(buf, sizeof(buf), "$%s*%02X\r\n", body, cs);
+    send((const uint8_t *)buf, i);
+}
+
+bool
+GPS::sendUbx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len, bool ack)
+{
+    uint8_t buf[GPS_UBX_PAYLOAD_LEN + GPS_UBX_OVERHEAD];
+    Timer t;
+    
+    if (len > GPS_UBX_PAYLOAD_LEN) return false;
+    
+    _ubxAck = 0;
+    send(buf, GPS_UBX::build(buf, cls, id, payload, len));
+    if (!ack) return true;
+    
+    t.start();
+    while (t.read_ms() < GPS_CFG_TIMEOUT) {
+        if (_ubxAck != 0 && _ubxAckCls == cls && _ubxAckId == id) {
+            return _ubxAck == 1;
+        }
+        wait_ms(1);
+    }
+    return false;
+}
+
+bool
+GPS::pollUbx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len, uint16_t echo)
+{
+    Timer t;
+    
+    _ubxRespReady = false;
+    sendUbx(cls, id, payload, len, false);
+    
+    t.start();
+    while (t.read_ms() < GPS_CFG_TIMEOUT) {
+        if (_ubxRespReady) {
+            // Polls that name what they ask about (CFG-MSG) must get an
+            // answer about that, not a late one to an earlier poll.
+            if (_ubxResp.cls == cls && _ubxResp.id == id && _ubxResp.len >= echo
+                && !memcmp(_ubxResp.payload, payload, echo)) return true;
+            _ubxRespReady = false;
+        }
+        wait_ms(1);
+    }
+    return false;
+}
+
+bool
+GPS::waitPmtkAck(int cmd)
+{
+    Timer t;
+    
+    t.start();
+    while (t.read_ms() < GPS_CFG_TIMEOUT) {
+        // Flag 3 is "valid packet, action succeeded".
+        if (_pmtkAckCmd == cmd) return _pmtkAckFlag == 3;
+        wait_ms(1);
+    }
+    return false;
+}
+
+bool
+GPS::waitPmtkResp(const char *prefix)
+{
+    Timer t;
+    
+    t.start();
+    while (t.read_ms() < GPS_CFG_TIMEOUT) {
+        if (_pmtkRespReady) {
+            if (!strncmp(_pmtkResp, prefix, strlen(prefix))) return true;
+            _pmtkRespReady = false;
+        }
+        wait_ms(1);
+    }
+    return false;
+}
+
+bool
+GPS::setUpdateRate(int hz)
+{
+    char body[32];
+    uint8_t p[6];
+    int ms;
+    
+    if (!_txInUse || hz < 1 || hz > 10) return false;
+    ms = 1000 / hz;
+    
+    if (_cfgProto == cfgUBX) {
+        GPS_UBX::put16(&p[0], ms);  // measRate
+        GPS_UBX::put16(&p[2], 1);   // navRate, one solution per measurement
+        GPS_UBX::put16(&p[4], 1);   // timeRef, GPS time
+        if (!sendUbx(UBX_CLASS_CFG, UBX_CFG_RATE, p, 6, true)) return false;
+    }
+    else {
+        _pmtkAckCmd = 0;
+        snprintf(body, sizeof(body), "PMTK220,%d", ms);
+        sendPmtk(body);
+        if (!waitPmtkAck(220)) return false;
+    }
+    
+    return readUpdatePeriod() == ms;
+}
+
+int
+GPS::readUpdatePeriod(void)
+{
+    if (!_txInUse) return 0;
+    
+    if (_cfgProto == cfgUBX) {
+        if (!pollUbx(UBX_CLASS_CFG, UBX_CFG_RATE, NULL, 0) || _ubxResp.len < 2) return 0;
+        return GPS_UBX::u16(&_ubxResp.payload[0]);
+    }
+    
+    // $PMTK500,100,0,0,0,0*2A
+    _pmtkRespReady = false;
+    sendPmtk("PMTK400");
+    if (!waitPmtkResp("$PMTK500,")) return 0;
+    return atoi(_pmtkResp + 9);
+}
+
+bool
+GPS::setReceiverBaud(int baudrate)
+{
+    char body[32];
+    uint8_t p[20];
+    int old = _baudrate;
+    
+    if (!_txInUse) return false;
+    
+    if (_cfgProto == cfgUBX) {
+        memset(p, 0, sizeof(p));
+        p[0] = 1;                               // portID, UART1
+        GPS_UBX::put32(&p[4], 0x000008D0);      // mode, 8N1
+        GPS_UBX::put32(&p[8], baudrate);
+        GPS_UBX::put16(&p[12], 0x0003);         // inProtoMask, UBX + NMEA
+        GPS_UBX::put16(&p[14], 0x0003);         // outProtoMask, UBX + NMEA
+        sendUbx(UBX_CLASS_CFG, UBX_CFG_PRT, p, sizeof(p), false);
+    }
+    else {
+        snprintf(body, sizeof(body), "PMTK251,%d", baudrate);
+        sendPmtk(body);
+    }
+    
+    // Let the command drain out of the UART before switching.
+    wait_ms(100);
+    baud(baudrate);
+    
+    if (readUpdatePeriod() > 0) return true;
+    baud(old);
+    return false;
+}
+
+bool
+GPS::setSentences(int mask)
+{
+    char body[80];
+    uint8_t p[3];
+    int fields[PMTK314_FIELDS];
+    int i, n;
+    
+    if (!_txInUse) return false;
+    
+    if (_cfgProto == cfgUBX) {
+        for (i = 0; i < GPS_NUM_MSGS; i++) {
+            p[0] = UBX_CLASS_NMEA;
+            p[1] = gps_msgs[i].ubx;
+            p[2] = (mask & gps_msgs[i].mask) ? 1 : 0;   // once per fix, or off
+            if (!sendUbx(UBX_CLASS_CFG, UBX_CFG_MSG, p, 3, true)) return false;
+        }
+    }
+    else {
+        memset(fields, 0, sizeof(fields));
+        for (i = 0; i < GPS_NUM_MSGS; i++) {
+            if (mask & gps_msgs[i].mask) fields[gps_msgs[i].pmtk] = 1;
+        }
+        n = snprintf(body, sizeof(body), "PMTK314");
+        for (i = 0; i < PMTK314_FIELDS; i++) {
+            n += snprintf(body + n, sizeof(body) - n, ",%d", fields[i]);
+        }
+        _pmtkAckCmd = 0;
+        sendPmtk(body);
+        if (!waitPmtkAck(314)) return false;
+    }
+    
+    return readSentences() == mask;
+}
+
+bool
+GPS::setUbxPvt(bool on)
+{
+    uint8_t p[3];
+    
+    if (!_txInUse || _cfgProto != cfgUBX) return false;
+    
+    // NAV-DOP for the HDOP that NAV-PVT doesn't have.
+    p[0] = UBX_CLASS_NAV;
+    p[1] = UBX_NAV_DOP;
+    p[2] = on ? 1 : 0;
+    if (!sendUbx(UBX_CLASS_CFG, UBX_CFG_MSG, p, 3, true)) return false;
+    p[1] = UBX_NAV_PVT;
+    return sendUbx(UBX_CLASS_CFG, UBX_CFG_MSG, p, 3, true);
+}
+
+int
+GPS::readSentences(void)
+{
+    uint8_t p[2];
+    char *f;
+    int i, field, mask = 0;
+    
+    if (!_txInUse) return -1;
+    
+    if (_cfgProto == cfgUBX) {
+        for (i = 0; i < GPS_NUM_MSGS; i++) {
+            p[0] = UBX_CLASS_NMEA;
+            p[1] = gps_msgs[i].ubx;
+            if (!pollUbx(UBX_CLASS_CFG, UBX_CFG_MSG, p, 2, 2)) return -1;
+            // 8 byte answer has a rate per port (UART1 is port 1),
+            // a 3 byte answer is the rate on the port we asked on.
+            if (_ubxResp.len >= 8 && _ubxResp.payload[3]) mask |= gps_msgs[i].mask;
+            else if (_ubxResp.len == 3 && _ubxResp.payload[2]) mask |= gps_msgs[i].mask;
+        }
+        return mask;
+    }
+    
+    // $PMTK514,0,1,0,1,1,5,0,0,0,0,0,0,0,0,0,0,0,0,0*2B
+    _pmtkRespReady = false;
+    sendPmtk("PMTK414");
+    if (!waitPmtkResp("$PMTK514,")) return -1;
+    
+    f = _pmtkResp + 8;
+    for (field = 0; f && *f == ','; field++) {
+        for (i = 0; i < GPS_NUM_MSGS; i++) {
+            if (gps_msgs[i].pmtk == field && atoi(f + 1) != 0) mask |= gps_msgs[i].mask;
+        }
+        f = strchr(f + 1, ',');
+    }
+    return mask;
+}
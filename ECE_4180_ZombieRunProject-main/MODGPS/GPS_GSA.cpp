@@ -0,0 +1,96 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include "GPS_GSA.h"
+
+GPS_GSA::GPS_GSA() 
+{
+    mode = 'A';
+    fix_type = 1;
+    for (int i = 0; i < GPS_GSA_MAX_PRN; i++) prn[i] = 0;
+    _pdop = 99.99;
+    _hdop = 99.99;
+    _vdop = 99.99;
+}
+
+GPS_GSA *
+GPS_GSA::gsa(GPS_GSA *n)
+{
+    if (n == NULL) n = new GPS_GSA;
+    memcpy(n, this, sizeof(GPS_GSA));
+    return n;    
+}
+
+int
+GPS_GSA::numUsed(void)
+{
+    int i, used = 0;
+    for (i = 0; i < GPS_GSA_MAX_PRN; i++) {
+        if (prn[i] != 0) used++;
+    }
+    return used;
+}
+
+// $GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39
+void 
+GPS_GSA::nmea_gsa(char *s)
+{
+    char *token;
+    int  token_counter = 0;
+    char *mod   = (char *)NULL;
+    char *fix   = (char *)NULL;
+    char *pd    = (char *)NULL;
+    char *hd    = (char *)NULL;
+    char *vd    = (char *)NULL;
+    int  sats[GPS_GSA_MAX_PRN] = { 0 };
+    
+    // Fields 3 to 14 are the PRNs, 15/16/17 the DOPs. All of them are
+    // picked up in the same single strtok() pass as the other fields.
+    token = strtok(s, ",");
+    while (token) {
+        switch (token_counter) {
+            case 1:  mod = token; break;
+            case 2:  fix = token; break;
+            case 15: pd  = token; break;
+            case 16: hd  = token; break;
+            case 17: vd  = token; break;
+            default:
+                if (token_counter >= 3 && token_counter < 3 + GPS_GSA_MAX_PRN) {
+                    sats[token_counter - 3] = atoi(token);
+                }
+                break;
+        }
+        token = strtok((char *)NULL, ",");
+        token_counter++;
+    }
+    
+    // Only accept a complete sentence, a short one leaves the old DOPs in place.
+    if (mod && fix && pd && hd && vd) {
+        mode     = mod[0];
+        fix_type = atoi(fix);
+        for (int i = 0; i < GPS_GSA_MAX_PRN; i++) prn[i] = sats[i];
+        _pdop    = atof(pd);
+        _hdop    = atof(hd);
+        _vdop    = atof(vd);
+    }
+}
@@ -0,0 +1,59 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#ifndef GPS_GSA_H
+#define GPS_GSA_H
+
+#include "mbed.h"
+
+#define GPS_GSA_MAX_PRN 12
+
+/** GPS_GSA definition.
+ */
+class GPS_GSA {
+public:
+
+    //! Selection mode, 'M' manual or 'A' automatic
+    char   mode;
+    //! Fix type, 1 = no fix, 2 = 2D, 3 = 3D
+    int    fix_type;
+    //! The PRNs of the satellites used in the solution (0 = unused slot)
+    int    prn[GPS_GSA_MAX_PRN];
+    //! Position dilution of precision
+    double _pdop;
+    //! Horizontal dilution of precision
+    double _hdop;
+    //! Vertical dilution of precision
+    double _vdop;
+    
+    GPS_GSA();
+    GPS_GSA * gsa(GPS_GSA *n);
+    void nmea_gsa(char *s);
+    
+    double pdop(void) { return _pdop; }
+    double hdop(void) { return _hdop; }
+    double vdop(void) { return _vdop; }
+    int    numUsed(void);
+};
+
+#endif
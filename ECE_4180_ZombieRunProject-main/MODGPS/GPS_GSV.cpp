@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include "GPS_GSV.h"
+
+GPS_GSV::GPS_GSV() 
+{
+    in_view    = 0;
+    num_sats   = 0;
+    _work_sats = 0;
+    _expect    = 0;
+    memset(sats, 0, sizeof(sats));
+    memset(_work, 0, sizeof(_work));
+}
+
+GPS_GSV *
+GPS_GSV::gsv(GPS_GSV *n)
+{
+    if (n == NULL) n = new GPS_GSV;
+    memcpy(n, this, sizeof(GPS_GSV));
+    return n;    
+}
+
+int
+GPS_GSV::numTracked(int min_snr)
+{
+    int i, tracked = 0;
+    for (i = 0; i < num_sats; i++) {
+        if (sats[i].snr >= min_snr) tracked++;
+    }
+    return tracked;
+}
+
+double
+GPS_GSV::averageSnr(void)
+{
+    int i, total = 0, tracked = 0;
+    for (i = 0; i < num_sats; i++) {
+        if (sats[i].snr > 0) {
+            total += sats[i].snr;
+            tracked++;
+        }
+    }
+    return tracked ? (double)total / (double)tracked : 0.0;
+}
+
+// $GPGSV,3,1,12,20,82,116,,01,79,246,,32,54,077,,17,48,254,*70
+// Returns true when this sentence completed a report.
+bool 
+GPS_GSV::nmea_gsv(char *s)
+{
+    char *token;
+    int  token_counter = 0;
+    int  total = 0, number = 0, view = 0;
+    int  field, slot;
+    
+    // Fields 4 onwards come in groups of four (prn, elevation, azimuth, snr)
+    // and are written straight into the working table as they are tokenised.
+    token = strtok(s, ",");
+    while (token) {
+        switch (token_counter) {
+            case 1:  total  = atoi(token); break;
+            case 2:  number = atoi(token); break;
+            case 3:  
+                view = atoi(token);
+                // A new sequence starts on sentence 1, anything out of
+                // order throws away the partial table.
+                if (number == 1) { _expect = 1; _work_sats = 0; }
+                if (number != _expect || number > total) { _expect = 0; return false; }
+                break;
+            default:
+                if (token_counter >= 4 && _expect) {
+                    field = (token_counter - 4) & 3;
+                    slot  = ((number - 1) * 4) + ((token_counter - 4) >> 2);
+                    if (slot >= GPS_GSV_MAX_SATS) break;
+                    switch (field) {
+                        case 0: _work[slot].prn       = atoi(token); _work[slot].snr = 0; break;
+                        case 1: _work[slot].elevation = atoi(token); break;
+                        case 2: _work[slot].azimuth   = atoi(token); break;
+                        case 3: _work[slot].snr       = atoi(token); break;
+                    }
+                    if (field == 0 && slot + 1 > _work_sats) _work_sats = slot + 1;
+                }
+                break;
+        }
+        token = strtok((char *)NULL, ",");
+        token_counter++;
+    }
+    
+    if (_expect == 0 || token_counter < 4) { _expect = 0; return false; }
+    
+    if (number == total) {
+        memcpy(sats, _work, sizeof(sats));
+        num_sats = _work_sats;
+        in_view  = view;
+        _expect  = 0;
+        return true;
+    }
+    
+    _expect = number + 1;
+    return false;
+}
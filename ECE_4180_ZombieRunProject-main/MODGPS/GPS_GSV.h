@@ -0,0 +1,80 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#ifndef GPS_GSV_H
+#define GPS_GSV_H
+
+#include "mbed.h"
+
+#define GPS_GSV_MAX_SATS 16
+
+/** GPS_GSV_Sat definition, one entry of the satellites in view table.
+ */
+struct GPS_GSV_Sat {
+    //! Satellite PRN number
+    int prn;
+    //! Elevation in degrees (0-90)
+    int elevation;
+    //! Azimuth in degrees true (0-359)
+    int azimuth;
+    //! Signal to noise ratio in dB-Hz (0 when not tracking)
+    int snr;
+};
+
+/** GPS_GSV definition.
+ *
+ * A GSV report is split over several sentences (four satellites per
+ * sentence). The sentences are collected into a working table and the
+ * public table is only updated once the last sentence of the sequence
+ * has arrived, so a snapshot never holds half of one report and half
+ * of the previous one.
+ */
+class GPS_GSV {
+public:
+
+    //! Number of satellites in view
+    int in_view;
+    //! Number of valid entries in sats[]
+    int num_sats;
+    //! The last complete satellites in view table
+    GPS_GSV_Sat sats[GPS_GSV_MAX_SATS];
+    
+    GPS_GSV();
+    GPS_GSV * gsv(GPS_GSV *n);
+    bool nmea_gsv(char *s);
+    
+    int    numInView(void) { return in_view; }
+    int    numTracked(int min_snr = 1);
+    double averageSnr(void);
+    
+protected:
+    
+    //! The table being filled by the current sequence of sentences
+    GPS_GSV_Sat _work[GPS_GSV_MAX_SATS];
+    //! Number of valid entries in _work[]
+    int _work_sats;
+    //! The sentence number we expect next, 0 when idle
+    int _expect;
+};
+
+#endif
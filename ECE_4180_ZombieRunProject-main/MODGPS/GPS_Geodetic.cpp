@@ -33,6 +33,7 @@ GPS_Geodetic::nmea_gga(char *s) {
     char *qual      = (char *)NULL;
     char *altitude  = (char *)NULL;
     char *sats      = (char *)NULL;
+    char *dop       = (char *)NULL;
             
     token = strtok(s, ",");
     while (token) {
@@ -43,6 +44,7 @@ GPS_Geodetic::nmea_gga(char *s) {
                 case 5:  lon_dir   = token; break;    
                 case 6:  qual      = token; break;
                 case 7:  sats      = token; break;
+                case 8:  dop       = token; break;
                 case 9:  altitude  = token; break;
         }
         token = strtok((char *)NULL, ",");
@@ -50,49 +52,78 @@ GPS_Geodetic::nmea_gga(char *s) {
     }
 
     // If the fix quality is valid set our location information. 
-    if (latitude && longitude && altitude && sats) {         
-        lat = convert_lat_coord(latitude,  lat_dir[0]);
-        lon = convert_lon_coord(longitude, lon_dir[0]);
-        alt = convert_height(altitude);        
+    if (latitude && longitude && lat_dir && lon_dir && qual && altitude && sats) {         
         num_of_gps_sats = atoi(sats);
         gps_satellite_quality = atoi(qual);
+        hdop = dop ? atof(dop) : 99.99;
+        // These clear the quality if their field is malformed, the last
+        // position must not go out again as this fix.
+        lat = convert_lat_coord(latitude,  lat_dir[0]);
+        lon = convert_lon_coord(longitude, lon_dir[0]);
+        alt = convert_height(altitude);
     }
     else {
         gps_satellite_quality = 0;
     }    
 }
 
+bool
+GPS_Geodetic::parse_coord_e7(const char *s, bool negative, int32_t *out)
+{
+    const char *dot = s;
+    int32_t deg = 0, min_e7 = 0, scale = 1000000;
+    int n;
+    
+    while (*dot >= '0' && *dot <= '9') dot++;
+    n = dot - s;
+    if (n < 3 || n > 5) return false;
+    
+    // Whole degrees then two whole minute digits.
+    while (s < dot - 2) deg = deg * 10 + (*s++ - '0');
+    min_e7 = ((s[0] - '0') * 10 + (s[1] - '0')) * 10000000;
+    if (min_e7 >= 600000000 || deg > 180) return false;
+    
+    // Up to seven decimal minutes, 1e-7 minute fits in int32 up to 60'.
+    if (*dot == '.') {
+        for (s = dot + 1; *s >= '0' && *s <= '9' && scale; s++, scale /= 10) {
+            min_e7 += (*s - '0') * scale;
+        }
+    }
+    
+    // 1e-7 minutes to 1e-7 degrees, rounded.
+    deg = deg * 10000000 + (min_e7 + 30) / 60;
+    *out = negative ? -deg : deg;
+    return true;
+}
+
 double 
 GPS_Geodetic::convert_lat_coord(char *s, char north_south) 
 {
-    int deg, min, sec;
-    double fsec, val;
+    int32_t val;
     
-    deg  = ( (s[0] - '0') * 10) + s[1] - '0';
-    min  = ( (s[2] - '0') * 10) + s[3] - '0';
-    sec  = ( ((s[5] - '0') * 1000) + ((s[6] - '0') * 100) + ((s[7] - '0') * 10) + (s[8] - '0'));
-    fsec = (double)((double)sec /10000.0);
-    val  = (double)deg + ((double)((double)min/60.0)) + (fsec/60.0);
-    if (north_south == 'S') { val *= -1.0; }
-    lat = val;
-    return val;
+    if (parse_coord_e7(s, north_south == 'S', &val) && val >= -900000000 && val <= 900000000) {
+        lat_e7 = val;
+        lat = (double)val * 1.0e-7;
+    }
+    else {
+        gps_satellite_quality = 0;
+    }
+    return lat;
 }
 
 double 
 GPS_Geodetic::convert_lon_coord(char *s, char east_west) 
 {
-    int deg, min, sec;
-    double fsec, val;
+    int32_t val;
     
-    deg  = ( (s[0] - '0') * 100) + ((s[1] - '0') * 10) + (s[2] - '0');
-    min  = ( (s[3] - '0') * 10) + s[4] - '0';
-    sec  = ( ((s[6] - '0') * 1000) + ((s[7] - '0') * 100) + ((s[8] - '0') * 10) + (s[9] - '0'));
-    fsec = (double)((double)sec /10000.0);
-    val  = (double)deg + ((double)((double)min/60.0)) + (fsec/60.0);
-    if (east_west == 'W') { val *= -1.0; }
-    lon = val;
-    return val;
-
+    if (parse_coord_e7(s, east_west == 'W', &val) && val >= -1800000000 && val <= 1800000000) {
+        lon_e7 = val;
+        lon = (double)val * 1.0e-7;
+    }
+    else {
+        gps_satellite_quality = 0;
+    }
+    return lon;
 }
 
 double 
@@ -36,16 +36,50 @@ public:
     //! double The longitude
     double lon; 
     
+    //! int32_t The latitude in units of 1e-7 degree (lat is derived from this)
+    int32_t lat_e7;
+    
+    //! int32_t The longitude in units of 1e-7 degree (lon is derived from this)
+    int32_t lon_e7;
+    
     //! double The altitude
     double alt; 
     
+    //! double The horizontal dilution of precision (from the same GGA)
+    double hdop;
+    
     int num_of_gps_sats;
     int gps_satellite_quality;
-    GPS_Geodetic() { lat = 0.0; lon = 0.0; alt = 0.0; }
+    
+    //! us_ticker time the fix was measured at (see GPS::fixTimestamp())
+    uint32_t timestamp_us;
+    //! true if timestamp_us was disciplined by the 1PPS edge
+    bool pps_locked;
+    //! Incremented on every GGA, tells a new fix from a re-read one
+    uint32_t seq;
+    
+    GPS_Geodetic() { lat = 0.0; lon = 0.0; lat_e7 = 0; lon_e7 = 0; alt = 0.0; hdop = 99.99; num_of_gps_sats = 0; gps_satellite_quality = 0; timestamp_us = 0; pps_locked = false; seq = 0; }
     
     int numOfSats(void) { return num_of_gps_sats; }
     int getGPSquality(void) { return gps_satellite_quality; }
+    double getHdop(void) { return hdop; }
     void nmea_gga(char *s);
+    
+    /** Convert an NMEA ddmm.mmmm... field to 1e-7 degree units.
+     *
+     * Takes any number of minute decimals (digits past the seventh are
+     * dropped, the seventh rounds) and uses integer operations only.
+     * The degrees are whatever precedes the two minute digits so the
+     * same function does latitude (dd) and longitude (ddd).
+     *
+     * @param s The NMEA field.
+     * @param negative true for 'S' or 'W'.
+     * @param out The result.
+     * @return bool false if the field is malformed or out of range.
+     */
+    static bool parse_coord_e7(const char *s, bool negative, int32_t *out);
+    
+    //! Parse a GGA latitude or longitude, a malformed one clears the fix quality.
     double convert_lat_coord(char *s, char north_south);
     double convert_lon_coord(char *s, char east_west);
     double convert_height(char *s);
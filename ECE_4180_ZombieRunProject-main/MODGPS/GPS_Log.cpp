@@ -0,0 +1,176 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include "GPS.h"
+#include "us_ticker_api.h"
+
+void
+GPS_Log::reset(void)
+{
+    _head = 0;
+    _tail = 0;
+    _overruns = 0;
+    _blk[0].len = 0;
+}
+
+bool
+GPS_Log::begin(FILE *fp)
+{
+    return fp && fwrite(GPS_LOG_MAGIC, 1, 4, fp) == 4;
+}
+
+// Hand the head block to flush() and start the next, or if flush() has
+// fallen behind drop it and fill it again.
+void
+GPS_Log::close(uint32_t now)
+{
+    int next = (_head + 1) % GPS_LOG_BLOCKS;
+    
+    _blk[_head].stamp = now;
+    if (next == _tail) {
+        _overruns++;
+        _blk[_head].len = 0;
+        return;
+    }
+    _blk[next].len = 0;
+    _head = next;
+}
+
+void
+GPS_Log::put(uint8_t c, uint32_t now)
+{
+    GPS_LogBlock *b = &_blk[_head];
+    
+    b->data[b->len++] = c;
+    if (c == '\n' || b->len == GPS_LOG_BLOCK_LEN) close(now);
+}
+
+void
+GPS_Log::pps(uint32_t now)
+{
+    // A partly filled block goes first so the edge stays in order,
+    // then the edge itself as an empty block.
+    if (_blk[_head].len) close(now);
+    close(now);
+}
+
+int
+GPS_Log::flush(FILE *fp)
+{
+    uint8_t hdr[5];
+    int n = 0;
+    
+    while (_tail != _head) {
+        GPS_LogBlock *b = &_blk[_tail];
+        hdr[0] = b->stamp;
+        hdr[1] = b->stamp >> 8;
+        hdr[2] = b->stamp >> 16;
+        hdr[3] = b->stamp >> 24;
+        hdr[4] = b->len;
+        if (fwrite(hdr, 1, 5, fp) != 5) return -1;
+        if (b->len && fwrite(b->data, 1, b->len, fp) != b->len) return -1;
+        n += 5 + b->len;
+        _tail = (_tail + 1) % GPS_LOG_BLOCKS;
+    }
+    return n;
+}
+
+GPS_Replay::GPS_Replay(GPS *gps)
+{
+    _gps = gps;
+    _fp = (FILE *)NULL;
+    _num = 1;
+    _den = 1;
+    _pending = false;
+    _records = 0;
+}
+
+bool
+GPS_Replay::open(FILE *fp)
+{
+    char magic[4];
+    
+    _fp = fp;
+    _pending = false;
+    _records = 0;
+    if (!fp || fread(magic, 1, 4, fp) != 4 || memcmp(magic, GPS_LOG_MAGIC, 4)) return false;
+    if (!read()) return false;
+    _recorded = 0;
+    _lastStamp = _next.stamp;
+    _elapsed = 0;
+    _start = _lastTick = us_ticker_read();
+    return true;
+}
+
+bool
+GPS_Replay::read(void)
+{
+    uint8_t hdr[5];
+    
+    _pending = false;
+    if (fread(hdr, 1, 5, _fp) != 5) return false;
+    _next.stamp = hdr[0] | (hdr[1] << 8) | (hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+    _next.len = hdr[4];
+    if (_next.len > GPS_LOG_BLOCK_LEN) return false;
+    if (_next.len && fread(_next.data, 1, _next.len, _fp) != _next.len) return false;
+    // Stamps wrap with us_ticker, the gap to the last one doesn't.
+    if (_records) _recorded += (uint32_t)(_next.stamp - _lastStamp);
+    _lastStamp = _next.stamp;
+    _pending = true;
+    return true;
+}
+
+int
+GPS_Replay::step(void)
+{
+    uint64_t due;
+    uint32_t now, tick;
+    int i;
+    
+    while (_pending) {
+        if (_num) {
+            due = _recorded * _den / _num;
+            tick = us_ticker_read();
+            _elapsed += (uint32_t)(tick - _lastTick);
+            _lastTick = tick;
+            if (due > _elapsed) return due - _elapsed > 0x7fffffff ? 0x7fffffff : (int)(due - _elapsed);
+            now = _start + (uint32_t)due;
+        }
+        else {
+            now = _next.stamp;
+        }
+        
+        if (_next.len == 0) {
+            _gps->pps_event(now);
+        }
+        for (i = 0; i < _next.len; i++) {
+            _gps->rx_byte(_next.data[i], now);
+            if (_next.data[i] == '\n') _gps->poll();
+        }
+        _records++;
+        
+        read();
+        if (!_num) return _pending ? 0 : -1;
+    }
+    return -1;
+}
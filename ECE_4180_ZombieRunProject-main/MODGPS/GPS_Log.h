@@ -0,0 +1,188 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#ifndef GPS_LOG_H
+#define GPS_LOG_H
+
+#include "mbed.h"
+#include <stdio.h>
+
+class GPS;
+
+// Ring of blocks between the serial ISR and the thread writing the file.
+#ifndef GPS_LOG_BLOCKS
+#define GPS_LOG_BLOCKS     32
+#endif
+
+#ifndef GPS_LOG_BLOCK_LEN
+#define GPS_LOG_BLOCK_LEN  60
+#endif
+
+// First bytes of a recording.
+#define GPS_LOG_MAGIC      "GLG1"
+
+/** One record of a recording.
+ *
+ * On file a record is the stamp (4 bytes, little endian), the length
+ * (1 byte) and that many bytes as they came off the UART. A zero
+ * length record is a 1PPS edge.
+ */
+struct GPS_LogBlock {
+    uint32_t stamp;
+    uint8_t  len;
+    uint8_t  data[GPS_LOG_BLOCK_LEN];
+};
+
+/** GPS_Log definition.
+ *
+ * Records every byte the GPS receives, and every 1PPS edge, with the
+ * us_ticker time it arrived. The ISR side only copies into a ring of
+ * blocks, a thread calls flush() to write completed blocks to a file.
+ * The recording is played back through GPS_Replay.
+ *
+ * @code
+ * GPS_Log log;
+ * FILE *fp = fopen("/sd/gps.log", "wb");
+ * log.begin(fp);
+ * gps.attachLog(&log);
+ * while (running) {
+ *     Thread::wait(100);
+ *     log.flush(fp);
+ * }
+ * gps.attachLog(NULL);
+ * fclose(fp);
+ * @endcode
+ */
+class GPS_Log {
+public:
+    GPS_Log() { reset(); }
+    
+    //! Empty the ring.
+    void reset(void);
+    
+    //! Write the file header, call once before the first flush().
+    bool begin(FILE *fp);
+    
+    //! Add a received byte, called from the serial ISR.
+    void put(uint8_t c, uint32_t now);
+    
+    //! Add a 1PPS edge, called from the PPS ISR.
+    void pps(uint32_t now);
+    
+    //! Write all completed blocks, returns the bytes written or -1.
+    int flush(FILE *fp);
+    
+    //! Blocks lost because flush() was not called often enough.
+    uint32_t overruns(void) { return _overruns; }
+    
+protected:
+    GPS_LogBlock _blk[GPS_LOG_BLOCKS];
+    
+    //! Block being filled by the ISR.
+    volatile int _head;
+    
+    //! Next block for flush() to write.
+    volatile int _tail;
+    
+    uint32_t _overruns;
+    
+    void close(uint32_t now);
+};
+
+/** GPS_Replay definition.
+ *
+ * Feeds a GPS_Log recording into a GPS object as if it came from the
+ * UART, through GPS::rx_byte() and GPS::pps_event(), so the parser,
+ * the callbacks and everything after them see exactly the same input.
+ *
+ * At speed 1 the records are fed at their recorded times, at 10 ten
+ * times faster, at 1/2 half as fast. With speed 0 they are fed as fast
+ * as step() is called and keep their recorded stamps, which makes a run
+ * deterministic. Otherwise the stamps are moved to now so they agree
+ * with us_ticker.
+ *
+ * Both clocks are 64 bit counts of us_ticker deltas and the schedule is
+ * integer arithmetic, so a recording, or a slowed down replay, longer
+ * than us_ticker's 71.6 minutes plays on time to the end. Records more
+ * than 71.6 minutes apart can't be told from ones in the right order.
+ *
+ * Each sentence is processed as soon as its '\n' is fed, with
+ * GPS::poll(), so playback is not limited by the 10ms ticker.
+ *
+ * @code
+ * GPS_Replay replay(&gps);
+ * FILE *fp = fopen("/sd/gps.log", "rb");
+ * gps.rxLive(false);
+ * if (replay.open(fp)) {
+ *     replay.speed(10);
+ *     int us;
+ *     while ((us = replay.step()) >= 0) {
+ *         if (us > 1000) Thread::wait(us / 1000);
+ *     }
+ * }
+ * fclose(fp);
+ * gps.rxLive(true);
+ * @endcode
+ */
+class GPS_Replay {
+public:
+    GPS_Replay(GPS *gps);
+    
+    //! Check the header and start playback from the first record.
+    bool open(FILE *fp);
+    
+    //! Set the playback speed to num/den, 0 for as fast as possible.
+    void speed(uint32_t num, uint32_t den = 1) { _num = num; _den = den ? den : 1; }
+    
+    /** Feed every record that is due.
+     *
+     * @return int us until the next record is due, 0 if one is due now, -1 at the end.
+     */
+    int step(void);
+    
+    //! Records played so far.
+    uint32_t records(void) { return _records; }
+    
+protected:
+    GPS *_gps;
+    FILE *_fp;
+    uint32_t _num;
+    uint32_t _den;
+    GPS_LogBlock _next;
+    bool _pending;
+    
+    //! Recorded us from the first record to _next.
+    uint64_t _recorded;
+    uint32_t _lastStamp;
+    
+    //! us_ticker us since open().
+    uint64_t _elapsed;
+    uint32_t _lastTick;
+    
+    uint32_t _start;
+    uint32_t _records;
+    
+    bool read(void);
+};
+
+#endif
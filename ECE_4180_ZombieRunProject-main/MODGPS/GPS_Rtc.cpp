@@ -0,0 +1,180 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include "GPS.h"
+#include "rtos.h"
+
+// RTC clock control register bits.
+#define RTC_CCR_CLKEN   0x01
+#define RTC_CCR_CTCRST  0x02
+#define RTC_CCR_CCALEN  0x10
+
+// RTC calibration register.
+#define RTC_CALVAL_MAX  0x1FFFF
+#define RTC_CALDIR_BACK (1UL << 17)
+
+// Tries at catching a GPS second boundary before rtc_step() gives up.
+#define RTC_STEP_TRIES  5
+
+// The RTC time in ms since the epoch, the fraction from the prescaler.
+int64_t
+GPS::rtc_ms(void)
+{
+    volatile uint32_t *ctc = (volatile uint32_t *)((char *)LPC_RTC + GPS_RTC_CTC);
+    uint32_t c1, c2;
+    time_t s;
+    
+    // Read again if the second rolled over in between.
+    do {
+        c1 = *ctc & 0x7FFF;
+        s  = time(NULL);
+        c2 = *ctc & 0x7FFF;
+    }
+    while (c2 < c1);
+    
+    return (int64_t)s * 1000 + ((c1 * 1000) >> 15);
+}
+
+// Set the RTC on a GPS second boundary and zero its prescaler. Sleeps to
+// the boundary and steps to the time read on waking, if the thread was
+// held up more than GPS_RTC_STEP_LATE past it, tries the next one.
+bool
+GPS::rtc_step(void)
+{
+    uint64_t now;
+    uint32_t ms;
+    
+    for (int i = 0; i < RTC_STEP_TRIES; i++) {
+        now = theTime.epochMs();
+        Thread::wait(1000 - (uint32_t)(now % 1000));
+        
+        now = theTime.epochMs();
+        ms = (uint32_t)(now % 1000);
+        if (ms > GPS_RTC_STEP_LATE) continue;
+        
+        set_time((time_t)(now / 1000));
+        LPC_RTC->CCR |= RTC_CCR_CTCRST;
+        LPC_RTC->CCR &= ~RTC_CCR_CTCRST;
+        
+        _rtc.steps++;
+        _rtcSynced = true;
+        rtc_fit_reset(now, (int32_t)(rtc_ms() - (int64_t)theTime.epochMs()));
+        return true;
+    }
+    return false;
+}
+
+// Program the calibration to cancel a crystal error of ppm (+ is fast).
+// It moves the RTC by a whole second every calval seconds, the largest
+// calval is the smallest correction, about 7.6ppm. Less than that can't
+// be trimmed and turns the calibration off.
+void
+GPS::rtc_trim(float ppm)
+{
+    float mag = ppm < 0 ? -ppm : ppm;
+    float applied = 0.0f;
+    uint32_t calval = RTC_CALVAL_MAX + 1;
+    
+    if (mag > 0.0f) calval = (uint32_t)(1000000.0f / mag + 0.5f);
+    if (calval > RTC_CALVAL_MAX) {
+        LPC_RTC->CCR |= RTC_CCR_CCALEN;
+    } else {
+        LPC_RTC->CALIBRATION = calval | (ppm > 0 ? RTC_CALDIR_BACK : 0);
+        LPC_RTC->CCR &= ~RTC_CCR_CCALEN;
+        applied = 1000000.0f / (float)calval;
+        if (ppm < 0) applied = -applied;
+    }
+    
+    if (applied != _rtc.trimPpm) _rtc.trims++;
+    _rtc.trimPpm = applied;
+}
+
+// Start a new rate measuring window at GPS time gps.
+void
+GPS::rtc_fit_reset(uint64_t gps, int32_t offset)
+{
+    _rtcBaseMs = gps;
+    _rtcBaseOffset = offset;
+    _rtcLastOffset = offset;
+    _rtcSeconds = 0;
+    _rtcFitN = 0;
+    _rtcFitT = _rtcFitY = _rtcFitTT = _rtcFitTY = 0.0;
+}
+
+bool
+GPS::rtcDiscipline(void)
+{
+    uint64_t gps;
+    int64_t off;
+    int32_t offset, delta;
+    double t, y, n, den;
+    float ppm;
+    
+    if (theTime.status != 'A') return false;
+    
+    gps = theTime.epochMs();
+    off = rtc_ms() - (int64_t)gps;
+    
+    // An unset RTC can be decades out, that is a step not a statistic.
+    if (!_rtcSynced || off > GPS_RTC_STEP_MS || off < -GPS_RTC_STEP_MS) {
+        rtc_step();
+        return true;
+    }
+    
+    offset = (int32_t)off;
+    _rtc.offsetMs = offset;
+    if (_rtc.samples == 0 || offset < _rtc.minOffsetMs) _rtc.minOffsetMs = offset;
+    if (_rtc.samples == 0 || offset > _rtc.maxOffsetMs) _rtc.maxOffsetMs = offset;
+    _rtc.samples++;
+    
+    // The calibration moves the RTC a whole second at a time, take those
+    // out and in between the offset drifts at the crystal's own rate.
+    delta = offset - _rtcLastOffset;
+    _rtcSeconds += ((delta + (delta < 0 ? -500 : 500)) / 1000) * 1000;
+    _rtcLastOffset = offset;
+    
+    t = (double)(uint32_t)(gps - _rtcBaseMs) / 1000.0;
+    y = (double)(offset - _rtcSeconds - _rtcBaseOffset);
+    _rtcFitN++;
+    _rtcFitT += t;
+    _rtcFitY += y;
+    _rtcFitTT += t * t;
+    _rtcFitTY += t * y;
+    
+    if ((uint32_t)(gps - _rtcBaseMs) >= GPS_RTC_TRIM_WINDOW && _rtcFitN >= GPS_RTC_FIT_MIN) {
+        // GPS time moves in 10ms steps, two offsets an hour apart would be
+        // +-2.8ppm out on that alone. The least squares slope of every
+        // offset in the window averages it down, ms/s is 1000ppm.
+        n = (double)_rtcFitN;
+        den = n * _rtcFitTT - _rtcFitT * _rtcFitT;
+        if (den > 0.0) {
+            ppm = (float)((n * _rtcFitTY - _rtcFitT * _rtcFitY) / den * 1000.0);
+            _rtc.ppm = ppm;
+            if (ppm - _rtc.trimPpm > GPS_RTC_TRIM_PPM || ppm - _rtc.trimPpm < -GPS_RTC_TRIM_PPM) {
+                rtc_trim(ppm);
+            }
+        }
+        rtc_fit_reset(gps, offset);
+    }
+    return true;
+}
@@ -37,25 +37,88 @@ GPS_Time::GPS_Time()
     track = 0;    
     magvar_dir = 'W';
     magvar = 0;
+    _ms = GPS_TIME_Y2K_MS;
+    _sidAnchorMs = 0;
+    _sidAnchorDeg = 0;
+    _sidStale = true;
+}
+
+uint64_t
+GPS_Time::epochMs(void)
+{
+    uint64_t a, b;
+    do { a = _ms; b = _ms; } while (a != b);
+    return a;
+}
+
+// Howard Hinnant's days_from_civil(), valid for the proleptic Gregorian
+// calendar without any table or month 13 to get wrong.
+int32_t
+GPS_Time::days_from_civil(int y, int m, int d)
+{
+    int era, yoe, doy, doe;
+    
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void
+GPS_Time::civil_from_days(int32_t z, int *y, int *m, int *d)
+{
+    int era, doe, yoe, doy, mp;
+    
+    z += 719468;
+    era = (z >= 0 ? z : z - 146096) / 146097;
+    doe = z - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp  = (5 * doy + 2) / 153;
+    *d  = doy - (153 * mp + 2) / 5 + 1;
+    *m  = mp < 10 ? mp + 3 : mp - 9;
+    *y  = yoe + era * 400 + (*m <= 2);
+}
+
+void
+GPS_Time::set(int y, int mo, int d, int h, int mi, int s, int ms)
+{
+    int32_t days = days_from_civil(y, mo, d);
+    int32_t msday = (((h * 60) + mi) * 60 + s) * 1000 + ms;
+    
+    // ms may be under 0 or over 999, the sum carries into the second.
+    _ms = (uint64_t)((int64_t)days * 86400000LL + msday);
+    _sidStale = true;
+}
+
+void
+GPS_Time::compose(void)
+{
+    set(year, month, day, hour, minute, second, tenths * 100 + hundreths * 10);
+}
+
+void
+GPS_Time::decompose(void)
+{
+    uint64_t t = epochMs();
+    int32_t days = (int32_t)(t / 86400000ULL);
+    uint32_t ms = (uint32_t)(t - (uint64_t)days * 86400000ULL);
+    
+    civil_from_days(days, &year, &month, &day);
+    hour      = ms / 3600000; ms %= 3600000;
+    minute    = ms / 60000;   ms %= 60000;
+    second    = ms / 1000;    ms %= 1000;
+    tenths    = ms / 100;
+    hundreths = (ms / 10) % 10;
 }
 
 time_t
 GPS_Time::to_C_tm(bool set) 
 {
-    GPS_Time t;
-    tm       ct;
-    time_t   q;
+    time_t q = (time_t)(epochMs() / 1000);
     
-    timeNow(&t);
-    ct.tm_sec       = t.second;
-    ct.tm_min       = t.minute;
-    ct.tm_hour      = t.hour;
-    ct.tm_mday      = t.day;
-    ct.tm_mon       = t.month - 1;
-    ct.tm_year      = t.year - 1900;
-    ct.tm_isdst     = 0; // GPS has no understanding of DST.    
-    
-    q = mktime(&ct);
     if (set) {
         set_time(q);
     }
@@ -71,58 +134,35 @@ GPS_Time::timeNow(GPS_Time *n)
         memcpy(n, this, sizeof(GPS_Time));
     }
     while (memcmp(n, this, sizeof(GPS_Time)));
+    n->decompose();
     return n;    
 }
 
+void
+GPS_Time::fractionalReset(void)
+{
+    _ms -= _ms % 1000;
+}
+
+// The 10ms tick.
 void
 GPS_Time::operator++()
 {
-    hundreths++;
-    if (hundreths == 10) {
-        hundreths = 0;
-        tenths++;
-        if (tenths == 10) {
-            tenths = hundreths = 0;
-        }
-    }
+    _ms += 10;
 }
 
+// The next whole second.
 void
 GPS_Time::operator++(int)
 {
-    const int days[12] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
-    bool dateInc = false;
-    
-    tenths = hundreths = 0;
-    second++;
-    
-    if (second == 60) {
-        second = 0;
-        minute++;
-        if (minute == 60) {
-            minute = 0;
-            hour++;
-            if (hour == 24) {
-                hour = 0;
-                dateInc = true;
-            }
-        }
-    }
-    
-    if (dateInc) {
-        /* Handle February leap year. */    
-        int leap_year = ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0) ? 1 : 0;
-        int days_this_month = days[month - 1];
-        if (month == 2 && leap_year) days_this_month++;        
-        day++;
-        if (day > days_this_month) {
-            day = 1;
-            month++;
-            if (month == 13) {
-                year++;
-            }
-        }
-    }
+    _ms += 1000 - (_ms % 1000);
+}
+
+void
+GPS_Time::ppsEdge(void)
+{
+    uint64_t t = _ms + 500;
+    _ms = t - (t % 1000);
 }
 
 // $GPRMC,112709.735,A,5611.5340,N,00302.0306,W,000.0,307.0,150411,,,A*70
@@ -138,6 +178,7 @@ GPS_Time::nmea_rmc(char *s)
     char *trk    = (char *)NULL;
     char *magv   = (char *)NULL;
     char *magd   = (char *)NULL;
+    int  ms;
 
     token = strtok(s, ",");
     while (token) {
@@ -154,40 +195,54 @@ GPS_Time::nmea_rmc(char *s)
         token_counter++;
     }
     
-    if (stat && date && time) {
+    if (stat && date && time && strlen(date) >= 6 && strlen(time) >= 6) {
         hour       = (char)((time[0] - '0') * 10) + (time[1] - '0');
         minute     = (char)((time[2] - '0') * 10) + (time[3] - '0');
         second     = (char)((time[4] - '0') * 10) + (time[5] - '0');
         day        = (char)((date[0] - '0') * 10) + (date[1] - '0');
         month      = (char)((date[2] - '0') * 10) + (date[3] - '0');
         year       =  (int)((date[4] - '0') * 10) + (date[5] - '0') + 2000;
+        // At 5 or 10Hz every fix in a second has its own fraction.
+        ms         = nmea_ms(time);
+        if (ms < 0) ms = 0;
+        tenths     = ms / 100;
+        hundreths  = (ms / 10) % 10;
+        // Not compose(), that would lose the ms of an hhmmss.sss.
+        if (month >= 1 && month <= 12 && day >= 1 && day <= 31) set(year, month, day, hour, minute, second, ms);
         status     = stat[0];
-        velocity   = atof(vel);
-        track      = atof(trk);
-        magvar     = atof(magv);
-        magvar_dir = magd[0];
+        velocity   = vel  ? atof(vel)  : 0.0;
+        track      = trk  ? atof(trk)  : 0.0;
+        magvar     = magv ? atof(magv) : 0.0;
+        magvar_dir = magd ? magd[0]    : 0;
     }    
 }
 
+// Millisecond of the second from an NMEA hhmmss.sss time field, or -1.
+int
+GPS_Time::nmea_ms(const char *t)
+{
+    int i, ms = 0, scale = 100;
+    
+    for (i = 0; i < 6; i++) {
+        if (t[i] < '0' || t[i] > '9') return -1;
+    }
+    if (t[6] != '.') return 0;
+    for (i = 7; t[i] >= '0' && t[i] <= '9' && scale; i++) {
+        ms += (t[i] - '0') * scale;
+        scale /= 10;
+    }
+    return ms;
+}
+
 double 
 GPS_Time::julian_day_number(GPS_Time *t) {
-    double wikipedia_jdn = (double)(1461 * ((int)t->year + 4800 + ((int)t->month - 14) / 12)) / 4 + (367 * ((int)t->month - 2 - 12 * (((int)t->month - 14) / 12))) / 12 - (3 * (((int)t->year + 4900 + ((int)t->month - 14) / 12 ) / 100)) / 4 + (int)t->day - 32075;    
-    return wikipedia_jdn;
+    // 1970-01-01 is JDN 2440588.
+    return (double)((int32_t)(t->epochMs() / 86400000ULL) + 2440588);
 }
 
 double 
 GPS_Time::julian_date(GPS_Time *t) {
-    double hour, minute, second, jd;
-    hour   = (double)t->hour;
-    minute = (double)t->minute;
-    second = (double)t->second + ((double)t->tenths / 10.) + ((double)t->hundreths / 100.);
-                                 
-    jd = julian_day_number(t) -  0.5 +
-         ((hour - 12.) / 24.) +
-         (minute / 1440.) + 
-         (second / 86400.);        
-        
-    return jd;
+    return GPS_TIME_JD_1970 + (double)t->epochMs() * (1.0 / 86400000.0);
 }
 
 double 
@@ -210,10 +265,40 @@ GPS_Time::siderealDegrees(double jd, double longitude) {
     return lmst;
 }
 
+double
+GPS_Time::gmstDegrees(void) {
+    uint64_t ms = epochMs();
+    double d;
+    
+    if (_sidStale) {
+        // Days from J2000 taken from the ms count rather than a Julian
+        // date, which a double only holds to ~50us.
+        double T  = (double)(int64_t)(ms - GPS_TIME_J2000_MS) / 86400000.0;
+        double T1 = T / 36525.0;
+        double T2 = T1 * T1;
+        double T3 = T2 * T1;
+        
+        _sidStale = false;
+        d = 280.46061837 + (360.98564736629 * T) + (0.000387933 * T2) - (T3 / 38710000.0);
+        d = fmod(d, 360.0);
+        if (d < 0.0) d += 360.0;
+        _sidAnchorDeg = d;
+        _sidAnchorMs  = ms;
+        return d;
+    }
+    
+    d = _sidAnchorDeg + (double)(int64_t)(ms - _sidAnchorMs) * GPS_TIME_SID_DEG_PER_MS;
+    if (d >= 360.0 || d < 0.0) {
+        d = fmod(d, 360.0);
+        if (d < 0.0) d += 360.0;
+    }
+    return d;
+}
+
 double 
 GPS_Time::siderealDegrees(GPS_Time *t, double longitude) {
-    if (t == NULL) t = new GPS_Time;
-    return siderealDegrees(julian_date(t), longitude);
+    if (t == NULL) t = this;
+    return t->gmstDegrees() + longitude;
 }
 
 double 
@@ -25,7 +25,25 @@
 
 #include "mbed.h"
 
+// Milliseconds from 1970-01-01 to 2000-01-01, the default time.
+#define GPS_TIME_Y2K_MS  946684800000ULL
+
+// Julian date of the Unix epoch.
+#define GPS_TIME_JD_1970 2440587.5
+
+// J2000.0 (2000-01-01 12:00) in ms since the Unix epoch.
+#define GPS_TIME_J2000_MS 946728000000ULL
+
+// Sidereal rate in degrees per ms of UT.
+#define GPS_TIME_SID_DEG_PER_MS (360.98564736629 / 86400000.0)
+
 /** GPS_Time definition.
+ *
+ * The time is kept as one 64 bit count of milliseconds since the Unix
+ * epoch, so the 10ms tick is a single add and the Julian date and
+ * time_t are arithmetic on it. The date/time fields below are only
+ * worked out when a copy is taken with timeNow(), or on demand with
+ * decompose(). After setting the fields directly call compose().
  */
 class GPS_Time {
 public:
@@ -58,9 +76,31 @@ public:
     double magvar;
     
     GPS_Time();
-    void fractionalReset(void) { tenths = hundreths = 0; }
+    void fractionalReset(void);
     void operator++();
     void operator++(int);
+    
+    //! Snap to the nearest whole second, for a 1PPS edge.
+    void ppsEdge(void);
+    
+    //! Milliseconds since 1970-01-01 00:00:00 UTC.
+    uint64_t epochMs(void);
+    
+    //! Set the time from calendar fields (UTC), ms may carry into the next or last second.
+    void set(int y, int mo, int d, int h, int mi, int s, int ms);
+    
+    //! Set the time from the year..hundreths fields.
+    void compose(void);
+    
+    //! Update the year..hundreths fields from the time.
+    void decompose(void);
+    
+    //! Days since 1970-01-01 of a date, or the date of a day count.
+    static int32_t days_from_civil(int y, int m, int d);
+    static void civil_from_days(int32_t z, int *y, int *m, int *d);
+    
+    //! Millisecond of the second from an NMEA hhmmss.sss time field, or -1.
+    static int nmea_ms(const char *t);
     GPS_Time * timeNow(GPS_Time *n);
     GPS_Time * timeNow(void) { return timeNow(NULL); }
     void nmea_rmc(char *s);
@@ -74,11 +114,31 @@ public:
     double julian_date(GPS_Time *t);
     double julian_day_number(void) { return julian_day_number(this); }
     double julian_date(void) { return julian_date(this); }   
+    
+    //! Greenwich mean sidereal time in degrees, [0, 360).
+    /**
+     * Worked out in full (the IAU polynomial) once after each time fix
+     * and from then on advanced linearly with the ms count, so a query
+     * is one multiply-add. The quadratic and cubic terms change the
+     * rate by less than 1e-9 degree a day so the error stays below the
+     * 1e-6 degree of the anchor itself.
+     */
+    double gmstDegrees(void);
+    
     double siderealDegrees(double jd, double longitude);
     double siderealDegrees(GPS_Time *t, double longitude);
     double siderealHA(double jd, double longitude);
     double siderealHA(GPS_Time *t, double longitude);
     time_t to_C_tm(bool set = false);
+    
+protected:
+    //! The time, see epochMs().
+    volatile uint64_t _ms;
+    
+    //! GMST anchor for gmstDegrees(), redone after each set().
+    uint64_t _sidAnchorMs;
+    double _sidAnchorDeg;
+    volatile bool _sidStale;
 };
 
 #endif
@@ -0,0 +1,121 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include "GPS_UBX.h"
+
+enum {
+    ubxIdle = 0,
+    ubxSync2,
+    ubxClass,
+    ubxId,
+    ubxLen1,
+    ubxLen2,
+    ubxPayload,
+    ubxCkA,
+    ubxCkB
+};
+
+GPS_UBX::GPS_UBX() 
+{
+    _state = ubxIdle;
+    _count = 0;
+    _ck_a = _ck_b = 0;
+    errors = 0;
+    memset(&msg, 0, sizeof(msg));
+}
+
+GPS_UBX::feedResult
+GPS_UBX::feed(uint8_t c)
+{
+    // The checksum covers class, id, length and payload.
+    if (_state >= ubxClass && _state <= ubxPayload) {
+        _ck_a += c;
+        _ck_b += _ck_a;
+    }
+    
+    switch (_state) {
+        case ubxIdle:
+            if (c != GPS_UBX_SYNC1) return ubxNotMine;
+            _state = ubxSync2;
+            break;
+        case ubxSync2:
+            if (c != GPS_UBX_SYNC2) { _state = ubxIdle; return ubxNotMine; }
+            _ck_a = _ck_b = 0;
+            _state = ubxClass;
+            break;
+        case ubxClass:
+            msg.cls = c;
+            _state = ubxId;
+            break;
+        case ubxId:
+            msg.id = c;
+            _state = ubxLen1;
+            break;
+        case ubxLen1:
+            msg.len = c;
+            _state = ubxLen2;
+            break;
+        case ubxLen2:
+            msg.len |= (uint16_t)c << 8;
+            // Nothing MODGPS reads is this long, it is a corrupt length.
+            // Reading on would swallow up to 64k of the NMEA behind it.
+            if (msg.len > GPS_UBX_PAYLOAD_LEN) { errors++; _state = ubxIdle; break; }
+            _count = 0;
+            _state = msg.len ? ubxPayload : ubxCkA;
+            break;
+        case ubxPayload:
+            msg.payload[_count] = c;
+            if (++_count >= msg.len) _state = ubxCkA;
+            break;
+        case ubxCkA:
+            if (c != _ck_a) { errors++; _state = ubxIdle; break; }
+            _state = ubxCkB;
+            break;
+        case ubxCkB:
+            _state = ubxIdle;
+            if (c != _ck_b) { errors++; break; }
+            return ubxFrame;
+    }
+    return ubxMore;
+}
+
+int
+GPS_UBX::build(uint8_t *out, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+    uint8_t ck_a = 0, ck_b = 0;
+    int i;
+    
+    out[0] = GPS_UBX_SYNC1;
+    out[1] = GPS_UBX_SYNC2;
+    out[2] = cls;
+    out[3] = id;
+    put16(&out[4], len);
+    for (i = 0; i < len; i++) out[6 + i] = payload[i];
+    for (i = 2; i < 6 + len; i++) {
+        ck_a += out[i];
+        ck_b += ck_a;
+    }
+    out[6 + len] = ck_a;
+    out[7 + len] = ck_b;
+    return len + GPS_UBX_OVERHEAD;
+}
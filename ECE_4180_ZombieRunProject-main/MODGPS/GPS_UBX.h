@@ -0,0 +1,106 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#ifndef GPS_UBX_H
+#define GPS_UBX_H
+
+#include "mbed.h"
+
+#define GPS_UBX_SYNC1        0xB5
+#define GPS_UBX_SYNC2        0x62
+#define GPS_UBX_PAYLOAD_LEN  100
+#define GPS_UBX_OVERHEAD     8
+
+// Message classes/ids used by MODGPS.
+#define UBX_CLASS_NAV        0x01
+#define UBX_CLASS_ACK        0x05
+#define UBX_CLASS_CFG        0x06
+#define UBX_CLASS_NMEA       0xF0
+#define UBX_ACK_NAK          0x00
+#define UBX_ACK_ACK          0x01
+#define UBX_CFG_PRT          0x00
+#define UBX_CFG_MSG          0x01
+#define UBX_CFG_RATE         0x08
+#define UBX_NAV_DOP          0x04
+#define UBX_NAV_PVT          0x07
+
+// NAV-DOP is iTOW and seven DOPs, hDOP at offset 12.
+#define UBX_NAV_DOP_LEN      18
+
+// NAV-PVT is 84 bytes on protocol 14 (u-blox 7), 92 bytes from u-blox 8.
+#define UBX_NAV_PVT_MIN_LEN  84
+
+/** GPS_UBX_Msg definition, one decoded UBX frame.
+ */
+struct GPS_UBX_Msg {
+    //! Message class
+    uint8_t  cls;
+    //! Message id
+    uint8_t  id;
+    //! Payload length
+    uint16_t len;
+    //! Payload, little endian fields as sent by the receiver
+    uint8_t  payload[GPS_UBX_PAYLOAD_LEN];
+};
+
+/** GPS_UBX definition, a byte at a time UBX binary frame decoder.
+ *
+ * Frames are "B5 62 class id len(2) payload ck_a ck_b". NMEA is 7 bit
+ * ASCII so a 0xB5 byte can never start a sentence, which is how the
+ * serial ISR tells the two protocols apart on the same UART.
+ */
+class GPS_UBX {
+public:
+
+    //! Return values of feed()
+    enum feedResult {
+        ubxNotMine = -1,    /*!< Not part of a frame, give the byte to the NMEA path. */
+        ubxMore    = 0,     /*!< Byte consumed, frame incomplete. */
+        ubxFrame   = 1      /*!< Byte consumed, msg holds a complete checked frame. */
+    };
+    
+    //! The last complete frame
+    GPS_UBX_Msg msg;
+    //! Frames dropped on bad checksum or oversize length
+    int errors;
+    
+    GPS_UBX();
+    bool active(void) { return _state != 0; }
+    feedResult feed(uint8_t c);
+    
+    static int build(uint8_t *out, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len);
+    static uint16_t u16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+    static uint32_t u32(const uint8_t *p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+    static int32_t i32(const uint8_t *p) { return (int32_t)u32(p); }
+    static void put16(uint8_t *p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+    static void put32(uint8_t *p, uint32_t v) { p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = v >> 24; }
+
+protected:
+
+    int      _state;
+    uint16_t _count;
+    uint8_t  _ck_a;
+    uint8_t  _ck_b;
+};
+
+#endif
@@ -29,6 +29,8 @@ GPS_VTG::GPS_VTG()
     _velocity_kph = 0;
     _track_true = 0;    
     _track_mag = 0;    
+    timestamp_us = 0;
+    pps_locked = false;
 }
 
 GPS_VTG *
@@ -40,6 +42,8 @@ GPS_VTG::vtg(GPS_VTG *n)
     n->_velocity_kph   = _velocity_kph;
     n->_track_true     = _track_true;
     n->_track_mag      = _track_mag;
+    n->timestamp_us    = timestamp_us;
+    n->pps_locked      = pps_locked;
     
     return n;    
 }
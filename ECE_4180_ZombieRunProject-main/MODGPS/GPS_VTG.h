@@ -38,6 +38,10 @@ public:
     double _track_true;    
     //! The track (in decimal degrees magnetic)
     double _track_mag;    
+    //! us_ticker time of the fix this vector belongs to
+    uint32_t timestamp_us;
+    //! true if timestamp_us was disciplined by the 1PPS edge
+    bool pps_locked;
     
     GPS_VTG();
     GPS_VTG * vtg(GPS_VTG *n);
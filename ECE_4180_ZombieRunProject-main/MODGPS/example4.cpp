@@ -0,0 +1,37 @@
+#ifdef COMPILE_EXAMPLE4_CODE_MODGPS
+
+// Parser benchmark, prints the cost of each NMEA parser per sentence.
+
+#include "mbed.h"
+#include "GPS.h"
+#include "GPS_Bench.h"
+
+Serial pc(USBTX, USBRX);
+
+void report(GPS_BenchResult *r) {
+    pc.printf("%-4s %5lu sentences  min %5lu  mean %5lu  max %5lu cycles  %lu ns\r\n",
+        r->name, r->sentences, r->minCycles, r->meanCycles(), r->maxCycles, r->meanNs());
+}
+
+int main() {
+    GPS_BenchResult r;
+    
+    pc.baud(115200);
+    pc.printf("MODGPS parser benchmark, %d sentences, core %lu Hz\r\n", 
+        GPS_Bench::corpusLen, SystemCoreClock);
+    
+    // Every parser gets every sentence, the wrong types and the
+    // malformed ones exercise the error paths.
+    GPS_Bench::run(&r, "GGA", GPS_Bench::gga, GPS_Bench::corpus, GPS_Bench::corpusLen, 100);
+    report(&r);
+    GPS_Bench::run(&r, "RMC", GPS_Bench::rmc, GPS_Bench::corpus, GPS_Bench::corpusLen, 100);
+    report(&r);
+    GPS_Bench::run(&r, "VTG", GPS_Bench::vtg, GPS_Bench::corpus, GPS_Bench::corpusLen, 100);
+    report(&r);
+    
+    while(1) {
+        wait(1);
+    }
+}
+
+#endif
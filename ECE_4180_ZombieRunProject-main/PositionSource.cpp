@@ -0,0 +1,130 @@
+#include "PositionSource.h"
+
+PositionSource::PositionSource()
+{
+    reset();
+}
+
+void
+PositionSource::reset(void)
+{
+    for (int i = 0; i < POSITION_SOURCES; i++) {
+        _have[i] = false;
+        _used[i] = 0;
+        _dropped[i] = 0;
+    }
+    _started = false;
+    _out_us = 0;
+    _fixes = 0;
+    _selected = positionModule;
+    _switches = 0;
+    _pairs = 0;
+    _offset_lat = 0;
+    _offset_lon = 0;
+}
+
+bool
+PositionSource::offset(int32_t *lat_e7, int32_t *lon_e7)
+{
+    *lat_e7 = _offset_lat;
+    *lon_e7 = _offset_lon;
+    return _pairs > 0;
+}
+
+// A source has a sample from within POSITION_STALE_US of now.
+bool
+PositionSource::fresh(int source, uint32_t now)
+{
+    int32_t age;
+    
+    if (!_have[source]) return false;
+    age = (int32_t)(now - _last[source].stamp_us);
+    if (age < 0) age = -age;
+    return age < POSITION_STALE_US;
+}
+
+// Compare the last phone sample with the module's, if they are a pair.
+void
+PositionSource::measure_offset(void)
+{
+    const PositionSample *m = &_last[positionModule];
+    const PositionSample *p = &_last[positionPhone];
+    int32_t dt, dlat, dlon;
+    
+    if (!_have[positionModule] || m->hdop > POSITION_FALLBACK_HDOP) return;
+    dt = (int32_t)(p->stamp_us - m->stamp_us);
+    if (dt < 0) dt = -dt;
+    if (dt >= POSITION_PAIR_US) return;
+    
+    dlat = p->lat_e7 - m->lat_e7;
+    dlon = p->lon_e7 - m->lon_e7;
+    if (_pairs < POSITION_OFFSET_SMOOTH) _pairs++;
+    
+    // A plain average until there are enough pairs, then a running one.
+    _offset_lat += (dlat - _offset_lat) / _pairs;
+    _offset_lon += (dlon - _offset_lon) / _pairs;
+}
+
+bool
+PositionSource::ingest(int source, const PositionSample *s, GPS_Geodetic *out)
+{
+    PositionSample f;
+    bool module_ok, phone_ok;
+    int follow;
+    
+    if (source < 0 || source >= POSITION_SOURCES) return false;
+    if (s->quality == 0 || (source == positionModule && s->hdop <= 0.0f)) {
+        _dropped[source]++;
+        return false;
+    }
+    _last[source] = *s;
+    _have[source] = true;
+    if (source == positionPhone) measure_offset();
+    
+    // The module while it is good, the phone when it is not, and the
+    // module anyway when there is nothing better.
+    module_ok = fresh(positionModule, s->stamp_us) && _last[positionModule].hdop <= POSITION_FALLBACK_HDOP;
+    phone_ok = fresh(positionPhone, s->stamp_us);
+    follow = (module_ok || !phone_ok) ? positionModule : positionPhone;
+    if (source != follow) {
+        _dropped[source]++;
+        return false;
+    }
+    
+    // Fixes go out in time order, the tracker and engines assume it.
+    if (_started && (int32_t)(s->stamp_us - _out_us) <= 0) {
+        _dropped[source]++;
+        return false;
+    }
+    
+    if (source != _selected) {
+        _selected = source;
+        _switches++;
+    }
+    
+    f = *s;
+    if (source == positionPhone) {
+        f.lat_e7 -= _offset_lat;
+        f.lon_e7 -= _offset_lon;
+        f.hdop = POSITION_FALLBACK_HDOP;
+    }
+    _used[source]++;
+    emit(&f, out);
+    return true;
+}
+
+void
+PositionSource::emit(const PositionSample *s, GPS_Geodetic *out)
+{
+    out->lat_e7 = s->lat_e7;
+    out->lon_e7 = s->lon_e7;
+    out->lat = (double)s->lat_e7 * 1e-7;
+    out->lon = (double)s->lon_e7 * 1e-7;
+    out->alt = s->alt;
+    out->hdop = s->hdop;
+    out->gps_satellite_quality = s->quality;
+    out->timestamp_us = s->stamp_us;
+    _out_us = s->stamp_us;
+    _started = true;
+    _fixes++;
+}
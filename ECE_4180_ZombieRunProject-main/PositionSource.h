@@ -0,0 +1,138 @@
+#ifndef POSITION_SOURCE_H
+#define POSITION_SOURCE_H
+
+#include "mbed.h"
+#include "GPS_Geodetic.h"
+
+// Number of position sources, see positionSources.
+#define POSITION_SOURCES 2
+
+// A source's last sample is ignored once it is this old, us.
+#ifndef POSITION_STALE_US
+#define POSITION_STALE_US 1500000
+#endif
+
+// The module is followed while its HDOP is no worse than this. Phone
+// fixes, which carry no accuracy, are passed on with it.
+#ifndef POSITION_FALLBACK_HDOP
+#define POSITION_FALLBACK_HDOP 4.0f
+#endif
+
+// Samples from the two sources this close in time are compared to
+// measure the offset between them, us.
+#ifndef POSITION_PAIR_US
+#define POSITION_PAIR_US 100000
+#endif
+
+// Pairs the offset is averaged over.
+#ifndef POSITION_OFFSET_SMOOTH
+#define POSITION_OFFSET_SMOOTH 8
+#endif
+
+enum positionSources {
+    positionModule = 0,     // MODGPS receiver
+    positionPhone           // Bluefruit app location packets
+};
+
+/** One position from one source. */
+struct PositionSample {
+    int32_t  lat_e7;
+    int32_t  lon_e7;
+    float    alt;
+    //! Reported accuracy as an HDOP, 0 when the source reports none.
+    float    hdop;
+    //! 0 is no fix.
+    int      quality;
+    //! us_ticker_read() when the position was measured.
+    uint32_t stamp_us;
+};
+
+/** PositionSource follows one of the module and the phone at a time.
+ *
+ * The module is followed while it has a fresh fix with an HDOP of at
+ * most POSITION_FALLBACK_HDOP, the phone otherwise. The Bluefruit app's
+ * location packets carry no accuracy, so the phone can't be weighed
+ * against the module, it is only the fallback. Samples from the source
+ * not being followed are dropped: every fix put out comes from one
+ * source, never alternates between the two.
+ *
+ * The two typically disagree by a few metres, which a switch would add
+ * to the distance as a step. While both are fresh the phone's offset
+ * from the module is averaged over POSITION_OFFSET_SMOOTH pairs of
+ * samples and taken off the phone's fixes, so a switch lands where the
+ * module would have been.
+ *
+ * Nothing here touches the hardware or the RTOS, so two recorded streams
+ * can be replayed through it on a host, see TESTS/position/replay.
+ *
+ * Example:
+ * @code
+ * PositionSource position;
+ * PositionSample s;
+ * GPS_Geodetic fix;
+ *
+ * s.lat_e7 = gga.lat_e7; s.lon_e7 = gga.lon_e7; s.alt = gga.alt;
+ * s.hdop = gga.hdop; s.quality = gga.gps_satellite_quality; s.stamp_us = gga.timestamp_us;
+ * if (position.ingest(positionModule, &s, &fix)) {
+ *     tracker.position(fix.lat, fix.lon, fix.hdop, fix.gps_satellite_quality, fix.timestamp_us);
+ * }
+ * @endcode
+ */
+class PositionSource {
+public:
+
+    PositionSource();
+    
+    //! Forget both sources.
+    void reset(void);
+    
+    /** Offer a sample from one source.
+     *
+     * @param source positionModule or positionPhone.
+     * @param s The sample.
+     * @param out Filled with the fix to use when true is returned.
+     * @return true if there is a fix to use.
+     */
+    bool ingest(int source, const PositionSample *s, GPS_Geodetic *out);
+    
+    //! Fixes put out.
+    uint32_t fixes(void) { return _fixes; }
+    
+    //! Times a sample from a source went into a fix.
+    uint32_t used(int source) { return _used[source]; }
+    
+    //! Samples from a source that were dropped.
+    uint32_t dropped(int source) { return _dropped[source]; }
+    
+    //! Source being followed.
+    int selected(void) { return _selected; }
+    
+    //! Times the source being followed changed.
+    uint32_t switches(void) { return _switches; }
+    
+    //! Phone minus module, 1e-7 degrees, false until measured.
+    bool offset(int32_t *lat_e7, int32_t *lon_e7);
+
+protected:
+
+    PositionSample _last[POSITION_SOURCES];
+    bool           _have[POSITION_SOURCES];
+    bool           _started;
+    uint32_t       _out_us;
+    uint32_t       _fixes;
+    uint32_t       _used[POSITION_SOURCES];
+    uint32_t       _dropped[POSITION_SOURCES];
+    int            _selected;
+    uint32_t       _switches;
+    
+    // Phone minus module, averaged.
+    int            _pairs;
+    int32_t        _offset_lat;
+    int32_t        _offset_lon;
+    
+    bool fresh(int source, uint32_t now);
+    void measure_offset(void);
+    void emit(const PositionSample *s, GPS_Geodetic *out);
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "Profiler.h"
+
+// RTX keeps the running task in os_tsk.run, the same pointer CMSIS hands
+// out as its osThreadId. Only the start of RTX's struct is mirrored here.
+struct ProfilerOsTsk {
+    void *run;
+    void *new_tsk;
+};
+extern "C" ProfilerOsTsk os_tsk;
+extern "C" struct OS_TCB os_idle_TCB;
+extern "C" osThreadId osThreadId_osTimerThread;
+
+static const char *const isr_names[PROFILE_ISRS] = {
+    "sampler", "blue rx", "blue tx", "audio dma", "tones", "gps tick", "gps rx"
+};
+
+Ticker        Profiler::_ticker;
+ProfileThread Profiler::_threads[PROFILE_THREADS];
+volatile int  Profiler::_count = 0;
+osThreadId    Profiler::_last = NULL;
+
+volatile uint32_t Profiler::_samples = 0;
+volatile uint32_t Profiler::_switches = 0;
+volatile uint32_t Profiler::_other = 0;
+
+uint64_t          Profiler::_isr_cycles[PROFILE_ISRS];
+volatile uint32_t Profiler::_isr_count[PROFILE_ISRS];
+volatile uint32_t Profiler::_isr_max[PROFILE_ISRS];
+
+void
+Profiler::start(void)
+{
+    // Enable the DWT cycle counter the interrupts are timed with.
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    // RTX's own threads never call attach().
+    __disable_irq();
+    ProfileThread *t = find((osThreadId)&os_idle_TCB);
+    if (t != NULL) t->name = "idle";
+    if (osThreadId_osTimerThread != NULL) {
+        t = find(osThreadId_osTimerThread);
+        if (t != NULL) t->name = "timers";
+    }
+    __enable_irq();
+
+    reset();
+    _ticker.attach_us(&Profiler::sample, PROFILE_PERIOD_US);
+}
+
+void
+Profiler::attach(const char *name, Thread *thread)
+{
+    __disable_irq();
+    ProfileThread *t = find(osThreadGetId());
+    if (t != NULL) {
+        t->name = name;
+        t->thread = thread;
+    }
+    __enable_irq();
+}
+
+void
+Profiler::reset(void)
+{
+    __disable_irq();
+    for (int i = 0; i < _count; i++) {
+        _threads[i].samples = 0;
+        _threads[i].switches = 0;
+    }
+    for (int i = 0; i < PROFILE_ISRS; i++) {
+        _isr_cycles[i] = 0;
+        _isr_count[i] = 0;
+        _isr_max[i] = 0;
+    }
+    _samples = 0;
+    _switches = 0;
+    _other = 0;
+    __enable_irq();
+}
+
+// The entry for id, a new one if there is room. Interrupts must be off,
+// or this must be the sampler.
+ProfileThread *
+Profiler::find(osThreadId id)
+{
+    for (int i = 0; i < _count; i++) {
+        if (_threads[i].id == id) return &_threads[i];
+    }
+    if (_count >= PROFILE_THREADS) return NULL;
+
+    ProfileThread *t = &_threads[_count];
+    t->id = id;
+    t->name = NULL;
+    t->thread = NULL;
+    t->samples = 0;
+    t->switches = 0;
+    _count++;
+    return t;
+}
+
+// Ticker interrupt, once per PROFILE_PERIOD_US.
+void
+Profiler::sample(void)
+{
+    PROFILE_ISR(profileIsrSampler);
+    osThreadId id = (osThreadId)os_tsk.run;
+    bool switched = id != _last;
+
+    _samples++;
+    if (switched) _switches++;
+    _last = id;
+
+    ProfileThread *t = find(id);
+    if (t == NULL) {
+        _other++;
+        return;
+    }
+    t->samples++;
+    if (switched) t->switches++;
+}
+
+// The mbed interrupts all share one priority, so they never nest and
+// this never interrupts itself.
+void
+Profiler::isrDone(int isr, uint32_t cycles)
+{
+    _isr_cycles[isr] += cycles;
+    _isr_count[isr]++;
+    if (cycles > _isr_max[isr]) _isr_max[isr] = cycles;
+}
+
+int
+Profiler::lines(void)
+{
+    return 1 + _count + PROFILE_ISRS;
+}
+
+void
+Profiler::line(int i, char *buf, int len)
+{
+    uint32_t total = _samples;
+
+    if (total == 0) total = 1;
+    if (i == 0) {
+        uint32_t ms = (uint32_t)((uint64_t)_samples * PROFILE_PERIOD_US / 1000);
+        snprintf(buf, len, "profile: %u.%03u s  %u samples  %u switches seen  %u other",
+            ms / 1000, ms % 1000, _samples, _switches, _other);
+        return;
+    }
+
+    i--;
+    if (i < _count) {
+        ProfileThread *t = &_threads[i];
+        uint32_t permille = (uint32_t)((uint64_t)t->samples * 1000 / total);
+        char id[12];
+        const char *name = t->name;
+        if (name == NULL) {
+            snprintf(id, sizeof(id), "%08x", (unsigned int)(uintptr_t)t->id);
+            name = id;
+        }
+        if (t->thread != NULL) {
+            snprintf(buf, len, "%-9s %3u.%u%% %7u sw  stack %u/%u",
+                name, permille / 10, permille % 10, t->switches,
+                t->thread->max_stack(), t->thread->stack_size());
+        } else {
+            snprintf(buf, len, "%-9s %3u.%u%% %7u sw  stack -",
+                name, permille / 10, permille % 10, t->switches);
+        }
+        return;
+    }
+
+    i -= _count;
+    if (i < PROFILE_ISRS) {
+        // Measured against the time the sampler has been running.
+        uint64_t window = (uint64_t)_samples * PROFILE_PERIOD_US * (SystemCoreClock / 1000000);
+        if (window == 0) window = 1;
+        uint32_t count = _isr_count[i];
+        uint32_t avg = count ? (uint32_t)(_isr_cycles[i] / count) : 0;
+        uint32_t permille = (uint32_t)(_isr_cycles[i] * 1000 / window);
+        snprintf(buf, len, "isr %-9s %7u x %5u cyc avg %6u max %3u.%u%%",
+            isr_names[i], count, avg, _isr_max[i], permille / 10, permille % 10);
+        return;
+    }
+
+    buf[0] = '\0';
+}
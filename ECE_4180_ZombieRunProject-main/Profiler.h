@@ -0,0 +1,143 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+// Time between samples of the running thread, us. Deliberately not a
+// whole number of RTX 1ms ticks so the samples don't lock onto them.
+#ifndef PROFILE_PERIOD_US
+#define PROFILE_PERIOD_US 1003
+#endif
+
+// Threads that can be told apart, the rest are counted as "other".
+#ifndef PROFILE_THREADS
+#define PROFILE_THREADS 12
+#endif
+
+// Longest line from line().
+#define PROFILE_LINE 80
+
+// Interrupts timed with PROFILE_ISR().
+enum profileIsr {
+    profileIsrSampler = 0,
+    profileIsrBlueRx,
+    profileIsrBlueTx,
+    profileIsrAudioDma,
+    profileIsrTones,
+    profileIsrGpsTick,
+    profileIsrGpsRx,
+    PROFILE_ISRS
+};
+
+/** What the profiler knows about one thread. */
+struct ProfileThread {
+    osThreadId  id;
+    //! From attach(), NULL until then.
+    const char *name;
+    //! For the stack high water mark, NULL when not known.
+    Thread     *thread;
+    //! Samples that found it running.
+    uint32_t    samples;
+    //! Samples that found it running when the one before had not.
+    uint32_t    switches;
+};
+
+/** Profiler shows who uses the CPU and how much stack.
+ *
+ * A Ticker interrupt samples which thread was running every
+ * PROFILE_PERIOD_US and counts it against that thread; over a few
+ * seconds the counts are each thread's share of the CPU. A sample that
+ * finds a different thread from the one before is a context switch.
+ * Switches faster than the sampling are not seen, so these are a floor.
+ *
+ * Every mbed Thread paints its stack with a known word when it is
+ * created, Thread::max_stack() finds how much of the paint has gone:
+ * the stack high water mark. Threads say who they are with attach()
+ * when they start, giving their Thread if they have one.
+ *
+ * Interrupt handlers time themselves with PROFILE_ISR() on their first
+ * line, counting DWT cycles to the end of the block (early returns
+ * included). mbed leaves every interrupt at one priority, so handlers
+ * never preempt each other and the times don't overlap.
+ *
+ * All static, like the interrupts it measures there is only one CPU.
+ *
+ * Example:
+ * @code
+ * void readGPS(void) {
+ *     Profiler::attach("gps", &gps_thread);
+ *     ...
+ * }
+ *
+ * void Foo::rx_irq(void) {
+ *     PROFILE_ISR(profileIsrBlueRx);
+ *     ...
+ * }
+ *
+ * char line[PROFILE_LINE];
+ * for (int i = 0; i < Profiler::lines(); i++) {
+ *     Profiler::line(i, line, sizeof(line));
+ *     display.log(DISPLAY_SLOT_NONE, "%s\n\r", line);
+ * }
+ * @endcode
+ */
+class Profiler {
+public:
+
+    //! Start sampling, also enables the DWT cycle counter.
+    static void start(void);
+
+    //! Name the calling thread, and watch its stack if thread is given.
+    static void attach(const char *name, Thread *thread = NULL);
+
+    //! Start the counts over, names and threads are kept.
+    static void reset(void);
+
+    //! Lines in the report, line() formats line i of them.
+    static int lines(void);
+    static void line(int i, char *buf, int len);
+
+    //! Samples so far and the switches they saw.
+    static uint32_t samples(void) { return _samples; }
+    static uint32_t switches(void) { return _switches; }
+
+    //! From PROFILE_ISR(), an interrupt of type isr took cycles.
+    static void isrDone(int isr, uint32_t cycles);
+
+protected:
+
+    static Ticker        _ticker;
+    static ProfileThread _threads[PROFILE_THREADS];
+    static volatile int  _count;
+    static osThreadId    _last;
+
+    static volatile uint32_t _samples;
+    static volatile uint32_t _switches;
+    static volatile uint32_t _other;
+
+    static uint64_t          _isr_cycles[PROFILE_ISRS];
+    static volatile uint32_t _isr_count[PROFILE_ISRS];
+    static volatile uint32_t _isr_max[PROFILE_ISRS];
+
+    static void sample(void);
+    static ProfileThread *find(osThreadId id);
+};
+
+/** Times an interrupt handler from its construction to the end of the block. */
+class ProfileIsr {
+public:
+    ProfileIsr(int isr) : _isr(isr), _start(DWT->CYCCNT) {}
+    ~ProfileIsr() { Profiler::isrDone(_isr, DWT->CYCCNT - _start); }
+protected:
+    int      _isr;
+    uint32_t _start;
+};
+
+#ifndef PROFILE_DISABLE
+#define PROFILE_ISR(isr) ProfileIsr profile_isr_(isr)
+#else
+#define PROFILE_ISR(isr)
+#endif
+
+#endif
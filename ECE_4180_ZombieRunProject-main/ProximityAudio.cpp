@@ -0,0 +1,55 @@
+#include "ProximityAudio.h"
+
+ProximityAudio::ProximityAudio(ToneSequencer &tones) : _tones(tones)
+{
+    _started = false;
+    _changes = 0;
+}
+
+void
+ProximityAudio::start(void)
+{
+    TonePulse quiet = { 0.0f, 0, PROX_SLOW_MS, 0.0f, us_ticker_read() };
+    
+    _gap = PROX_FAR_M;
+    _period_ms = 0;
+    _hz = 0;
+    _changes = 0;
+    _tones.setPulse(&quiet);
+    _tones.startPulse();
+    _started = true;
+}
+
+void
+ProximityAudio::update(float gap_m, uint32_t stamp_us)
+{
+    TonePulse p;
+    float t;
+    int period, hz;
+    
+    if (!_started) return;
+    _gap += (gap_m - _gap) / PROX_SMOOTH;
+    
+    // 0 out of earshot, 1 at arm's length.
+    t = (PROX_FAR_M - _gap) / (PROX_FAR_M - PROX_NEAR_M);
+    if (t <= 0.0f) {
+        period = PROX_SLOW_MS;
+        hz = 0;
+    } else {
+        if (t > 1.0f) t = 1.0f;
+        // Steps of 10ms and 10Hz, finer than that is not heard.
+        period = ((int)(PROX_SLOW_MS - t * (PROX_SLOW_MS - PROX_FAST_MS)) / 10) * 10;
+        hz = ((int)(PROX_LOW_HZ + t * (PROX_HIGH_HZ - PROX_LOW_HZ)) / 10) * 10;
+    }
+    if (period == _period_ms && hz == _hz) return;
+    _period_ms = period;
+    _hz = hz;
+    
+    p.hz = (float)hz;
+    p.on_ms = PROX_BEEP_MS;
+    p.period_ms = period;
+    p.duty = 0.05f;
+    p.stamp_us = stamp_us;
+    _tones.setPulse(&p);
+    _changes++;
+}
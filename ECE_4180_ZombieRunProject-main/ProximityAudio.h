@@ -0,0 +1,82 @@
+#ifndef PROXIMITY_AUDIO_H
+#define PROXIMITY_AUDIO_H
+
+#include "mbed.h"
+#include "ToneSequencer.h"
+
+// Zombies further than this are not heard, m.
+#ifndef PROX_FAR_M
+#define PROX_FAR_M 30.0f
+#endif
+
+// Zombies this close sound as urgent as it gets, m.
+#ifndef PROX_NEAR_M
+#define PROX_NEAR_M 2.0f
+#endif
+
+// Beep length, and the time between beeps far and near, ms.
+#define PROX_BEEP_MS        60
+#define PROX_SLOW_MS        1000
+#define PROX_FAST_MS        150
+
+// Pitch far and near, Hz.
+#define PROX_LOW_HZ         220.0f
+#define PROX_HIGH_HZ        880.0f
+
+// Each reading moves the smoothed gap 1/PROX_SMOOTH of the way.
+#define PROX_SMOOTH         4
+
+/** ProximityAudio beeps faster and higher as the zombies close in.
+ *
+ * Each update() moves a smoothed gap a step towards the closest zombie
+ * and maps it to a beep rate and pitch, a heartbeat at PROX_FAR_M up to
+ * a shriek at PROX_NEAR_M. Settings only go to the tone sequencer when
+ * they change by a step that can be heard, and setPulse() never waits,
+ * so this costs the GPS thread a few multiplies per fix.
+ *
+ * The longest from a reading arriving to the sound starting to change
+ * is the GPS thread waking (it is signalled by the parser) plus
+ * TONE_SLICE_MS; ToneSequencer::maxPulseLatencyUs() measures it from
+ * the stamp given to update(). The smoothing adds its own lag to that:
+ * after n readings 1 - (1 - 1/PROX_SMOOTH)^n of a change in the gap is
+ * heard, with PROX_SMOOTH 4 half after 3 readings and 90% after 8. The
+ * game reads at least at the tracker's 5Hz output, so the sound is 90%
+ * of the way there at most 1.6s plus the above after the gap changes.
+ *
+ * Example:
+ * @code
+ * ProximityAudio proximity(tones);
+ *
+ * proximity.start();
+ * while (running) {
+ *     horde.tick(now_ms, tracker.east(), tracker.north());
+ *     proximity.update(horde.closest(), us_ticker_read());
+ * }
+ * tones.stop();
+ * @endcode
+ */
+class ProximityAudio {
+public:
+
+    ProximityAudio(ToneSequencer &tones);
+    
+    //! Start from silence and hand the speaker to the pulse pattern.
+    void start(void);
+    
+    //! A new gap to the closest zombie, m, from a reading that arrived at stamp_us.
+    void update(float gap_m, uint32_t stamp_us);
+    
+    //! Settings sent to the sequencer since start().
+    uint32_t changes(void) { return _changes; }
+
+protected:
+
+    ToneSequencer &_tones;
+    float    _gap;
+    bool     _started;
+    int      _period_ms;
+    int      _hz;
+    uint32_t _changes;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "Route.h"
+
+// mm per 1e-7 degree of latitude (mean earth radius 6371 km).
+#define MM_PER_E7_LAT 11.1194926f
+#define DEG_TO_RAD    0.01745329252f
+
+Route::Route(float radius)
+{
+    _radius = radius;
+    clear();
+}
+
+void
+Route::clear(void)
+{
+    _count = 0;
+    _next = 0;
+    _tested = 0;
+    _built = false;
+}
+
+bool
+Route::add(int32_t lat_e7, int32_t lon_e7)
+{
+    if (_count >= ROUTE_MAX_POINTS) return false;
+    if (_count == 0) {
+        // The plane is flat around the first checkpoint.
+        _lat0 = lat_e7;
+        _lon0 = lon_e7;
+        _ky = (int32_t)(MM_PER_E7_LAT * 65536.0f);
+        _kx = (int32_t)(MM_PER_E7_LAT * 65536.0f * cosf((float)lat_e7 * 1.0e-7f * DEG_TO_RAD));
+    }
+    to_mm(lat_e7, lon_e7, &_x[_count], &_y[_count]);
+    _count++;
+    _built = false;
+    return true;
+}
+
+bool
+Route::parse_deg_e7(const char *s, int limit, int32_t *out)
+{
+    int32_t whole = 0, frac = 0, scale = 1000000;
+    bool neg = false;
+    
+    while (*s == ' ' || *s == '\t') s++;
+    if (*s == '-') { neg = true; s++; }
+    else if (*s == '+') s++;
+    if (*s < '0' || *s > '9') return false;
+    
+    while (*s >= '0' && *s <= '9') {
+        whole = whole * 10 + (*s++ - '0');
+        if (whole > limit) return false;
+    }
+    if (*s == '.') {
+        for (s++; *s >= '0' && *s <= '9'; s++) {
+            if (scale) { frac += (*s - '0') * scale; scale /= 10; }
+        }
+    }
+    if (whole == limit && frac) return false;
+    whole = whole * 10000000 + frac;
+    *out = neg ? -whole : whole;
+    return true;
+}
+
+int
+Route::load(FILE *fp)
+{
+    char line[64];
+    char *comma;
+    int32_t lat, lon;
+    
+    if (!fp) return -1;
+    clear();
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') continue;
+        comma = strchr(line, ',');
+        if (!comma) continue;
+        if (!parse_deg_e7(line, 90, &lat) || !parse_deg_e7(comma + 1, 180, &lon)) continue;
+        if (!add(lat, lon)) break;
+    }
+    build();
+    return _count;
+}
+
+void
+Route::to_mm(int32_t lat_e7, int32_t lon_e7, int32_t *x, int32_t *y)
+{
+    *x = (int32_t)(((int64_t)(lon_e7 - _lon0) * _kx) >> 16);
+    *y = (int32_t)(((int64_t)(lat_e7 - _lat0) * _ky) >> 16);
+}
+
+// Grid cell along one axis, -1 left of/below the route.
+int
+Route::cell_of(int32_t v, int32_t origin)
+{
+    if (v < origin) return -1;
+    return (v - origin) / _cell;
+}
+
+int
+Route::bucket(int cx, int cy)
+{
+    return (int)(((uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u) & (ROUTE_GRID_CELLS - 1));
+}
+
+void
+Route::build(void)
+{
+    int32_t minx, miny;
+    int i, b, n;
+    
+    _next = 0;
+    _built = false;
+    if (_count == 0) return;
+    
+    _r_mm = (int32_t)(_radius * 1000.0f);
+    minx = miny = 0;
+    for (i = 0; i < _count; i++) {
+        if (_x[i] < minx) minx = _x[i];
+        if (_y[i] < miny) miny = _y[i];
+    }
+    
+    // Cells a diameter across from just beyond the route's lower left,
+    // so a fix's radius touches no more than 2x2 of them.
+    _gx0 = minx - _r_mm;
+    _gy0 = miny - _r_mm;
+    _cell = 2 * _r_mm;
+    
+    // Count the checkpoints per bucket and turn the counts into ends,
+    // then fill each bucket from its end so the ends become starts.
+    memset(_cellStart, 0, sizeof(_cellStart));
+    for (i = 0; i < _count; i++) {
+        _cellStart[bucket(cell_of(_x[i], _gx0), cell_of(_y[i], _gy0))]++;
+    }
+    for (b = 0, n = 0; b < ROUTE_GRID_CELLS; b++) {
+        n += _cellStart[b];
+        _cellStart[b] = n;
+    }
+    _cellStart[ROUTE_GRID_CELLS] = n;
+    for (i = _count - 1; i >= 0; i--) {
+        _cellItem[--_cellStart[bucket(cell_of(_x[i], _gx0), cell_of(_y[i], _gy0))]] = i;
+    }
+    _built = true;
+}
+
+int
+Route::find(int32_t lat_e7, int32_t lon_e7)
+{
+    return search(lat_e7, lon_e7, 0, _count - 1);
+}
+
+int
+Route::search(int32_t lat_e7, int32_t lon_e7, int first, int last)
+{
+    int32_t x, y, dx, dy;
+    int64_t d, best_d;
+    int x0, x1, y0, y1, cx, cy, b[4], n, c, i, k, best = -1;
+    
+    _tested = 0;
+    if (!_built) return -1;
+    
+    // The cells the fix's radius touches, those left of or below the
+    // route have no checkpoints.
+    to_mm(lat_e7, lon_e7, &x, &y);
+    x0 = cell_of(x - _r_mm, _gx0);
+    x1 = cell_of(x + _r_mm, _gx0);
+    y0 = cell_of(y - _r_mm, _gy0);
+    y1 = cell_of(y + _r_mm, _gy0);
+    if (x1 < 0 || y1 < 0) return -1;
+    if (x0 < 0) x0 = x1;
+    if (y0 < 0) y0 = y1;
+    
+    // Nearest, the first of checkpoints at the same spot.
+    n = 0;
+    best_d = (int64_t)_r_mm * _r_mm + 1;
+    for (cy = y0; cy <= y1; cy++) {
+        for (cx = x0; cx <= x1; cx++) {
+            // Two cells can share a bucket, search it once.
+            b[n] = bucket(cx, cy);
+            for (c = 0; c < n && b[c] != b[n]; c++);
+            if (c < n) continue;
+            c = b[n++];
+            for (k = _cellStart[c]; k < _cellStart[c + 1]; k++) {
+                i = _cellItem[k];
+                if (i < first || i > last) continue;
+                dx = x - _x[i];
+                dy = y - _y[i];
+                d = (int64_t)dx * dx + (int64_t)dy * dy;
+                _tested++;
+                if (d < best_d) {
+                    best_d = d;
+                    best = i;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+bool
+Route::update(int32_t lat_e7, int32_t lon_e7)
+{
+    int i;
+    
+    if (!_built || _next >= _count) return false;
+    
+    // Only the next few count, a route can come back past checkpoints
+    // it has already been through or has yet to reach.
+    i = search(lat_e7, lon_e7, _next, _next + ROUTE_SKIP);
+    if (i < 0) return false;
+    _next = i + 1;
+    return true;
+}
@@ -0,0 +1,142 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include "mbed.h"
+#include <stdio.h>
+
+// Most checkpoints a route can hold, 10 bytes each plus the grid.
+#ifndef ROUTE_MAX_POINTS
+#define ROUTE_MAX_POINTS  1024
+#endif
+
+// Buckets the grid cells hash into, 2 bytes each, a power of two about
+// 2x the points.
+#ifndef ROUTE_GRID_CELLS
+#define ROUTE_GRID_CELLS  2048
+#endif
+
+// Checkpoints update() may skip when fixes were lost passing them.
+#ifndef ROUTE_SKIP
+#define ROUTE_SKIP        2
+#endif
+
+// A checkpoint is reached inside this radius.
+#ifndef ROUTE_RADIUS_M
+#define ROUTE_RADIUS_M    15.0f
+#endif
+
+/** Route holds a list of checkpoints and finds which one a fix is at.
+ *
+ * Checkpoints are kept as int32 mm east/north of the first one. The
+ * plane is cut into square cells one checkpoint diameter across and
+ * each cell lists the checkpoints centred in it. A fix's radius touches
+ * no more than 2x2 cells, so it is only tested against the few
+ * checkpoints in those instead of the whole route. Only cells with
+ * checkpoints matter, so the cells are hashed into ROUTE_GRID_CELLS
+ * buckets rather than stored as a grid over the route's bounding box:
+ * the cost per fix stays the same however long or spread out the route
+ * is. At the default sizes a route takes about 14KB.
+ *
+ * update() takes the checkpoints in order, searching the grid for the
+ * next and the ROUTE_SKIP after it only. At one of those the ones
+ * between were passed while fixes were lost, any other is a part of a
+ * route that crosses itself that the player has left or not yet reached.
+ *
+ * Routes are loaded from a text file, one "lat,lon" in decimal degrees
+ * per line, '#' starts a comment.
+ *
+ * Example:
+ * @code
+ * Route route;  // global, it is too big for a thread's stack
+ * FILE *fp = fopen("/sd/route.txt", "r");
+ * route.load(fp);
+ * fclose(fp);
+ *
+ * gps.geodetic(&fix);
+ * if (route.update(fix.lat_e7, fix.lon_e7)) {
+ *     pc.printf("checkpoint %d of %d\r\n", route.reached(), route.size());
+ * }
+ * @endcode
+ */
+class Route {
+public:
+
+    Route(float radius = ROUTE_RADIUS_M);
+    
+    //! Remove all checkpoints.
+    void clear(void);
+    
+    //! Add a checkpoint, false if full. Call build() after the last one.
+    bool add(int32_t lat_e7, int32_t lon_e7);
+    
+    //! Read checkpoints from a file and build(), returns how many or -1.
+    int load(FILE *fp);
+    
+    //! Project the checkpoints and fill the grid.
+    void build(void);
+    
+    //! Index of a checkpoint within the radius of a fix (the nearest), or -1.
+    int find(int32_t lat_e7, int32_t lon_e7);
+    
+    //! Feed a fix, returns true when it reaches the next checkpoint in order.
+    bool update(int32_t lat_e7, int32_t lon_e7);
+    
+    //! Start again from the first checkpoint.
+    void restart(void) { _next = 0; }
+    
+    //! Checkpoints reached in order so far.
+    int reached(void) { return _next; }
+    
+    //! Number of checkpoints.
+    int size(void) { return _count; }
+    
+    //! True once the last checkpoint has been reached.
+    bool finished(void) { return _count && _next >= _count; }
+    
+    //! Checkpoints distance tested by the last find(), for profiling.
+    int tested(void) { return _tested; }
+    
+    //! Parse decimal degrees ("-84.3963012") to 1e-7 degree, integer
+    //! only. False beyond +-limit degrees, 90 for a latitude, 180 for a
+    //! longitude.
+    static bool parse_deg_e7(const char *s, int limit, int32_t *out);
+
+protected:
+
+    float    _radius;
+    int      _count;
+    int      _next;
+    int      _tested;
+    bool     _built;
+    
+    //! The first checkpoint, 1e-7 degrees.
+    int32_t  _lat0;
+    int32_t  _lon0;
+    
+    //! Checkpoints in mm east/north of the first one.
+    int32_t  _x[ROUTE_MAX_POINTS];
+    int32_t  _y[ROUTE_MAX_POINTS];
+    
+    //! mm per 1e-7 degree east and north, Q16.
+    int32_t  _kx;
+    int32_t  _ky;
+    int32_t  _r_mm;
+    
+    //! Grid origin (mm) and cell size (mm).
+    int32_t  _gx0;
+    int32_t  _gy0;
+    int32_t  _cell;
+    
+    //! Checkpoints of bucket b are _cellItem[_cellStart[b] .. _cellStart[b + 1]).
+    uint16_t _cellStart[ROUTE_GRID_CELLS + 1];
+    uint16_t _cellItem[ROUTE_MAX_POINTS];
+    
+    void to_mm(int32_t lat_e7, int32_t lon_e7, int32_t *x, int32_t *y);
+    int cell_of(int32_t v, int32_t origin);
+    int bucket(int cx, int cy);
+    
+    //! find() among checkpoints first to last only.
+    int search(int32_t lat_e7, int32_t lon_e7, int first, int last);
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "SamplePlayer.h"
+#include "Profiler.h"
+
+// DACR value field is bits 15:6, an 8 bit sample goes in the top of it.
+// BIAS limits the DAC to 400kHz updates at a third of the current.
+#define DAC_BIAS        (1UL << 16)
+#define DAC_WORD(s)     (DAC_BIAS | ((uint32_t)(uint8_t)(s) << 8))
+
+#define DACCTRL_DBLBUF  (1UL << 1)
+#define DACCTRL_CNT     (1UL << 2)
+#define DACCTRL_DMA     (1UL << 3)
+
+// Channel control: word to word, source increments, terminal count interrupt.
+#define DMA_CONTROL     (AUDIO_HALF | (2UL << 18) | (2UL << 21) | (1UL << 26) | (1UL << 31))
+// Channel config: enable, DAC is destination peripheral 7, memory to
+// peripheral, error and terminal count interrupts unmasked.
+#define DMA_CONFIG      (1UL | (7UL << 6) | (1UL << 11) | (1UL << 14) | (1UL << 15))
+
+#define PCONP_GPDMA     (1UL << 29)
+
+// One GPDMA linked list item.
+struct AudioLli {
+    uint32_t src;
+    uint32_t dst;
+    uint32_t next;
+    uint32_t control;
+};
+
+// The GPDMA only reaches the AHB SRAM banks.
+static uint32_t audio_buf[2][AUDIO_HALF] __attribute__((section("AHBSRAM0")));
+static AudioLli audio_lli[2] __attribute__((section("AHBSRAM0")));
+
+SamplePlayer *SamplePlayer::_instance = NULL;
+
+SamplePlayer::SamplePlayer(PinName dac) : _dac(dac), _thread(osPriorityNormal, 1024)
+{
+    _fp = NULL;
+    _loop = false;
+    _playing = false;
+    _ready[0] = _ready[1] = false;
+    _playing_half = 0;
+    _ending = 0;
+    _underruns = 0;
+    _over_budget = 0;
+    _max_load = 0;
+    _instance = this;
+}
+
+void
+SamplePlayer::start(void)
+{
+    // Enable the DWT cycle counter used to keep the refills on budget.
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    
+    LPC_SC->PCONP |= PCONP_GPDMA;
+    LPC_GPDMA->DMACConfig = 1;
+    NVIC_SetVector(DMA_IRQn, (uint32_t)&SamplePlayer::dma_irq);
+    NVIC_EnableIRQ(DMA_IRQn);
+    _thread.start(mbed::Callback<void()>(this, &SamplePlayer::run));
+}
+
+static uint32_t
+get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Find the fmt and data chunks, leave the file at the first sample.
+bool
+SamplePlayer::open_wav(const char *path)
+{
+    uint8_t h[16];
+    bool fmt_ok = false;
+    
+    _fp = fopen(path, "rb");
+    if (_fp == NULL) return false;
+    if (fread(h, 1, 12, _fp) != 12 || memcmp(h, "RIFF", 4) || memcmp(&h[8], "WAVE", 4)) return false;
+    
+    while (fread(h, 1, 8, _fp) == 8) {
+        uint32_t len = get_u32(&h[4]);
+        if (!memcmp(h, "fmt ", 4) && len >= 16) {
+            if (fread(h, 1, 16, _fp) != 16) return false;
+            // PCM, one channel, 8 bits.
+            _rate = get_u32(&h[4]);
+            fmt_ok = (h[0] | (h[1] << 8)) == 1 && (h[2] | (h[3] << 8)) == 1 && (h[14] | (h[15] << 8)) == 8 &&
+                     _rate >= AUDIO_MIN_RATE && _rate <= AUDIO_MAX_RATE;
+            len -= 16;
+        } else if (!memcmp(h, "data", 4)) {
+            _data_start = ftell(_fp);
+            _data_len = _data_left = len;
+            return fmt_ok;
+        }
+        // Chunks are padded to an even length.
+        if (fseek(_fp, (len + 1) & ~1UL, SEEK_CUR)) return false;
+    }
+    return false;
+}
+
+// Refill thread, returns the number of samples from the file.
+int
+SamplePlayer::fill(int half)
+{
+    uint32_t start = DWT->CYCCNT;
+    uint8_t raw[AUDIO_HALF];
+    uint32_t *dst = audio_buf[half];
+    int n = 0, got, i;
+    
+    while (_fp != NULL && n < AUDIO_HALF) {
+        if (_data_left == 0) {
+            if (!_loop || fseek(_fp, _data_start, SEEK_SET)) break;
+            _data_left = _data_len;
+        }
+        got = AUDIO_HALF - n;
+        if ((uint32_t)got > _data_left) got = _data_left;
+        got = fread(&raw[n], 1, got, _fp);
+        if (got <= 0) break;
+        n += got;
+        _data_left -= got;
+    }
+    for (i = 0; i < n; i++) dst[i] = DAC_WORD(raw[i]);
+    for (; i < AUDIO_HALF; i++) dst[i] = DAC_WORD(0x80);
+    _ready[half] = true;
+    
+    // The time this took against the time the half plays for.
+    uint32_t cycles = DWT->CYCCNT - start;
+    uint32_t half_cycles = SystemCoreClock / _rate * AUDIO_HALF;
+    uint32_t load = (uint32_t)((uint64_t)cycles * 100 / half_cycles);
+    if (load > _max_load) _max_load = load;
+    if (load > AUDIO_CPU_BUDGET_PCT) _over_budget++;
+    return n;
+}
+
+bool
+SamplePlayer::play(const char *path, bool loop)
+{
+    uint32_t pclk;
+    
+    _lock.lock();
+    halt();
+    _loop = loop;
+    if (!open_wav(path)) {
+        halt();
+        _lock.unlock();
+        return false;
+    }
+    _ending = 0;
+    fill(0);
+    fill(1);
+    
+    for (int i = 0; i < 2; i++) {
+        audio_lli[i].src = (uint32_t)audio_buf[i];
+        audio_lli[i].dst = (uint32_t)&LPC_DAC->DACR;
+        audio_lli[i].next = (uint32_t)&audio_lli[1 - i];
+        audio_lli[i].control = DMA_CONTROL;
+    }
+    LPC_GPDMA->DMACIntTCClear = AUDIO_DMA_BIT;
+    LPC_GPDMA->DMACIntErrClr = AUDIO_DMA_BIT;
+    AUDIO_DMA->DMACCSrcAddr = audio_lli[0].src;
+    AUDIO_DMA->DMACCDestAddr = audio_lli[0].dst;
+    AUDIO_DMA->DMACCLLI = audio_lli[0].next;
+    AUDIO_DMA->DMACCControl = audio_lli[0].control;
+    _playing_half = 0;
+    _playing = true;
+    
+    // The DAC timer runs from PCLK_DAC, PCLKSEL0 bits 23:22 divide CCLK by 4, 1, 2 or 8.
+    static const uint8_t div[4] = { 4, 1, 2, 8 };
+    pclk = SystemCoreClock / div[(LPC_SC->PCLKSEL0 >> 22) & 3];
+    LPC_DAC->DACCNTVAL = pclk / _rate;
+    LPC_DAC->DACCTRL = DACCTRL_DBLBUF | DACCTRL_CNT | DACCTRL_DMA;
+    AUDIO_DMA->DMACCConfig = DMA_CONFIG;
+    _lock.unlock();
+    return true;
+}
+
+void
+SamplePlayer::stop(void)
+{
+    _lock.lock();
+    halt();
+    _lock.unlock();
+}
+
+// With _lock held.
+void
+SamplePlayer::halt(void)
+{
+    AUDIO_DMA->DMACCConfig = 0;
+    LPC_DAC->DACCTRL = 0;
+    _dac = 0.5f;
+    _playing = false;
+    _ready[0] = _ready[1] = false;
+    if (_fp != NULL) {
+        fclose(_fp);
+        _fp = NULL;
+    }
+}
+
+void
+SamplePlayer::run(void)
+{
+    Profiler::attach("audio", &_thread);
+    while (1) {
+        Thread::signal_wait(AUDIO_SIG_REFILL);
+        _lock.lock();
+        for (int half = 0; half < 2 && _playing; half++) {
+            if (_ready[half]) continue;
+            // Two halves of silence after the end, the last real
+            // samples have played.
+            if (fill(half) == 0 && ++_ending >= 2) halt();
+        }
+        _lock.unlock();
+    }
+}
+
+// Once per half buffer.
+void
+SamplePlayer::dma_irq(void)
+{
+    PROFILE_ISR(profileIsrAudioDma);
+    SamplePlayer *p = _instance;
+    
+    LPC_GPDMA->DMACIntErrClr = AUDIO_DMA_BIT;
+    if (!(LPC_GPDMA->DMACIntTCStat & AUDIO_DMA_BIT)) return;
+    LPC_GPDMA->DMACIntTCClear = AUDIO_DMA_BIT;
+    
+    int finished = p->_playing_half;
+    p->_ready[finished] = false;
+    p->_playing_half = 1 - finished;
+    if (!p->_ready[1 - finished]) p->_underruns++;
+    p->_thread.signal_set(AUDIO_SIG_REFILL);
+}
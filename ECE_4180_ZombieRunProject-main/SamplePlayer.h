@@ -0,0 +1,115 @@
+#ifndef SAMPLE_PLAYER_H
+#define SAMPLE_PLAYER_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+// Samples in each half of the DMA buffer. 256 is 16ms at 16kHz.
+#ifndef AUDIO_HALF
+#define AUDIO_HALF 256
+#endif
+
+// Share of the time one half plays for that refilling it may take, %.
+#ifndef AUDIO_CPU_BUDGET_PCT
+#define AUDIO_CPU_BUDGET_PCT 15
+#endif
+
+// Sample rates accepted from a WAV file, Hz.
+#define AUDIO_MIN_RATE 4000
+#define AUDIO_MAX_RATE 22050
+
+// GPDMA channel used, 7 is the lowest priority.
+#define AUDIO_DMA       LPC_GPDMACH7
+#define AUDIO_DMA_BIT   (1UL << 7)
+
+// Signal from the DMA interrupt to the refill thread.
+#define AUDIO_SIG_REFILL 0x1
+
+/** SamplePlayer streams 8 bit PCM from a WAV file to the DAC on p18.
+ *
+ * The DAC's own timer paces the samples and asks the GPDMA for each
+ * one, so playing costs no interrupts per sample. The buffer is two
+ * halves linked to each other in a loop; when the DMA finishes a half
+ * it interrupts once, the half is handed to the refill thread and the
+ * DMA carries on with the other half. The thread reads the next half
+ * from the file and converts it to DAC words.
+ *
+ * If a half has not been refilled by the time the DMA comes back to it
+ * that is an underrun, the old half plays again and underruns() counts
+ * it. Each refill is timed with the cycle counter against the time the
+ * half takes to play; refills over AUDIO_CPU_BUDGET_PCT are counted in
+ * overBudget() and the worst is maxLoadPct().
+ *
+ * The GPDMA can't reach the main SRAM, the buffer and its list live in
+ * AHBSRAM0, so there is only one player.
+ *
+ * Only mono 8 bit PCM WAV files are played, at AUDIO_MIN_RATE to
+ * AUDIO_MAX_RATE.
+ *
+ * Example:
+ * @code
+ * SDFileSystem sd(p5, p6, p7, p12, "sd");
+ * SamplePlayer audio(p18);
+ *
+ * audio.start();
+ * if (!audio.play("/sd/growl.wav")) pc.printf("no growl\r\n");
+ * @endcode
+ */
+class SamplePlayer {
+public:
+
+    SamplePlayer(PinName dac);
+    
+    //! Start the refill thread and hook the DMA interrupt.
+    void start(void);
+    
+    //! Play a WAV file, replacing anything playing. loop repeats it until stop().
+    bool play(const char *path, bool loop = false);
+    
+    //! Stop and close the file.
+    void stop(void);
+    
+    //! True while a file is playing.
+    bool playing(void) { return _playing; }
+    
+    //! Halves that played again because the refill was late.
+    uint32_t underruns(void) { return _underruns; }
+    
+    //! Refills that took longer than the budget.
+    uint32_t overBudget(void) { return _over_budget; }
+    
+    //! Worst refill time as a % of the time a half plays for.
+    uint32_t maxLoadPct(void) { return _max_load; }
+
+protected:
+
+    AnalogOut _dac;
+    Thread    _thread;
+    Mutex     _lock;
+    FILE     *_fp;
+    bool      _loop;
+    long      _data_start;
+    uint32_t  _data_len;
+    uint32_t  _data_left;
+    uint32_t  _rate;
+    int       _ending;
+    
+    // The DMA interrupt and the refill thread.
+    volatile bool     _playing;
+    volatile bool     _ready[2];
+    volatile int      _playing_half;
+    volatile uint32_t _underruns;
+    
+    uint32_t _over_budget;
+    uint32_t _max_load;
+    
+    static SamplePlayer *_instance;
+    
+    bool open_wav(const char *path);
+    int fill(int half);
+    void run(void);
+    void halt(void);
+    static void dma_irq(void);
+};
+
+#endif
@@ -0,0 +1,103 @@
+// Plays a WAV from the SD card through SamplePlayer with the SPI clock
+// the game sets, and checks no half buffer was late and every refill
+// stayed inside AUDIO_CPU_BUDGET_PCT.
+//
+// The case writes its own file first, PLAY_S of a 16kHz 8 bit tone,
+// the rate of the game's growl, and plays it once straight through and
+// then looped for as long again, so the refills cross the end of the
+// file too. A thread below the player's spins the whole time, as the
+// game's threads would keep the core busy. Needs a card in the slot.
+//
+// SD_SCK is the SPI clock for data transfer. Build with
+// -DSD_SCK=1000000, SDFileSystem's default, to see why the game raises
+// it: a sector then takes a quarter of the time a half plays for.
+
+#include "mbed.h"
+#include "rtos.h"
+#include "SDFileSystem.h"
+#include "SamplePlayer.h"
+#include "../../test.h"
+
+#ifndef SD_SCK
+#define SD_SCK      12000000
+#endif
+
+#define RATE        16000
+#define PLAY_S      10
+#define PATH        "/sd/player.wav"
+
+static SDFileSystem sd(p5, p6, p7, p12, "sd");
+static SamplePlayer audio(p18);
+static Thread spin_thread(osPriorityLow, 512);
+static volatile uint32_t spins;
+
+static void
+spin(void)
+{
+    while (1) spins++;
+}
+
+static void
+put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+// A mono 8 bit PCM WAV of a 500Hz triangle.
+static bool
+write_wav(void)
+{
+    static const uint8_t fmt[16] = { 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 8, 0 };
+    uint8_t h[44], buf[512];
+    uint32_t len = RATE * PLAY_S;
+    FILE *fp = fopen(PATH, "wb");
+
+    if (fp == NULL) return false;
+    memcpy(h, "RIFF", 4);
+    put_u32(&h[4], 36 + len);
+    memcpy(&h[8], "WAVEfmt ", 8);
+    put_u32(&h[16], 16);
+    memcpy(&h[20], fmt, 16);
+    put_u32(&h[24], RATE);
+    put_u32(&h[28], RATE);
+    memcpy(&h[36], "data", 4);
+    put_u32(&h[40], len);
+    fwrite(h, 1, 44, fp);
+    for (uint32_t i = 0; i < len; i += sizeof(buf)) {
+        for (uint32_t k = 0; k < sizeof(buf); k++) {
+            uint32_t t = (i + k) % 32;
+            buf[k] = (uint8_t)(t < 16 ? 64 + t * 8 : 64 + (32 - t) * 8);
+        }
+        fwrite(buf, 1, sizeof(buf), fp);
+    }
+    return fclose(fp) == 0;
+}
+
+int
+main(void)
+{
+    // Before the first file opens the card.
+    sd.set_transfer_sck(SD_SCK);
+    CHECK(write_wav(), "can't write " PATH);
+    spin_thread.start(spin);
+    audio.start();
+
+    CHECK(audio.play(PATH), "can't play " PATH);
+    while (audio.playing()) Thread::wait(100);
+    CHECK(audio.play(PATH, true), "can't loop " PATH);
+    Thread::wait(PLAY_S * 1000);
+    audio.stop();
+
+    printf("SD at %u Hz, %d sample halves at %d Hz: %u underruns  %u over budget  %u%% worst refill of %u%%\r\n",
+        SD_SCK, AUDIO_HALF, RATE, audio.underruns(), audio.overBudget(), audio.maxLoadPct(), AUDIO_CPU_BUDGET_PCT);
+    CHECK(audio.underruns() == 0, "%u halves played twice", audio.underruns());
+    CHECK(audio.overBudget() == 0 && audio.maxLoadPct() <= AUDIO_CPU_BUDGET_PCT,
+        "%u refills over budget, worst %u%%", audio.overBudget(), audio.maxLoadPct());
+    CHECK(spins > 0, "the spinning thread never ran");
+    remove(PATH);
+
+    test_done();
+}
@@ -0,0 +1,227 @@
+// Feeds BlueParser fragmented, damaged and noisy byte streams.
+//
+// Bytes go straight to feed(), as the parser thread would pass them on
+// from the ring, in pieces of 1 to 7 bytes. Every case checks that a
+// damaged packet is never delivered and costs no more than itself: the
+// packet after it always arrives.
+
+#include "mbed.h"
+#include "BlueParser.h"
+#include "../../test.h"
+
+#define PACKETS     200
+#define NOISE       40
+#define ROUNDS      2000
+
+// The port is never started, the test is the only one feeding it.
+static RawSerial serial(p13, p14);
+static BlueParser parser(serial);
+
+// What feed() collected: how many, the first few and the last.
+static BlueEvent got[BLUE_EVENTS];
+static BlueEvent last;
+static int ngot;
+
+// Appends "!", type, payload and checksum to out, returns the length.
+static int
+packet(char *out, char type, const char *payload, int n)
+{
+    char sum = '!' + type;
+
+    out[0] = '!';
+    out[1] = type;
+    for (int i = 0; i < n; i++) {
+        out[2 + i] = payload[i];
+        sum += payload[i];
+    }
+    out[2 + n] = ~sum;
+    return n + 3;
+}
+
+static int
+button(char *out, char b, bool pressed)
+{
+    char p[2] = { b, pressed ? '1' : '0' };
+
+    return packet(out, 'B', p, 2);
+}
+
+static int
+location(char *out, float lat, float lon, float alt)
+{
+    union f_or_char x;
+    float v[3] = { lat, lon, alt };
+    char p[12];
+
+    for (int i = 0; i < 3; i++) {
+        x.f = v[i];
+        for (int j = 0; j < 4; j++) p[i * 4 + j] = x.c[j];
+    }
+    return packet(out, 'L', p, 12);
+}
+
+// Feed n bytes in random pieces, collecting what comes out after each.
+static void
+feed(const char *s, int n)
+{
+    BlueEvent evt;
+    int i = 0, piece;
+
+    while (i < n) {
+        piece = 1 + lcg() % 7;
+        for (; piece > 0 && i < n; piece--) parser.feed(s[i++]);
+        while (parser.get(&evt, 0)) {
+            if (ngot < BLUE_EVENTS) got[ngot] = evt;
+            last = evt;
+            ngot++;
+        }
+    }
+}
+
+// The packets of the fragmented stream.
+static int
+script(char *out, int i)
+{
+    char rgb[3] = { (char)i, (char)(i * 3), (char)(i * 7) };
+
+    switch (i % 3) {
+        case 0:  return button(out, '1' + i % 8, i & 1);
+        case 1:  return packet(out, 'C', rgb, 3);
+        default: return location(out, 33.7756f + i * 1e-4f, -84.3963f, 290.0f + i);
+    }
+}
+
+static void
+fragmented(void)
+{
+    char buf[BLUE_MAX_PACKET];
+    int i, n, bad = 0;
+
+    for (i = 0; i < PACKETS; i++) {
+        ngot = 0;
+        n = script(buf, i);
+        // Half of each packet alone, so the parser stops mid-packet.
+        feed(buf, n / 2);
+        feed(buf + n / 2, n - n / 2);
+        if (ngot != 1) {
+            bad++;
+            continue;
+        }
+        switch (i % 3) {
+            case 0:
+                if (got[0].type != 'B' || got[0].button != '1' + i % 8 || got[0].pressed != (i & 1)) bad++;
+                break;
+            case 1:
+                if (got[0].type != 'C' || got[0].rgb[0] != (uint8_t)i || got[0].rgb[2] != (uint8_t)(i * 7)) bad++;
+                break;
+            default:
+                if (got[0].type != 'L' || got[0].v[0] != 33.7756f + i * 1e-4f || got[0].v[2] != 290.0f + i) bad++;
+                break;
+        }
+    }
+    printf("fragmented: %d of %d wrong\r\n", bad, PACKETS);
+    CHECK(bad == 0, "%d fragmented packets wrong", bad);
+}
+
+// Each byte of a location lost in turn, or each bit of it flipped.
+static void
+damaged(void)
+{
+    char good[BLUE_MAX_PACKET], buf[2 * BLUE_MAX_PACKET];
+    int len, n, i, k, bit, lost = 0, wrong = 0;
+    uint32_t errors = parser.errors();
+
+    len = location(good, 33.7756f, -84.3963f, 290.0f);
+    for (k = 0; k < len; k++) {
+        for (bit = -1; bit < 8; bit++) {
+            memcpy(buf, good, len);
+            if (bit < 0) {
+                memmove(buf + k, buf + k + 1, len - k - 1);
+                n = len - 1;
+            } else {
+                buf[k] ^= 1 << bit;
+                n = len;
+            }
+            n += button(buf + n, '7', true);
+            ngot = 0;
+            feed(buf, n);
+            if (ngot == 0 || last.type != 'B') lost++;
+            for (i = 0; i < ngot && i < BLUE_EVENTS; i++) {
+                if (got[i].type != 'B') wrong++;
+            }
+        }
+    }
+    printf("damaged: %d lost  %d delivered  %u checksum errors\r\n",
+        lost, wrong, parser.errors() - errors);
+    CHECK(lost == 0, "%d packets after a damaged one lost", lost);
+    CHECK(wrong == 0, "%d damaged packets delivered", wrong);
+    CHECK(parser.errors() > errors, "no checksum errors counted");
+}
+
+// Random bytes, a '!' about one in six, then a good location with the
+// round in its altitude. A packet started in the noise can hold it back
+// until the bytes after it show that one to be bad, so it may come out
+// a round late but must come out, and in order.
+static void
+noise(void)
+{
+    char buf[NOISE + BLUE_MAX_PACKET];
+    int i, r, n, next = 0, late = 0;
+
+    for (r = 0; r <= ROUNDS; r++) {
+        for (i = 0; i < NOISE; i++) {
+            buf[i] = lcg() % 6 ? (char)lcg() : '!';
+        }
+        n = NOISE;
+        if (r < ROUNDS) n += location(buf + NOISE, 33.7756f, -84.3963f, (float)r);
+        ngot = 0;
+        feed(buf, n);
+        for (i = 0; i < ngot && i < BLUE_EVENTS; i++) {
+            // Noise can make a packet of its own, that's not one of these.
+            if (got[i].type != 'L' || got[i].v[2] != (float)next) continue;
+            if (next < r) late++;
+            next++;
+        }
+    }
+    printf("noise: %d of %d delivered, %d a round late\r\n", next, ROUNDS, late);
+    CHECK(next == ROUNDS, "%d of %d packets after noise delivered in order", next, ROUNDS);
+}
+
+// Good checksums around nonsense, and a queue nobody reads.
+static void
+rejected(void)
+{
+    char buf[BLUE_MAX_PACKET];
+    uint32_t invalid = parser.invalid(), dropped = parser.dropped();
+    int i, n;
+
+    ngot = 0;
+    n = button(buf, '9', true);
+    feed(buf, n);
+    n = location(buf, 100.0f, 0.0f, 0.0f);
+    feed(buf, n);
+    CHECK(ngot == 0 && parser.invalid() - invalid == 2, "%d nonsense delivered, %u invalid",
+        ngot, parser.invalid() - invalid);
+
+    n = button(buf, '2', true);
+    for (i = 0; i < BLUE_EVENTS + 2; i++) {
+        for (int k = 0; k < n; k++) parser.feed(buf[k]);
+    }
+    CHECK(parser.dropped() - dropped == 2, "%u dropped from a full queue", parser.dropped() - dropped);
+    ngot = 0;
+    while (parser.get(&last, 0)) ngot++;
+    CHECK(ngot == BLUE_EVENTS, "%d queued", ngot);
+}
+
+int
+main(void)
+{
+    fragmented();
+    damaged();
+    noise();
+    rejected();
+
+    printf("packets %u  errors %u  invalid %u  dropped %u\r\n",
+        parser.packets(), parser.errors(), parser.invalid(), parser.dropped());
+    test_done();
+}
@@ -0,0 +1,47 @@
+// Checks that CourseEngine::best() doesn't ratchet up on GPS jitter.
+//
+// The player stands at the start for 60 s, then runs north along the
+// course at 3 m/s for 60 s, then stands again. Every 10 Hz fix is up to
+// 1.2 m out in each direction at HDOP 1.0, so any two fixes of the same
+// spot, the start included, are within the 2.5 m noise radius.
+
+#include "mbed.h"
+#include "CourseEngine.h"
+#include "../../test.h"
+
+#define START_LAT   337756000
+#define START_LON   -843963000
+#define E7_PER_M    90          // 1e-7 degrees of latitude per metre
+#define NOISE_E7    108         // 1.2 m
+
+int
+main(void)
+{
+    CourseEngine course;
+    float truth = 0.0f, worst_ahead = 0.0f, worst_behind = 0.0f;
+    
+    course.reset(0.0f);
+    for (int i = 0; i < 1800; i++) {
+        // 60 s still, 60 s at 3 m/s, 60 s still.
+        if (i >= 600 && i < 1200) truth += 0.3f;
+        course.update(START_LAT + (int32_t)(truth * E7_PER_M) + noise(NOISE_E7),
+            START_LON + noise(NOISE_E7), 10, 1);
+        
+        if (i == 599) {
+            printf("standing: best %.2f m\r\n", course.best());
+            CHECK(course.best() == 0.0f, "best %.2f m standing at the start", course.best());
+        }
+        if (course.best() - truth > worst_ahead) worst_ahead = course.best() - truth;
+        if (i >= 600 && truth - course.best() > worst_behind) worst_behind = truth - course.best();
+    }
+    printf("ran %.1f m  best %.2f m  ahead %.2f m  behind %.2f m\r\n",
+        truth, course.best(), worst_ahead, worst_behind);
+    
+    // Only ever ahead by the jitter of the fix that raised it and the
+    // start's, behind by no more than the noise radius and that jitter.
+    CHECK(worst_ahead <= 2.4f + 0.05f, "best got %.2f m ahead", worst_ahead);
+    CHECK(worst_behind <= 2.5f + 2.4f + 0.3f + 0.05f, "best fell %.2f m behind", worst_behind);
+    CHECK(truth - course.best() <= 2.5f + 2.4f, "finished %.2f m short", truth - course.best());
+    
+    test_done();
+}
@@ -0,0 +1,81 @@
+// GPS_Bench's corpus through the GGA, RMC and VTG parsers, in wall
+// clock ns per sentence as well as GPS_Bench's DWT cycles.
+//
+// The cycle counter only exists on the target, on the host it reads 0,
+// so ns are timed here over whole passes of the corpus. Each sentence is
+// copied to a work buffer first, as GPS_Bench does, and the copies are
+// timed on their own and taken off. Before the timing the well formed
+// sentences have to parse to what they say; after it, every parser has
+// had every sentence, malformed ones too, REPEATS times without harm.
+
+#include "mbed.h"
+#include "GPS.h"
+#include "GPS_Bench.h"
+#include "../../test.h"
+
+#define REPEATS     2000
+
+// ns for REPEATS passes of the corpus through fn, or just the copies.
+static uint64_t
+pass(GPS_BenchFn fn)
+{
+    char work[GPS_BUFFER_LEN];
+    uint64_t start = test_ns();
+
+    for (int j = 0; j < REPEATS; j++) {
+        for (int i = 0; i < GPS_Bench::corpusLen; i++) {
+            strncpy(work, GPS_Bench::corpus[i], GPS_BUFFER_LEN - 1);
+            work[GPS_BUFFER_LEN - 1] = '\0';
+            if (fn) fn(work);
+            else __asm__ volatile("" : : "r"(work) : "memory");
+        }
+    }
+    return test_ns() - start;
+}
+
+static void
+parses(void)
+{
+    char work[GPS_BUFFER_LEN];
+    GPS_Geodetic place;
+    GPS_Time t;
+    GPS_VTG v;
+
+    strcpy(work, GPS_Bench::corpus[6]);
+    place.nmea_gga(work);
+    CHECK(place.lat_e7 == -337109789 && place.lon_e7 == 1511520576 && place.num_of_gps_sats == 11,
+        "southern GGA gave %ld %ld, %d satellites", (long)place.lat_e7, (long)place.lon_e7, place.num_of_gps_sats);
+    // Two digit years are taken as 20xx, the 1994 of the example too.
+    strcpy(work, GPS_Bench::corpus[4]);
+    t.nmea_rmc(work);
+    CHECK(t.hour == 12 && t.minute == 35 && t.second == 19 && t.year == 2094 && fabs(t.velocity - 22.4) < 1e-6,
+        "RMC gave %02d:%02d:%02d %d, %.1f knots", t.hour, t.minute, t.second, t.year, t.velocity);
+    strcpy(work, GPS_Bench::corpus[5]);
+    v.nmea_vtg(work);
+    CHECK(fabs(v._track_true - 54.7) < 1e-6 && fabs(v._velocity_kph - 10.2) < 1e-6,
+        "VTG gave %.1f deg %.1f km/h", v._track_true, v._velocity_kph);
+}
+
+int
+main(void)
+{
+    static const char *names[3] = { "GGA", "RMC", "VTG" };
+    static const GPS_BenchFn fns[3] = { GPS_Bench::gga, GPS_Bench::rmc, GPS_Bench::vtg };
+    GPS_BenchResult r;
+    uint64_t copy, ns;
+
+    parses();
+    printf("%d sentences, %d passes\r\n", GPS_Bench::corpusLen, REPEATS);
+    copy = pass(NULL);
+    for (int p = 0; p < 3; p++) {
+        GPS_Bench::run(&r, names[p], fns[p], GPS_Bench::corpus, GPS_Bench::corpusLen, 100);
+        ns = pass(fns[p]);
+        ns = ns > copy ? ns - copy : 0;
+        printf("%s %6u ns/sentence  %5u cycles mean %5u max\r\n", names[p],
+            (uint32_t)(ns / ((uint64_t)REPEATS * GPS_Bench::corpusLen)), r.meanCycles(), r.maxCycles);
+        CHECK(r.sentences == (uint32_t)GPS_Bench::corpusLen * 100, "%s ran %u sentences", names[p], r.sentences);
+        CHECK(ns > 0, "%s took no time", names[p]);
+    }
+
+    test_done();
+}
@@ -0,0 +1,376 @@
+// Drives GPS_Config against a mock receiver, host only.
+//
+// Every byte the driver sends goes to the mock through host_on_tx. The
+// mock decodes the PMTK sentences and UBX frames, keeps the receiver's
+// settings and queues its answer, which starts to arrive REPLY_MS later
+// through rx_byte() and poll() from host_on_wait, a message per wait, as
+// the UART interrupt and the 10ms ticktock() would deliver it while the
+// driver waits. A silent receiver hears nothing either: it is on another
+// baud rate or not there.
+//
+// Each command is tried with a receiver that acknowledges, one that
+// refuses (PMTK001 flag 2, UBX ACK-NAK), one that says nothing, and one
+// that first answers an earlier command: a late reply must not be
+// taken for this one's.
+
+#include "mbed.h"
+#include "GPS.h"
+#include "../../test.h"
+
+#define REPLY_MS    30
+#define MOCK_BYTES  1024
+#define MOCK_MSGS   16
+
+enum MockMode {
+    mockAnswer = 0,
+    mockRefuse,
+    mockSilent,
+    mockStale
+};
+
+static GPS gps(p9, p10);
+
+static int mode;
+
+// The receiver's settings.
+static int period_ms;
+static int baudrate;
+static int pmtk_fields[19];
+static uint8_t ubx_rate[2][256];    // [0] NMEA class ids, [1] NAV ids
+
+// What the driver sent.
+static GPS_UBX from_driver;
+static char line[GPS_BUFFER_LEN];
+static int line_len;
+static int commands;
+static int bad_commands;
+
+// What the mock will answer, and where each message of it ends.
+static uint8_t reply[MOCK_BYTES];
+static int reply_end[MOCK_MSGS];
+static int reply_len, reply_pos, reply_msgs, reply_next;
+static uint32_t reply_due;
+
+static void
+queue(const uint8_t *b, int len)
+{
+    if (reply_len + len > MOCK_BYTES || reply_msgs == MOCK_MSGS) return;
+    memcpy(reply + reply_len, b, len);
+    reply_len += len;
+    reply_end[reply_msgs++] = reply_len;
+    reply_due = host_us + REPLY_MS * 1000;
+}
+
+static void
+queue_nmea(const char *body)
+{
+    char buf[GPS_BUFFER_LEN];
+    uint8_t cs = 0;
+
+    for (int i = 0; body[i]; i++) cs ^= (uint8_t)body[i];
+    queue((const uint8_t *)buf, snprintf(buf, sizeof(buf), "$%s*%02X\r\n", body, cs));
+}
+
+static void
+queue_ubx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+    uint8_t buf[GPS_UBX_PAYLOAD_LEN + GPS_UBX_OVERHEAD];
+
+    queue(buf, GPS_UBX::build(buf, cls, id, payload, len));
+}
+
+static void
+pmtk_ack(int cmd, int flag)
+{
+    char body[24];
+
+    if (mode == mockStale) {
+        snprintf(body, sizeof(body), "PMTK001,%d,3", cmd == 220 ? 314 : 220);
+        queue_nmea(body);
+    }
+    snprintf(body, sizeof(body), "PMTK001,%d,%d", cmd, mode == mockRefuse ? 2 : flag);
+    queue_nmea(body);
+}
+
+static void
+ubx_ack(uint8_t cls, uint8_t id)
+{
+    uint8_t p[2] = { cls, id };
+
+    if (mode == mockStale) {
+        uint8_t q[2] = { UBX_CLASS_CFG, UBX_CFG_PRT };
+        queue_ubx(UBX_CLASS_ACK, UBX_ACK_ACK, q, 2);
+    }
+    queue_ubx(UBX_CLASS_ACK, mode == mockRefuse ? UBX_ACK_NAK : UBX_ACK_ACK, p, 2);
+}
+
+// A whole sentence from the driver, '$' to '\n'.
+static void
+nmea_command(char *s)
+{
+    char body[80];
+    char *star = strchr(s, '*');
+    uint8_t cs = 0;
+    int n;
+
+    commands++;
+    if (mode == mockSilent) return;
+    for (char *p = s + 1; p < star; p++) cs ^= (uint8_t)*p;
+    if (s[0] != '$' || star == NULL || strtol(star + 1, NULL, 16) != cs) {
+        bad_commands++;
+        return;
+    }
+
+    if (!strncmp(s, "$PMTK220,", 9)) {
+        if (mode != mockRefuse) period_ms = atoi(s + 9);
+        pmtk_ack(220, 3);
+    }
+    else if (!strncmp(s, "$PMTK314,", 9)) {
+        char *f = s + 8;
+        for (int i = 0; i < 19 && f && *f == ','; i++) {
+            if (mode != mockRefuse) pmtk_fields[i] = atoi(f + 1);
+            f = strchr(f + 1, ',');
+        }
+        pmtk_ack(314, 3);
+    }
+    else if (!strncmp(s, "$PMTK251,", 9)) {
+        baudrate = atoi(s + 9);
+    }
+    else if (!strncmp(s, "$PMTK400*", 9)) {
+        if (mode == mockStale) queue_nmea("PMTK514,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0");
+        snprintf(body, sizeof(body), "PMTK500,%d,0,0,0,0", period_ms);
+        queue_nmea(body);
+    }
+    else if (!strncmp(s, "$PMTK414*", 9)) {
+        if (mode == mockStale) queue_nmea("PMTK500,1000,0,0,0,0");
+        n = snprintf(body, sizeof(body), "PMTK514");
+        for (int i = 0; i < 19; i++) n += snprintf(body + n, sizeof(body) - n, ",%d", pmtk_fields[i]);
+        queue_nmea(body);
+    }
+}
+
+// A whole UBX frame from the driver.
+static void
+ubx_command(GPS_UBX_Msg *m)
+{
+    uint8_t p[8];
+
+    commands++;
+    if (mode == mockSilent || m->cls != UBX_CLASS_CFG) return;
+
+    if (m->id == UBX_CFG_RATE && m->len == 0) {
+        if (mode == mockStale) {
+            uint8_t q[8] = { UBX_CLASS_NMEA, 0x00, 0, 1, 0, 0, 0, 0 };
+            queue_ubx(UBX_CLASS_CFG, UBX_CFG_MSG, q, 8);
+        }
+        GPS_UBX::put16(&p[0], period_ms);
+        GPS_UBX::put16(&p[2], 1);
+        GPS_UBX::put16(&p[4], 1);
+        queue_ubx(UBX_CLASS_CFG, UBX_CFG_RATE, p, 6);
+    }
+    else if (m->id == UBX_CFG_RATE && m->len == 6) {
+        if (mode != mockRefuse) period_ms = GPS_UBX::u16(&m->payload[0]);
+        ubx_ack(m->cls, m->id);
+    }
+    else if (m->id == UBX_CFG_MSG && m->len == 2) {
+        // Rates per port, UART1 is port 1.
+        int table = m->payload[0] == UBX_CLASS_NAV ? 1 : 0;
+        if (mode == mockStale) {
+            uint8_t q[8] = { m->payload[0], (uint8_t)(m->payload[1] + 1), 0, 1, 0, 0, 0, 0 };
+            queue_ubx(UBX_CLASS_CFG, UBX_CFG_MSG, q, 8);
+        }
+        memset(p, 0, sizeof(p));
+        p[0] = m->payload[0];
+        p[1] = m->payload[1];
+        p[3] = ubx_rate[table][m->payload[1]];
+        queue_ubx(UBX_CLASS_CFG, UBX_CFG_MSG, p, 8);
+    }
+    else if (m->id == UBX_CFG_MSG && m->len == 3) {
+        int table = m->payload[0] == UBX_CLASS_NAV ? 1 : 0;
+        if (mode != mockRefuse) ubx_rate[table][m->payload[1]] = m->payload[2];
+        ubx_ack(m->cls, m->id);
+    }
+    else if (m->id == UBX_CFG_PRT && m->len == 20) {
+        // Acknowledged at the new baud rate, which the driver doesn't wait for.
+        baudrate = (int)GPS_UBX::u32(&m->payload[8]);
+    }
+}
+
+// host_on_tx: a byte from the driver.
+static void
+from_gps(int c)
+{
+    switch (from_driver.feed((uint8_t)c)) {
+        case GPS_UBX::ubxFrame: ubx_command(&from_driver.msg); return;
+        case GPS_UBX::ubxMore:  return;
+        default: break;
+    }
+    if (c == '$') line_len = 0;
+    if (line_len < GPS_BUFFER_LEN - 1) line[line_len++] = (char)c;
+    if (c == '\n') {
+        line[line_len] = '\0';
+        nmea_command(line);
+        line_len = 0;
+    }
+}
+
+// host_on_wait: the next message of the answer, once it's due.
+static void
+to_gps(void)
+{
+    if (reply_next == reply_msgs || (int32_t)(host_us - reply_due) < 0) return;
+    while (reply_pos < reply_end[reply_next]) {
+        char c = (char)reply[reply_pos++];
+        gps.rx_byte(c, host_us);
+        if (c == '\n') gps.poll();
+    }
+    if (++reply_next == reply_msgs) reply_pos = reply_len = reply_msgs = reply_next = 0;
+}
+
+// Start a command with the receiver in mode m, returns the time.
+static uint32_t
+begin(int m)
+{
+    mode = m;
+    reply_pos = reply_len = reply_msgs = reply_next = 0;
+    baudrate = 0;
+    return host_us;
+}
+
+static const char *const mode_names[] = { "answer", "refuse", "silent", "stale" };
+
+// How long a command took against what it should have.
+static void
+took(const char *what, uint32_t start)
+{
+    uint32_t ms = (host_us - start) / 1000;
+
+    if (mode == mockSilent) {
+        CHECK(ms >= GPS_CFG_TIMEOUT && ms < GPS_CFG_TIMEOUT + 50, "%s %s: gave up after %u ms",
+            what, mode_names[mode], ms);
+    }
+    else {
+        CHECK(ms < GPS_CFG_TIMEOUT, "%s %s: took %u ms", what, mode_names[mode], ms);
+    }
+}
+
+static void
+pmtk(void)
+{
+    const int mask = GPS_MSG_GGA | GPS_MSG_VTG | GPS_MSG_RMC;
+    uint32_t t;
+    bool ok;
+    int got;
+
+    gps.setConfigProtocol(GPS::cfgPMTK);
+    for (int m = mockAnswer; m <= mockStale; m++) {
+        bool good = m == mockAnswer || m == mockStale;
+
+        period_ms = 1000;
+        memset(pmtk_fields, 0, sizeof(pmtk_fields));
+        pmtk_fields[0] = 1;
+
+        t = begin(m);
+        ok = gps.setUpdateRate(10);
+        took("PMTK220", t);
+        CHECK(ok == good, "PMTK220 %s: returned %d", mode_names[m], ok);
+        CHECK(period_ms == (good ? 100 : 1000), "PMTK220 %s: receiver at %d ms", mode_names[m], period_ms);
+
+        t = begin(m);
+        got = gps.readUpdatePeriod();
+        took("PMTK400", t);
+        CHECK(got == (m == mockSilent ? 0 : period_ms), "PMTK400 %s: read %d ms", mode_names[m], got);
+
+        t = begin(m);
+        ok = gps.setSentences(mask);
+        took("PMTK314", t);
+        CHECK(ok == good, "PMTK314 %s: returned %d", mode_names[m], ok);
+        if (good) {
+            // GLL off, RMC VTG GGA on, GSA GSV ZDA off.
+            CHECK(!pmtk_fields[0] && pmtk_fields[1] && pmtk_fields[2] && pmtk_fields[3] && !pmtk_fields[4]
+                && !pmtk_fields[5] && !pmtk_fields[17], "PMTK314 %s: wrong fields", mode_names[m]);
+        }
+
+        t = begin(m);
+        got = gps.readSentences();
+        took("PMTK414", t);
+        CHECK(got == (m == mockSilent ? -1 : good ? mask : GPS_MSG_GLL), "PMTK414 %s: read %x",
+            mode_names[m], got);
+
+        t = begin(m);
+        ok = gps.setReceiverBaud(38400);
+        CHECK(baudrate == (m == mockSilent ? 0 : 38400), "PMTK251 %s: receiver at %d baud", mode_names[m], baudrate);
+        CHECK(ok == (m != mockSilent), "PMTK251 %s: returned %d", mode_names[m], ok);
+    }
+}
+
+static void
+ubx(void)
+{
+    const int mask = GPS_MSG_GGA | GPS_MSG_VTG;
+    uint32_t t;
+    bool ok;
+    int got;
+
+    gps.setConfigProtocol(GPS::cfgUBX);
+    for (int m = mockAnswer; m <= mockStale; m++) {
+        bool good = m == mockAnswer || m == mockStale;
+
+        period_ms = 1000;
+        memset(ubx_rate, 0, sizeof(ubx_rate));
+        ubx_rate[0][0x04] = 1;     // RMC
+
+        t = begin(m);
+        ok = gps.setUpdateRate(5);
+        took("CFG-RATE", t);
+        CHECK(ok == good, "CFG-RATE %s: returned %d", mode_names[m], ok);
+        CHECK(period_ms == (good ? 200 : 1000), "CFG-RATE %s: receiver at %d ms", mode_names[m], period_ms);
+
+        t = begin(m);
+        got = gps.readUpdatePeriod();
+        took("CFG-RATE poll", t);
+        CHECK(got == (m == mockSilent ? 0 : period_ms), "CFG-RATE poll %s: read %d ms", mode_names[m], got);
+
+        // Refused at the first message, waits out one timeout silent.
+        t = begin(m);
+        ok = gps.setSentences(mask);
+        took("CFG-MSG", t);
+        CHECK(ok == good, "CFG-MSG %s: returned %d", mode_names[m], ok);
+        if (good) {
+            CHECK(ubx_rate[0][0x00] == 1 && ubx_rate[0][0x05] == 1 && ubx_rate[0][0x04] == 0
+                && ubx_rate[0][0x03] == 0, "CFG-MSG %s: wrong rates", mode_names[m]);
+        }
+
+        t = begin(m);
+        got = gps.readSentences();
+        took("CFG-MSG poll", t);
+        CHECK(got == (m == mockSilent ? -1 : good ? mask : GPS_MSG_RMC), "CFG-MSG poll %s: read %x",
+            mode_names[m], got);
+
+        t = begin(m);
+        ok = gps.setUbxPvt(true);
+        took("NAV-PVT", t);
+        CHECK(ok == good, "NAV-PVT %s: returned %d", mode_names[m], ok);
+        CHECK(ubx_rate[1][UBX_NAV_PVT] == (good ? 1 : 0) && ubx_rate[1][UBX_NAV_DOP] == (good ? 1 : 0),
+            "NAV-PVT %s: rates %d, NAV-DOP %d", mode_names[m], ubx_rate[1][UBX_NAV_PVT], ubx_rate[1][UBX_NAV_DOP]);
+
+        t = begin(m);
+        ok = gps.setReceiverBaud(115200);
+        CHECK(baudrate == (m == mockSilent ? 0 : 115200), "CFG-PRT %s: receiver at %d baud", mode_names[m], baudrate);
+        CHECK(ok == (m != mockSilent), "CFG-PRT %s: returned %d", mode_names[m], ok);
+    }
+}
+
+int
+main(void)
+{
+    host_on_tx = from_gps;
+    host_on_wait = to_gps;
+
+    pmtk();
+    ubx();
+
+    printf("%d commands sent, %d malformed, %u ms simulated\r\n", commands, bad_commands, host_us / 1000);
+    CHECK(bad_commands == 0, "%d malformed commands", bad_commands);
+    test_done();
+}
@@ -0,0 +1,156 @@
+// Checks GPS_Geodetic::parse_coord_e7() against a double reference and
+// times it against the double conversion it replaced.
+//
+// Random latitudes and longitudes are written as NMEA ddmm.mmmm fields
+// with 0 to 9 minute decimals. The result must be within 1e-7 degree of
+// the reference, the seventh decimal's rounding. Malformed fields must
+// be refused, and a GGA with one must not pass off the last position as
+// a new fix. Cycles are counted with the DWT cycle counter
+// on the target, wall clock ns on both.
+
+#include "mbed.h"
+#include "GPS_Geodetic.h"
+#include "../../test.h"
+
+#define FIELDS      20000
+#define BENCH       1000
+
+// A random field of up to max_deg degrees, its value in degrees to the
+// double's precision.
+static double
+field(char *buf, int max_deg, int deg_digits)
+{
+    int deg = lcg() % (max_deg + 1);
+    int min = deg == max_deg ? 0 : lcg() % 60;
+    int decimals = lcg() % 10;
+    double frac = 0.0, scale = 0.1;
+    char *p;
+
+    p = buf + sprintf(buf, "%0*d%02d", deg_digits, deg, min);
+    if (decimals) *p++ = '.';
+    for (int i = 0; i < decimals; i++) {
+        int d = lcg() % 10;
+        *p++ = '0' + d;
+        frac += d * scale;
+        scale /= 10.0;
+    }
+    *p = '\0';
+    return deg + (min + frac) / 60.0;
+}
+
+// How the driver converted before, on the M3's soft float.
+static int32_t
+convert_double(const char *s, bool negative)
+{
+    double v = atof(s);
+    int deg = (int)(v / 100.0);
+    double d = deg + (v - deg * 100.0) / 60.0;
+
+    return (int32_t)((negative ? -d : d) * 1.0e7 + (negative ? -0.5 : 0.5));
+}
+
+static void
+fuzz(void)
+{
+    char buf[24];
+    double ref, err, worst = 0.0;
+    int32_t v;
+    int i, off = 0, refused = 0;
+
+    for (i = 0; i < FIELDS; i++) {
+        bool lat = i & 1, negative = (i & 2) != 0;
+        ref = lat ? field(buf, 90, 2) : field(buf, 180, 3);
+        if (!GPS_Geodetic::parse_coord_e7(buf, negative, &v)) {
+            refused++;
+            continue;
+        }
+        err = (double)v - (negative ? -ref : ref) * 1.0e7;
+        if (err < 0) err = -err;
+        if (err > worst) worst = err;
+        if (err > 1.0) {
+            if (off++ < 5) printf("%s -> %ld, reference %.3f\r\n", buf, (long)v, ref * 1.0e7);
+        }
+    }
+    printf("fuzz: %d fields  worst %.3f e-7 deg  %d off  %d refused\r\n", FIELDS, worst, off, refused);
+    CHECK(off == 0, "%d fields more than 1e-7 deg out", off);
+    CHECK(refused == 0, "%d good fields refused", refused);
+}
+
+static void
+malformed(void)
+{
+    static const char *bad[] = {
+        "", ".5", "12", "12a4.5", "123456.0", "4860.0", "18100.0", "-4807.0", "N",
+    };
+    int32_t v;
+
+    for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        CHECK(!GPS_Geodetic::parse_coord_e7(bad[i], false, &v), "\"%s\" parsed as %ld", bad[i], (long)v);
+    }
+}
+
+static void
+gga(void)
+{
+    GPS_Geodetic fix;
+    char good[] = "GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,";
+    char bad_lat[] = "GPGGA,123520.00,48x7.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,";
+    char bad_lon[] = "GPGGA,123521.00,4807.038,N,18030.000,E,1,08,0.9,545.4,M,46.9,M,,";
+
+    fix.nmea_gga(good);
+    CHECK(fix.gps_satellite_quality == 1 && fix.lat_e7 == 481173000 && fix.lon_e7 == 115166667,
+        "good GGA: quality %d  %ld %ld", fix.gps_satellite_quality, (long)fix.lat_e7, (long)fix.lon_e7);
+    fix.nmea_gga(bad_lat);
+    CHECK(fix.gps_satellite_quality == 0, "bad latitude kept quality %d", fix.gps_satellite_quality);
+    fix.nmea_gga(good);
+    fix.nmea_gga(bad_lon);
+    CHECK(fix.gps_satellite_quality == 0, "bad longitude kept quality %d", fix.gps_satellite_quality);
+}
+
+static void
+bench(void)
+{
+    static char fields[BENCH][24];
+    uint32_t t, int_cyc = 0, dbl_cyc = 0;
+    uint64_t ns, int_ns, dbl_ns;
+    int32_t v;
+    volatile int32_t sink;
+
+    for (int i = 0; i < BENCH; i++) field(fields[i], 180, 3);
+    for (int i = 0; i < BENCH; i++) {
+        t = DWT->CYCCNT;
+        GPS_Geodetic::parse_coord_e7(fields[i], false, &v);
+        int_cyc += DWT->CYCCNT - t;
+        sink = v;
+        t = DWT->CYCCNT;
+        v = convert_double(fields[i], false);
+        dbl_cyc += DWT->CYCCNT - t;
+        sink = v;
+    }
+    // Wall clock over whole loops, the clock costs more than a call.
+    ns = test_ns();
+    for (int i = 0; i < BENCH; i++) {
+        GPS_Geodetic::parse_coord_e7(fields[i], false, &v);
+        sink = v;
+    }
+    int_ns = test_ns() - ns;
+    ns = test_ns();
+    for (int i = 0; i < BENCH; i++) sink = convert_double(fields[i], false);
+    dbl_ns = test_ns() - ns;
+    printf("bench: parse_coord_e7 %u cyc %u ns  double %u cyc %u ns\r\n", int_cyc / BENCH,
+        (uint32_t)(int_ns / BENCH), dbl_cyc / BENCH, (uint32_t)(dbl_ns / BENCH));
+}
+
+int
+main(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    fuzz();
+    malformed();
+    gga();
+    bench();
+
+    test_done();
+}
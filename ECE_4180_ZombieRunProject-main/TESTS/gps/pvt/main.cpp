@@ -0,0 +1,249 @@
+// Puts the same 10 Hz fixes through GPS as NMEA and as UBX, the way a
+// receiver sends them, and compares what comes out and what it costs.
+//
+// The stream is made here, a run north-east at 3 m/s from 12:00:00 UTC:
+// RMC, VTG and GGA for NMEA, NAV-DOP and NAV-PVT for UBX. Every message
+// goes to rx_byte() with poll() after it, as the UART interrupt and the
+// 10ms ticktock() would have it. Both must give the same positions,
+// speeds and HDOP; NAV-PVT's time must include its nano field, which
+// can put the solution a fraction of a ms either side of the epoch, and
+// the NMEA time must keep the hhmmss.sss fraction of its RMC. The last
+// NO_DOP fixes have no NAV-DOP, the HDOP falls back to the PDOP.
+//
+// The cost is bytes on the wire and wall clock ns per fix, rx_byte()
+// to the decoded fix, over REPEATS passes of the stream.
+
+#include "mbed.h"
+#include "GPS.h"
+#include "../../test.h"
+
+#define EPOCHS      600
+#define REPEATS     20
+#define START_LAT   337756000
+#define START_LON   -843963000
+#define STEP_LAT    19          // 1e-7 degrees per fix, 0.21 m north
+#define STEP_LON    23          // and 0.21 m east
+#define HDOP        90          // 0.01, as NAV-DOP has it
+#define PDOP        160
+#define LEAP_S      18          // GPS time is ahead of UTC
+#define NO_DOP      20          // the last fixes come without NAV-DOP
+
+// A whole stream, and where each message in it ends.
+struct Stream {
+    uint8_t  bytes[EPOCHS * 320];
+    int      len;
+    int      ends[EPOCHS * 3];
+    int      msgs;
+};
+
+static Stream nmea, ubx;
+static GPS gps_nmea(p9, p10), gps_ubx(p13, p14);
+
+// Where each GPS's VTG callback found it, by fix.
+static GPS_Geodetic nmea_fix[EPOCHS], ubx_fix[EPOCHS];
+static GPS_VTG nmea_vtg[EPOCHS], ubx_vtg[EPOCHS];
+static uint64_t nmea_ms[EPOCHS], ubx_ms[EPOCHS];
+static int nmea_n, ubx_n;
+
+// The fraction of the ms NAV-PVT's nano adds to each epoch's time, ns,
+// and what that rounds to. Seven of them, so each falls on whole
+// seconds too, where a negative nano belongs to the second before.
+static const int32_t jitter_ns[7] = { 0, 300000, -600000, 700000, -200, -499999, 499999 };
+static const int jitter_ms[7] = { 0, 0, -1, 1, 0, 0, 0 };
+
+static void
+add(Stream *s, const uint8_t *b, int len)
+{
+    memcpy(s->bytes + s->len, b, len);
+    s->len += len;
+    s->ends[s->msgs++] = s->len;
+}
+
+static void
+add_nmea(const char *body)
+{
+    char buf[GPS_BUFFER_LEN];
+    uint8_t cs = 0;
+
+    for (int i = 0; body[i]; i++) cs ^= (uint8_t)body[i];
+    add(&nmea, (const uint8_t *)buf, snprintf(buf, sizeof(buf), "$%s*%02X\r\n", body, cs));
+}
+
+static void
+add_ubx(uint8_t id, const uint8_t *payload, uint16_t len)
+{
+    uint8_t buf[GPS_UBX_PAYLOAD_LEN + GPS_UBX_OVERHEAD];
+
+    add(&ubx, buf, GPS_UBX::build(buf, UBX_CLASS_NAV, id, payload, len));
+}
+
+// ddmm.mmmmmmm, exact for a value in 1e-7 degrees.
+static void
+nmea_coord(char *out, int32_t e7, int deg_digits, char *hemi, char pos, char neg)
+{
+    uint32_t a = e7 < 0 ? -e7 : e7;
+    uint32_t deg = a / 10000000;
+    uint64_t min_e7 = (uint64_t)(a % 10000000) * 60;
+
+    sprintf(out, "%0*u%02u.%07u", deg_digits, deg, (unsigned)(min_e7 / 10000000), (unsigned)(min_e7 % 10000000));
+    *hemi = e7 < 0 ? neg : pos;
+}
+
+static void
+make(void)
+{
+    float north = STEP_LAT * 0.0111195f, east = STEP_LON * 0.0111195f * cosf(33.7756f * 0.01745329f);
+    float mps = sqrtf(north * north + east * east) * 10.0f;
+    float track = atan2f(east, north) * 57.2957795f;
+    char body[100], lat[20], lon[20], ns, ew;
+    uint8_t p[92];
+
+    for (int i = 0; i < EPOCHS; i++) {
+        int32_t lat_e7 = START_LAT + i * STEP_LAT, lon_e7 = START_LON + i * STEP_LON;
+        int ms = i * 100, sec = ms / 1000 % 60, min = ms / 60000;
+        int32_t nano = (ms % 1000) * 1000000 + jitter_ns[i % 7];
+
+        nmea_coord(lat, lat_e7, 2, &ns, 'N', 'S');
+        nmea_coord(lon, lon_e7, 3, &ew, 'E', 'W');
+        snprintf(body, sizeof(body), "GPRMC,12%02d%02d.%03d,A,%s,%c,%s,%c,%.3f,%.2f,181026,,,A",
+            min, sec, ms % 1000, lat, ns, lon, ew, mps * 1.94384449f, track);
+        add_nmea(body);
+        snprintf(body, sizeof(body), "GPVTG,%.2f,T,,M,%.3f,N,%.3f,K,A", track, mps * 1.94384449f, mps * 3.6f);
+        add_nmea(body);
+        snprintf(body, sizeof(body), "GPGGA,12%02d%02d.%03d,%s,%c,%s,%c,1,09,%.2f,290.0,M,-30.0,M,,",
+            min, sec, ms % 1000, lat, ns, lon, ew, HDOP * 0.01f);
+        add_nmea(body);
+
+        // iTOW is the same for both, the DOP goes first as the receiver sends it.
+        uint32_t itow = (12 * 3600 + LEAP_S) * 1000 + ms;
+        memset(p, 0, sizeof(p));
+        GPS_UBX::put32(&p[0], itow);
+        GPS_UBX::put16(&p[6], PDOP);
+        GPS_UBX::put16(&p[12], HDOP);
+        if (i < EPOCHS - NO_DOP) add_ubx(UBX_NAV_DOP, p, UBX_NAV_DOP_LEN);
+
+        memset(p, 0, sizeof(p));
+        GPS_UBX::put32(&p[0], itow);
+        GPS_UBX::put16(&p[4], 2026);
+        p[6] = 10;
+        p[7] = 18;
+        p[8] = 12;
+        p[9] = min;
+        p[10] = sec;
+        p[11] = 0x07;                               // date, time, fully resolved
+        GPS_UBX::put32(&p[16], (uint32_t)nano);
+        p[20] = 3;                                  // 3D
+        p[21] = 0x01;                               // gnssFixOK
+        p[23] = 9;
+        GPS_UBX::put32(&p[24], (uint32_t)lon_e7);
+        GPS_UBX::put32(&p[28], (uint32_t)lat_e7);
+        GPS_UBX::put32(&p[36], 290000);             // hMSL, mm
+        GPS_UBX::put32(&p[60], (uint32_t)(mps * 1000.0f + 0.5f));
+        GPS_UBX::put32(&p[64], (uint32_t)(track * 1e5f + 0.5f));
+        GPS_UBX::put16(&p[76], PDOP);
+        add_ubx(UBX_NAV_PVT, p, sizeof(p));
+    }
+}
+
+// After the GGA, so well after the RMC set the time.
+static void
+on_nmea(void)
+{
+    GPS_Time t;
+
+    if (nmea_n < EPOCHS) {
+        gps_nmea.geodetic(&nmea_fix[nmea_n]);
+        gps_nmea.vtg(&nmea_vtg[nmea_n]);
+        nmea_ms[nmea_n] = gps_nmea.timeNow(&t)->epochMs();
+    }
+    nmea_n++;
+}
+
+static void
+on_ubx(void)
+{
+    if (ubx_n < EPOCHS) {
+        gps_ubx.geodetic(&ubx_fix[ubx_n]);
+        gps_ubx.vtg(&ubx_vtg[ubx_n]);
+    }
+    ubx_n++;
+}
+
+// NAV-PVT sets the time after the position and speed.
+static void
+on_ubx_time(void)
+{
+    GPS_Time t;
+
+    if (ubx_n > 0 && ubx_n <= EPOCHS) ubx_ms[ubx_n - 1] = gps_ubx.timeNow(&t)->epochMs();
+}
+
+// Feed a stream, returns ns for the lot.
+static uint64_t
+play(GPS &gps, const Stream &s)
+{
+    uint64_t start = test_ns();
+    int b = 0;
+
+    for (int m = 0; m < s.msgs; m++) {
+        for (; b < s.ends[m]; b++) gps.rx_byte((char)s.bytes[b], host_us);
+        gps.poll();
+        host_us += 1000;
+    }
+    return test_ns() - start;
+}
+
+int
+main(void)
+{
+    GPS_Time ref;
+    uint64_t base, nmea_ns = 0, ubx_ns = 0;
+    int lat_off = 0, speed_off = 0, hdop_off = 0, nmea_time_off = 0, time_off = 0;
+
+    make();
+    gps_nmea.attach_vtg(&on_nmea);
+    gps_ubx.attach_vtg(&on_ubx);
+    gps_ubx.attach_rmc(&on_ubx_time);
+    play(gps_nmea, nmea);
+    play(gps_ubx, ubx);
+    CHECK(nmea_n == EPOCHS && ubx_n == EPOCHS, "%d NMEA and %d UBX fixes of %d", nmea_n, ubx_n, EPOCHS);
+
+    ref.set(2026, 10, 18, 12, 0, 0, 0);
+    base = ref.epochMs();
+    for (int i = 0; i < EPOCHS && i < nmea_n && i < ubx_n; i++) {
+        GPS_Geodetic &a = nmea_fix[i], &b = ubx_fix[i];
+        if (a.lat_e7 != b.lat_e7 || a.lon_e7 != b.lon_e7 || b.lat_e7 != START_LAT + i * STEP_LAT) lat_off++;
+        if (fabs(nmea_vtg[i]._velocity_kph - ubx_vtg[i]._velocity_kph) > 0.01
+            || fabs(nmea_vtg[i]._track_true - ubx_vtg[i]._track_true) > 0.01) speed_off++;
+        // Without a NAV-DOP the last one does for a second, then the PDOP.
+        int dop_age = (i - (EPOCHS - NO_DOP - 1)) * 100;
+        double hdop = dop_age > 1000 ? PDOP * 0.01 : HDOP * 0.01;
+        if (fabs(a.hdop - HDOP * 0.01) > 1e-6 || fabs(b.hdop - hdop) > 1e-6) hdop_off++;
+        if (nmea_ms[i] != base + i * 100) {
+            if (nmea_time_off++ < 3) printf("NMEA fix %d at %+d ms\r\n", i, (int)(nmea_ms[i] - base - i * 100));
+        }
+        if (ubx_ms[i] != base + i * 100 + jitter_ms[i % 7]) {
+            if (time_off++ < 3) printf("fix %d at %+d ms\r\n", i, (int)(ubx_ms[i] - base - i * 100));
+        }
+    }
+    printf("compared %d fixes: %d positions, %d speeds, %d HDOPs, %d NMEA and %d UBX times differ\r\n",
+        EPOCHS, lat_off, speed_off, hdop_off, nmea_time_off, time_off);
+    CHECK(lat_off == 0, "%d positions differ", lat_off);
+    CHECK(speed_off == 0, "%d speeds or tracks differ", speed_off);
+    CHECK(hdop_off == 0, "%d HDOPs wrong", hdop_off);
+    CHECK(nmea_time_off == 0, "%d RMC times without their fraction", nmea_time_off);
+    CHECK(time_off == 0, "%d NAV-PVT times without their nano", time_off);
+
+    for (int r = 0; r < REPEATS; r++) {
+        nmea_ns += play(gps_nmea, nmea);
+        ubx_ns += play(gps_ubx, ubx);
+    }
+    printf("NMEA RMC+VTG+GGA %4d bytes/fix %6u ns/fix\r\n", nmea.len / EPOCHS,
+        (uint32_t)(nmea_ns / (REPEATS * EPOCHS)));
+    printf("UBX  DOP+PVT     %4d bytes/fix %6u ns/fix\r\n", ubx.len / EPOCHS,
+        (uint32_t)(ubx_ns / (REPEATS * EPOCHS)));
+    CHECK(ubx_ns < nmea_ns, "UBX took %u ns a fix, NMEA %u", (uint32_t)(ubx_ns / (REPEATS * EPOCHS)),
+        (uint32_t)(nmea_ns / (REPEATS * EPOCHS)));
+
+    test_done();
+}
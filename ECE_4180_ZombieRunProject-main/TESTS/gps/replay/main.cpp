@@ -0,0 +1,143 @@
+// Records two hours of a 1 Hz receiver through GPS_Log and plays it
+// back through GPS_Replay, checking every GGA reaches GPS when it is
+// due at 100 times and at half speed.
+//
+// The recording's stamps start just short of us_ticker's wrap and go
+// round it once more, and the half speed run takes four hours of
+// us_ticker, so both the stamps and the playback clock wrap. The bytes
+// are spread out as a 9600 baud UART sends them, 1042us apart.
+//
+// The benchmark is wall clock ns per record and per recorded second,
+// as fast as possible and at 100 times.
+
+#include "mbed.h"
+#include "GPS.h"
+#include "GPS_Log.h"
+#include "../../test.h"
+
+#define SECONDS     7200
+#define FIRST_STAMP 0xfff00000u     // a second before us_ticker wraps
+#define BYTE_US     1042
+#define REPEATS     5
+
+static GPS gps(p9, p10);
+static GPS_Log glog;
+static GPS_Replay replay(&gps);
+
+// When each GGA was recorded, its '\n' in us from the first record,
+// and when it came out of GPS.
+static uint64_t gga_rec[SECONDS];
+static uint64_t gga_out[SECONDS];
+static uint64_t played_us;
+static int gga_n;
+
+static void
+on_gga(void)
+{
+    if (gga_n < SECONDS) gga_out[gga_n] = played_us;
+    gga_n++;
+}
+
+static void
+put_nmea(const char *body, uint32_t *t)
+{
+    char buf[GPS_BUFFER_LEN];
+    uint8_t cs = 0;
+    int len;
+
+    for (int i = 0; body[i]; i++) cs ^= (uint8_t)body[i];
+    len = snprintf(buf, sizeof(buf), "$%s*%02X\r\n", body, cs);
+    for (int i = 0; i < len; i++) {
+        glog.put(buf[i], *t);
+        if (i < len - 1) *t += BYTE_US;
+    }
+}
+
+static FILE *
+record(void)
+{
+    FILE *fp = tmpfile();
+    char body[100];
+
+    CHECK(glog.begin(fp), "no recording header");
+    for (int s = 0; s < SECONDS; s++) {
+        uint32_t second = FIRST_STAMP + (uint32_t)s * 1000000, t = second;
+        int hh = 12 + s / 3600, mm = s / 60 % 60, ss = s % 60;
+
+        glog.pps(t);
+        t += 50000;
+        snprintf(body, sizeof(body), "GPRMC,%02d%02d%02d.000,A,3345.3360,N,08423.7780,W,0.0,0.0,181026,,,A",
+            hh, mm, ss);
+        put_nmea(body, &t);
+        snprintf(body, sizeof(body), "GPGGA,%02d%02d%02d.000,3345.3360,N,08423.7780,W,1,09,0.90,290.0,M,-30.0,M,,",
+            hh, mm, ss);
+        put_nmea(body, &t);
+        gga_rec[s] = (uint64_t)s * 1000000 + (t - second);
+        glog.flush(fp);
+    }
+    CHECK(glog.overruns() == 0, "%u blocks lost recording", glog.overruns());
+    return fp;
+}
+
+// Plays the recording at num/den, waiting out what step() asks for.
+// Returns the largest difference in us between a GGA coming out and
+// when it was due, 0 as fast as possible.
+static uint64_t
+play(FILE *fp, uint32_t num, uint32_t den)
+{
+    uint64_t worst = 0, start = played_us;
+    int us;
+
+    rewind(fp);
+    gga_n = 0;
+    replay.speed(num, den);
+    CHECK(replay.open(fp), "recording won't open");
+    while ((us = replay.step()) >= 0) {
+        host_us += us;
+        played_us += us;
+    }
+    CHECK(gga_n == SECONDS, "%d GGAs of %d at %u/%u", gga_n, SECONDS, num, den);
+    for (int i = 0; num && i < gga_n && i < SECONDS; i++) {
+        uint64_t due = start + gga_rec[i] * den / num;
+        uint64_t off = gga_out[i] > due ? gga_out[i] - due : due - gga_out[i];
+        if (off > worst) worst = off;
+    }
+    return worst;
+}
+
+int
+main(void)
+{
+    FILE *fp;
+    uint64_t ns;
+    uint32_t records;
+
+    gps.rxLive(false);
+    gps.attach_gga(&on_gga);
+    host_us = FIRST_STAMP;
+    fp = record();
+
+    for (int i = 0; i < 2; i++) {
+        uint32_t num = i ? 1 : 100, den = i ? 2 : 1;
+        uint64_t start = played_us, worst = play(fp, num, den);
+        records = replay.records();
+        printf("%u/%u: %u records, %u s of us_ticker, GGAs at most %u us off\r\n", num, den,
+            records, (uint32_t)((played_us - start) / 1000000), (uint32_t)worst);
+        CHECK(worst == 0, "GGAs off schedule at %u/%u", num, den);
+    }
+
+    ns = test_ns();
+    for (int r = 0; r < REPEATS; r++) play(fp, 0, 1);
+    ns = test_ns() - ns;
+    printf("as fast as possible %6u ns/record %6u ns/recorded s\r\n",
+        (uint32_t)(ns / ((uint64_t)REPEATS * records)), (uint32_t)(ns / (REPEATS * SECONDS)));
+
+    ns = test_ns();
+    for (int r = 0; r < REPEATS; r++) play(fp, 100, 1);
+    ns = test_ns() - ns;
+    printf("100x                %6u ns/record %6u ns/recorded s\r\n",
+        (uint32_t)(ns / ((uint64_t)REPEATS * records)), (uint32_t)(ns / (REPEATS * SECONDS)));
+
+    fclose(fp);
+    test_done();
+}
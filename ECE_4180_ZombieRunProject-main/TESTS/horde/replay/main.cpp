@@ -0,0 +1,202 @@
+// Replays player tracks through ZombieHorde the way readGPS drives it.
+//
+// 10 Hz fixes go through KalmanTracker, the horde ticks at its 5 Hz
+// output with the filtered position. A track is either exact or has the
+// GPS-like error of the kalman/track case (a slow 2 m wander and 0.5 m
+// of white noise) with a VTG speed and track. Four zombies at the
+// default 1.85 m/s, the game's "4" button.
+//
+// Checked on every tick: a zombie's straight line distance is never
+// more than its distance along the track, and nobody is caught who
+// wasn't reached along the track. A profile without a lunge period is
+// refused.
+
+#include "mbed.h"
+#include "KalmanTracker.h"
+#include "ZombieHorde.h"
+#include "../../test.h"
+
+#define LAT0        33.7756
+#define LON0        -84.3963
+#define M_PER_DEG   111194.9
+#define FIX_US      100000
+#define PI_F        3.14159265f
+#define ZOMBIES     4
+#define SPEED       1.85f
+
+// Where the player truly is at t seconds, metres east and north, and
+// their speed.
+typedef void (*Track)(float t, float *e, float *n, float *v);
+
+static void
+stand(float t, float *e, float *n, float *v)
+{
+    *e = *n = *v = 0.0f;
+}
+
+// North at 3 m/s.
+static void
+straight(float t, float *e, float *n, float *v)
+{
+    *e = 0.0f;
+    *n = 3.0f * t;
+    *v = 3.0f;
+}
+
+// 60 m north and back at 3 m/s, through the horde on the way back.
+static void
+out_back(float t, float *e, float *n, float *v)
+{
+    *e = 0.0f;
+    *n = t < 20.0f ? 3.0f * t : 120.0f - 3.0f * t;
+    *v = 3.0f;
+}
+
+// Round a 400 m running track (as a circle) at 3 m/s.
+static void
+loop(float t, float *e, float *n, float *v)
+{
+    float r = 400.0f / (2.0f * PI_F), a = 3.0f * t / r;
+
+    *e = r * sinf(a);
+    *n = r - r * cosf(a);
+    *v = 3.0f;
+}
+
+struct Chase {
+    //! Seconds until caught, -1 if never.
+    float caught_s;
+    //! Closest in a straight line over the whole chase.
+    float nearest;
+    //! Worst straight line distance over the distance along the track.
+    float worst;
+    //! Metres travelled, the truth and the horde's.
+    float truth;
+    float travelled;
+    //! The closest zombie at the end.
+    float closest;
+};
+
+static Chase
+replay(Track track, float seconds, bool noisy)
+{
+    KalmanTracker kf;
+    static ZombieHorde horde;
+    Chase c = { -1.0f, 1e9f, -1e9f, 0.0f, 0.0f, 0.0f };
+    float e, n, v, pe, pn, we = 0.0f, wn = 0.0f;
+    uint32_t start = 1000000, now = start, next_out = start;
+    int fixes = (int)(seconds * 1e6f / FIX_US);
+
+    seed = 1;
+    horde.reset(ZOMBIES, SPEED);
+    track(0.0f, &pe, &pn, &v);
+    for (int i = 0; i <= fixes; i++) {
+        float t = (float)i * FIX_US * 1e-6f;
+        track(t, &e, &n, &v);
+        c.truth += sqrtf((e - pe) * (e - pe) + (n - pn) * (n - pn));
+        pe = e;
+        pn = n;
+
+        // The horde at the filter's output rate, before this fix.
+        for (; (int32_t)(now - next_out) >= 0; next_out += kf.outputPeriodMs() * 1000) {
+            kf.advance(next_out);
+            if (!kf.valid()) continue;
+            horde.tick((next_out - start) / 1000, kf.east(), kf.north());
+
+            float behind = 1e9f;
+            for (int z = 0; z < horde.size(); z++) {
+                if (horde.behind(z) < behind) behind = horde.behind(z);
+            }
+            if (horde.closest() < c.nearest) c.nearest = horde.closest();
+            if (horde.closest() - behind > c.worst) c.worst = horde.closest() - behind;
+            if (horde.caught() && c.caught_s < 0.0f) {
+                c.caught_s = (next_out - start) * 1e-6f;
+                CHECK(behind <= 0.0f, "caught %.2f m behind along the track", behind);
+            }
+        }
+
+        float fe = e, fn = n, ve = 0.0f, vn = 0.0f, kph = v * 3.6f, deg;
+        if (noisy) {
+            we += -we * 0.005f + gauss() * 0.2f;
+            wn += -wn * 0.005f + gauss() * 0.2f;
+            fe += we + gauss() * 0.5f;
+            fn += wn + gauss() * 0.5f;
+            kph = (v + gauss() * 0.2f) * 3.6f;
+            if (kph < 0.0f) kph = 0.0f;
+        }
+        kf.position(LAT0 + fn / M_PER_DEG, LON0 + fe / (M_PER_DEG * cos(LAT0 * PI_F / 180.0)),
+            1.0, 1, now);
+
+        // VTG: the direction of travel, meaningless when stood still.
+        float de, dn, dv;
+        track(t + 0.05f, &de, &dn, &dv);
+        ve = de - e;
+        vn = dn - n;
+        deg = atan2f(ve, vn) * 180.0f / PI_F + (noisy ? gauss() * 5.0f : 0.0f);
+        if (deg < 0.0f) deg += 360.0f;
+        kf.velocity(kph, deg, now);
+
+        now += FIX_US;
+    }
+    c.travelled = horde.travelled();
+    c.closest = horde.closest();
+    return c;
+}
+
+static void
+show(const char *name, const Chase &c)
+{
+    printf("%-14s caught %5.1f s  nearest %5.1f m  end %6.1f m  travelled %6.1f of %6.1f m\r\n",
+        name, c.caught_s, c.nearest, c.closest, c.travelled, c.truth);
+    // Rounding of the integer distances and interpolation only.
+    CHECK(c.worst <= 0.01f, "%s: %.3f m nearer along the track than in a line", name, -c.worst);
+}
+
+int
+main(void)
+{
+    Chase c, d;
+
+    // Standing still they come straight in, noise or not.
+    c = replay(stand, 30.0f, false);
+    show("stand", c);
+    CHECK(c.caught_s > 0.0f && c.caught_s < 10.0f, "stand: caught at %.1f s", c.caught_s);
+    d = replay(stand, 30.0f, true);
+    show("stand/noisy", d);
+    CHECK(d.caught_s > 0.0f && fabsf(d.caught_s - c.caught_s) < 2.0f,
+        "stand/noisy: caught at %.1f s, %.1f s without noise", d.caught_s, c.caught_s);
+    // The filtered wander makes a step or two, not a walk.
+    CHECK(d.travelled <= 3.0f * HORDE_STEP_MM / 1000.0f, "stand/noisy: wandered %.1f m", d.travelled);
+
+    // Running away, the track is as long as the run.
+    c = replay(straight, 60.0f, true);
+    show("straight/noisy", c);
+    CHECK(c.caught_s < 0.0f, "straight: caught at %.1f s", c.caught_s);
+    CHECK(fabsf(c.travelled - c.truth) < 0.05f * c.truth, "straight: travelled %.1f m of %.1f", c.travelled, c.truth);
+    d = replay(straight, 60.0f, true);
+    CHECK(d.closest == c.closest && d.travelled == c.travelled, "straight: a replay differs");
+
+    // Back through them: close in a line, but they follow the track to
+    // the turn first.
+    c = replay(out_back, 40.0f, false);
+    show("out and back", c);
+    CHECK(c.caught_s < 0.0f, "out and back: caught at %.1f s", c.caught_s);
+    CHECK(c.nearest < 3.0f, "out and back: never nearer than %.1f m", c.nearest);
+
+    // Two and a bit laps, more track than is kept.
+    c = replay(loop, 300.0f, true);
+    show("loop/noisy", c);
+    CHECK(c.caught_s < 0.0f, "loop: caught at %.1f s", c.caught_s);
+    CHECK(fabsf(c.travelled - c.truth) < 0.05f * c.truth, "loop: travelled %.1f m of %.1f", c.travelled, c.truth);
+
+    // tick() would divide by the 0 period.
+    ZombieHorde horde;
+    ZombieProfile p = { 900, 1800, 1500, 0, 1500, 3000 };
+    horde.reset(ZOMBIES, SPEED);
+    CHECK(!horde.setProfile(0, &p), "a 0 ms lunge period was taken");
+    p.period_ms = 6000;
+    CHECK(horde.setProfile(0, &p), "a 6 s lunge period was refused");
+    horde.tick(1000, 0.0f, 0.0f);
+
+    test_done();
+}
@@ -0,0 +1,80 @@
+// The host mbed's registers, clock and hooks.
+
+#include "mbed.h"
+#include "rtos.h"
+#include <stdarg.h>
+
+uint32_t host_us = 0;
+void (*host_on_wait)(void) = NULL;
+void (*host_on_tx)(int c) = NULL;
+
+static HostUart uart[4];
+HostUart *LPC_UART0 = &uart[0];
+HostUart *LPC_UART1 = &uart[1];
+HostUart *LPC_UART2 = &uart[2];
+HostUart *LPC_UART3 = &uart[3];
+
+static HostRtc rtc;
+HostRtc *LPC_RTC = &rtc;
+
+static HostDwt dwt;
+HostDwt *DWT = &dwt;
+
+static HostCoreDebug core_debug;
+HostCoreDebug *CoreDebug = &core_debug;
+
+uint32_t SystemCoreClock = 96000000;
+
+// What Profiler.cpp reads of RTX: nothing is ever running.
+extern "C" {
+    struct { void *run; void *new_tsk; } os_tsk;
+    char os_idle_TCB[64];
+    osThreadId osThreadId_osTimerThread = NULL;
+}
+
+uint32_t
+us_ticker_read(void)
+{
+    return host_us;
+}
+
+void
+wait_us(int us)
+{
+    host_us += us;
+    if (host_on_wait != NULL) host_on_wait();
+}
+
+void
+wait_ms(int ms)
+{
+    wait_us(ms * 1000);
+}
+
+void
+wait(float s)
+{
+    wait_us((int)(s * 1000000.0f));
+}
+
+void
+set_time(time_t t)
+{
+}
+
+void
+error(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    exit(2);
+}
+
+osThreadId
+osThreadGetId(void)
+{
+    return NULL;
+}
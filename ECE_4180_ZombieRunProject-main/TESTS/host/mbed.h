@@ -0,0 +1,222 @@
+// Just enough of mbed 2 to build the modules a case tests on a PC.
+//
+// Time is simulated: us_ticker_read() is host_us, which only moves when
+// a case or a wait moves it. Each wait calls host_on_wait so a case can
+// play a device answering while the code under test waits for it, and
+// each byte a Serial sends goes to host_on_tx. Tickers, Timeouts and
+// pin interrupts are never called, a case calls the handlers itself; a
+// Serial's attached handlers are called by host_irq().
+// The DWT cycle counter reads 0, cycle counts are the target's to give.
+
+#ifndef MBED_H
+#define MBED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// The simulated clock and the hooks.
+extern uint32_t host_us;
+extern void (*host_on_wait)(void);
+extern void (*host_on_tx)(int c);
+
+uint32_t us_ticker_read(void);
+void wait(float s);
+void wait_ms(int ms);
+void wait_us(int us);
+void set_time(time_t t);
+void error(const char *format, ...);
+
+typedef enum {
+    p5 = 5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16, p17, p18, p19,
+    p20, p21, p22, p23, p24, p25, p26, p27, p28, p29, p30,
+    LED1, LED2, LED3, LED4, USBTX, USBRX,
+    NC = -1
+} PinName;
+
+typedef enum { PullUp, PullDown, PullNone, OpenDrain } PinMode;
+
+// A UART's registers at the LPC1768's offsets, LSR reads 0: nothing received.
+struct HostUart {
+    volatile uint32_t RBR, IER, IIR, LCR, MCR, LSR, MSR, SCR;
+};
+extern HostUart *LPC_UART0, *LPC_UART1, *LPC_UART2, *LPC_UART3;
+
+struct HostRtc {
+    volatile uint32_t ILR, CCR, CALIBRATION;
+};
+extern HostRtc *LPC_RTC;
+
+struct HostDwt {
+    volatile uint32_t CTRL, CYCCNT;
+};
+extern HostDwt *DWT;
+
+struct HostCoreDebug {
+    volatile uint32_t DEMCR;
+};
+extern HostCoreDebug *CoreDebug;
+
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      1UL
+
+extern uint32_t SystemCoreClock;
+
+// One CPU and no interrupts, so these have nothing to do.
+inline void __DMB(void) {}
+inline void __disable_irq(void) {}
+inline void __enable_irq(void) {}
+
+namespace mbed {
+
+// Calls a function or a member function, as mbed's does.
+class FunctionPointer {
+public:
+    FunctionPointer() : _f(NULL), _obj(NULL), _thunk(NULL) {}
+    FunctionPointer(void (*f)(void)) : _f(f), _obj(NULL), _thunk(NULL) {}
+    template <typename T>
+    FunctionPointer(T *obj, void (T::*m)(void)) { attach(obj, m); }
+
+    void attach(void (*f)(void)) { _f = f; _thunk = NULL; }
+
+    template <typename T>
+    void attach(T *obj, void (T::*m)(void)) {
+        _f = NULL;
+        _obj = obj;
+        memcpy(_m, &m, sizeof(m));
+        _thunk = &FunctionPointer::member<T>;
+    }
+
+    void call(void) {
+        if (_thunk != NULL) _thunk(_obj, _m);
+        else if (_f != NULL) _f();
+    }
+    void operator()(void) { call(); }
+
+private:
+    template <typename T>
+    static void member(void *obj, const char *m) {
+        void (T::*mp)(void);
+        memcpy(&mp, m, sizeof(mp));
+        (((T *)obj)->*mp)();
+    }
+
+    void (*_f)(void);
+    void *_obj;
+    char _m[2 * sizeof(void *)];
+    void (*_thunk)(void *, const char *);
+};
+
+template <typename F> class Callback;
+
+template <>
+class Callback<void()> : public FunctionPointer {
+public:
+    Callback() {}
+    Callback(void (*f)(void)) : FunctionPointer(f) {}
+    template <typename T>
+    Callback(T *obj, void (T::*m)(void)) : FunctionPointer(obj, m) {}
+};
+
+template <typename T>
+Callback<void()> callback(T *obj, void (T::*m)(void)) { return Callback<void()>(obj, m); }
+
+class SerialBase {
+public:
+    enum IrqType { RxIrq = 0, TxIrq };
+    enum Parity { None = 0, Odd, Even, Forced1, Forced0 };
+
+    void baud(int baudrate) {}
+    void format(int bits = 8, Parity parity = None, int stop_bits = 1) {}
+    int readable(void) { return 0; }
+    int writeable(void) { return 1; }
+    void attach(Callback<void()> cb, IrqType type = RxIrq) { _irq[type] = cb; }
+    void attach(void (*f)(void), IrqType type = RxIrq) { _irq[type] = Callback<void()>(f); }
+    template <typename T>
+    void attach(T *obj, void (T::*m)(void), IrqType type = RxIrq) { _irq[type] = Callback<void()>(obj, m); }
+
+    // The interrupt, as the UART would raise it.
+    void host_irq(IrqType type) { _irq[type].call(); }
+
+private:
+    Callback<void()> _irq[2];
+};
+
+class RawSerial : public SerialBase {
+public:
+    RawSerial(PinName tx, PinName rx) {}
+    int putc(int c) { if (host_on_tx != NULL) host_on_tx(c); return c; }
+    int getc(void) { return 0; }
+    int puts(const char *s) { while (*s) putc(*s++); return 0; }
+    int printf(const char *format, ...) { return 0; }
+};
+
+class Serial : public RawSerial {
+public:
+    Serial(PinName tx, PinName rx, const char *name = NULL) : RawSerial(tx, rx) {}
+};
+
+// On the simulated clock.
+class Timer {
+public:
+    Timer() : _running(false), _start(0), _us(0) {}
+    void start(void) { if (!_running) _start = host_us; _running = true; }
+    void stop(void) { _us = elapsed(); _running = false; }
+    void reset(void) { _start = host_us; _us = 0; }
+    int read_us(void) { return (int)elapsed(); }
+    int read_ms(void) { return (int)(elapsed() / 1000); }
+    float read(void) { return elapsed() / 1000000.0f; }
+
+private:
+    bool _running;
+    uint32_t _start;
+    uint32_t _us;
+
+    uint32_t elapsed(void) { return _us + (_running ? host_us - _start : 0); }
+};
+
+class Ticker {
+public:
+    void attach(Callback<void()> cb, float s) {}
+    void attach(void (*f)(void), float s) {}
+    template <typename T>
+    void attach(T *obj, void (T::*m)(void), float s) {}
+    void attach_us(Callback<void()> cb, uint32_t us) {}
+    void attach_us(void (*f)(void), uint32_t us) {}
+    template <typename T>
+    void attach_us(T *obj, void (T::*m)(void), uint32_t us) {}
+    void detach(void) {}
+};
+
+class Timeout : public Ticker {};
+
+class InterruptIn {
+public:
+    InterruptIn(PinName pin) {}
+    void mode(PinMode m) {}
+    void rise(void (*f)(void)) {}
+    void fall(void (*f)(void)) {}
+    template <typename T>
+    void rise(T *obj, void (T::*m)(void)) {}
+    template <typename T>
+    void fall(T *obj, void (T::*m)(void)) {}
+};
+
+class DigitalOut {
+public:
+    DigitalOut(PinName pin, int value = 0) : _value(value) {}
+    DigitalOut &operator=(int value) { _value = value; return *this; }
+    operator int() { return _value; }
+
+private:
+    int _value;
+};
+
+} // namespace mbed
+
+using namespace mbed;
+
+#endif
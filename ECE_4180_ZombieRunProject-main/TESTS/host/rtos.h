@@ -0,0 +1,130 @@
+// Just enough of the RTX rtos library for the modules a case tests.
+//
+// Threads are never started; a case drives a module's thread body or
+// its feed() itself. A wait moves the simulated clock, a signal_wait
+// times out at once and Mail is a working queue.
+
+#ifndef RTOS_H
+#define RTOS_H
+
+#include "mbed.h"
+
+typedef enum {
+    osPriorityIdle = -3,
+    osPriorityLow = -2,
+    osPriorityBelowNormal = -1,
+    osPriorityNormal = 0,
+    osPriorityAboveNormal = 1,
+    osPriorityHigh = 2,
+    osPriorityRealtime = 3
+} osPriority;
+
+typedef enum {
+    osOK = 0,
+    osEventSignal = 0x08,
+    osEventMessage = 0x10,
+    osEventMail = 0x20,
+    osEventTimeout = 0x40,
+    osErrorResource = 0x81
+} osStatus;
+
+typedef void *osThreadId;
+
+#define osWaitForever       0xFFFFFFFF
+#define DEFAULT_STACK_SIZE  2048
+
+typedef struct {
+    osStatus status;
+    union {
+        uint32_t v;
+        void    *p;
+        int32_t  signals;
+    } value;
+} osEvent;
+
+osThreadId osThreadGetId(void);
+
+namespace rtos {
+
+class Thread {
+public:
+    Thread(osPriority priority = osPriorityNormal, uint32_t stack_size = DEFAULT_STACK_SIZE,
+        unsigned char *stack = NULL) : _stack_size(stack_size) {}
+
+    osStatus start(mbed::Callback<void()> task) { return osOK; }
+    int32_t signal_set(int32_t signals) { return 0; }
+    uint32_t stack_size(void) { return _stack_size; }
+    uint32_t max_stack(void) { return 0; }
+
+    static osEvent signal_wait(int32_t signals, uint32_t ms = osWaitForever) {
+        osEvent e;
+        e.status = osEventTimeout;
+        return e;
+    }
+    static osStatus wait(uint32_t ms) { wait_ms(ms); return osOK; }
+    static osStatus yield(void) { return osOK; }
+
+private:
+    uint32_t _stack_size;
+};
+
+class Mutex {
+public:
+    osStatus lock(uint32_t ms = osWaitForever) { return osOK; }
+    bool trylock(void) { return true; }
+    osStatus unlock(void) { return osOK; }
+};
+
+template <typename T, uint32_t N>
+class Mail {
+public:
+    Mail() : _head(0), _count(0) { memset(_used, 0, sizeof(_used)); }
+
+    T *alloc(uint32_t ms = 0) {
+        for (uint32_t i = 0; i < N; i++) {
+            if (!_used[i]) {
+                _used[i] = true;
+                return &_pool[i];
+            }
+        }
+        return NULL;
+    }
+    T *calloc(uint32_t ms = 0) {
+        T *m = alloc(ms);
+        if (m != NULL) memset(m, 0, sizeof(T));
+        return m;
+    }
+    osStatus put(T *m) {
+        _queue[(_head + _count++) % N] = m;
+        return osOK;
+    }
+    osEvent get(uint32_t ms = osWaitForever) {
+        osEvent e;
+        if (_count == 0) {
+            e.status = osEventTimeout;
+            return e;
+        }
+        e.status = osEventMail;
+        e.value.p = _queue[_head];
+        _head = (_head + 1) % N;
+        _count--;
+        return e;
+    }
+    osStatus free(T *m) {
+        _used[m - _pool] = false;
+        return osOK;
+    }
+
+private:
+    T        _pool[N];
+    bool     _used[N];
+    T       *_queue[N];
+    uint32_t _head;
+    uint32_t _count;
+};
+
+} // namespace rtos
+
+using namespace rtos;
+
+#endif
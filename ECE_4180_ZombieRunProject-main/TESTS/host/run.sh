@@ -0,0 +1,65 @@
+#!/bin/sh
+# Builds the cases that run on a PC against the host mbed here, runs
+# them and sums up. With no arguments all of them, else the cases named.
+#
+#   TESTS/host/run.sh
+#   TESTS/host/run.sh gps/config kalman/track
+#
+# CXX picks the compiler, OUT where the programs go.
+
+cd "$(dirname "$0")/../.." || exit 2
+CXX=${CXX:-g++}
+OUT=${OUT:-${TMPDIR:-/tmp}/zombie-tests}
+
+GPS="MODGPS/GPS.cpp MODGPS/GPS_Config.cpp MODGPS/GPS_Geodetic.cpp MODGPS/GPS_GSA.cpp
+    MODGPS/GPS_GSV.cpp MODGPS/GPS_Log.cpp MODGPS/GPS_Rtc.cpp MODGPS/GPS_Time.cpp
+    MODGPS/GPS_UBX.cpp MODGPS/GPS_VTG.cpp Profiler.cpp"
+
+# The modules each case is built with. state/latch needs RTX's threads
+# and audio/player the DMA and a card, they stay on the target.
+# gps/config needs the host's hooks and gps/replay a file, they stay
+# here.
+sources() {
+    case $1 in
+        blue/parser)        echo BlueParser.cpp Profiler.cpp ;;
+        course/jitter)      echo CourseEngine.cpp ;;
+        gps/config)         echo $GPS ;;
+        gps/coord)          echo MODGPS/GPS_Geodetic.cpp ;;
+        gps/pvt)            echo $GPS ;;
+        gps/bench)          echo $GPS MODGPS/GPS_Bench.cpp ;;
+        gps/replay)         echo $GPS ;;
+        horde/replay)       echo ZombieHorde.cpp KalmanTracker.cpp DistanceEngine.cpp ;;
+        kalman/track)       echo KalmanTracker.cpp DistanceEngine.cpp ;;
+        position/replay)    echo PositionSource.cpp MODGPS/GPS_Geodetic.cpp ;;
+        route/lookup)       echo Route.cpp ;;
+        telemetry/frames)   echo Telemetry.cpp Profiler.cpp ;;
+        *)                  return 1 ;;
+    esac
+}
+
+CASES=${*:-"blue/parser course/jitter gps/bench gps/config gps/coord gps/pvt gps/replay horde/replay kalman/track position/replay route/lookup telemetry/frames"}
+
+mkdir -p "$OUT" || exit 2
+passed=0
+failed=""
+for c in $CASES; do
+    src=$(sources "$c") || { echo "$c: not a host case"; failed="$failed $c"; continue; }
+    bin="$OUT/$(echo "$c" | tr / _)"
+    echo "== $c"
+    if ! $CXX -std=gnu++98 -O2 -Wall -Wno-unused -DTEST_HOST -ITESTS/host -I. -IMODGPS \
+            -o "$bin" TESTS/host/host.cpp "TESTS/$c/main.cpp" $src -lm; then
+        failed="$failed $c"
+        continue
+    fi
+    "$bin" > "$bin.log"
+    status=$?
+    tr -d '\r' < "$bin.log"
+    if [ $status -eq 0 ]; then
+        passed=$((passed + 1))
+    else
+        failed="$failed $c"
+    fi
+done
+
+echo "== $passed passed${failed:+, failed:$failed}"
+[ -z "$failed" ]
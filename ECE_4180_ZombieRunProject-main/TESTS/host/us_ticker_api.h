@@ -0,0 +1,7 @@
+#ifndef US_TICKER_API_H
+#define US_TICKER_API_H
+
+// us_ticker_read() is in the host mbed.h, on the simulated clock.
+#include "mbed.h"
+
+#endif
@@ -0,0 +1,204 @@
+// Evaluates KalmanTracker on tracks with a known ground truth: distance
+// error against the truth and against DistanceEngine on the same fixes,
+// and cycles per measurement update.
+//
+// Each track is made at 10 Hz: a GGA position and a VTG speed/track,
+// with the filter output at its own 5 Hz as readGPS runs it. Position
+// error is what a GPS module's is like, mostly a slow wander (a random
+// walk pulled back with a 20 s time constant, 2 m) with 0.5 m of white
+// noise on top, at HDOP 1.0. VTG speed has 0.2 m/s of noise and its
+// track 5 degrees, it is Doppler and much cleaner than the positions.
+// The runs without VTG are the phone's fixes, positions only.
+//
+// A late run has exact fixes that each arrive after the output for
+// LATE_US past their stamp: the output must still be where the player
+// is at its own time.
+//
+// DWT cycles on the target include the soft float; they must stay in
+// KF_CYCLE_BUDGET.
+
+#include "mbed.h"
+#include "KalmanTracker.h"
+#include "DistanceEngine.h"
+#include "../../test.h"
+
+#define LAT0        33.7756
+#define LON0        -84.3963
+#define M_PER_DEG   111194.9
+#define FIX_US      100000
+#define PI_F        3.14159265f
+#define LATE_US     60000
+
+// Where the player truly is at t seconds, metres east and north, and
+// their speed.
+typedef void (*Track)(float t, float *e, float *n, float *v);
+
+static void
+stand(float t, float *e, float *n, float *v)
+{
+    *e = *n = *v = 0.0f;
+}
+
+// North at 3 m/s.
+static void
+straight(float t, float *e, float *n, float *v)
+{
+    *e = 0.0f;
+    *n = 3.0f * t;
+    *v = 3.0f;
+}
+
+// Round a 400 m running track (as a circle) at 3.5 m/s.
+static void
+loop(float t, float *e, float *n, float *v)
+{
+    float r = 400.0f / (2.0f * PI_F), a = 3.5f * t / r;
+
+    *e = r * sinf(a);
+    *n = r - r * cosf(a);
+    *v = 3.5f;
+}
+
+// 30 s run at 4 m/s, 30 s walk at 1.3 m/s, 30 s stood still, 30 s run.
+static void
+intervals(float t, float *e, float *n, float *v)
+{
+    *e = 0.0f;
+    if (t < 30.0f) {
+        *v = 4.0f;
+        *n = 4.0f * t;
+    } else if (t < 60.0f) {
+        *v = 1.3f;
+        *n = 120.0f + 1.3f * (t - 30.0f);
+    } else if (t < 90.0f) {
+        *v = 0.0f;
+        *n = 159.0f;
+    } else {
+        *v = 4.0f;
+        *n = 159.0f + 4.0f * (t - 90.0f);
+    }
+}
+
+// Run a track through both, with or without VTG. Returns how far out
+// the filter's distance is, and the raw one's in raw_err.
+static float
+evaluate(const char *name, Track track, float seconds, bool vtg, float *raw_err)
+{
+    KalmanTracker kf;
+    DistanceEngine raw;
+    float e, n, v, pe, pn, we = 0.0f, wn = 0.0f, truth = 0.0f, kf_err;
+    uint32_t now = 1000000, next_out = now, cycles = 0, updates = 0;
+    double lat, lon;
+    int fixes = (int)(seconds * 1e6f / FIX_US);
+
+    track(0.0f, &pe, &pn, &v);
+    for (int i = 0; i <= fixes; i++) {
+        float t = (float)i * FIX_US * 1e-6f;
+        track(t, &e, &n, &v);
+        truth += sqrtf((e - pe) * (e - pe) + (n - pn) * (n - pn));
+        pe = e;
+        pn = n;
+
+        // The slow wander, then the white noise.
+        we += -we * 0.005f + gauss() * 0.2f;
+        wn += -wn * 0.005f + gauss() * 0.2f;
+        lat = LAT0 + (n + wn + gauss() * 0.5f) / M_PER_DEG;
+        lon = LON0 + (e + we + gauss() * 0.5f) / (M_PER_DEG * cos(LAT0 * PI_F / 180.0));
+
+        // The output ticks that fell before this fix.
+        for (; (int32_t)(now - next_out) >= 0; next_out += kf.outputPeriodMs() * 1000) {
+            kf.advance(next_out);
+        }
+        if (kf.position(lat, lon, 1.0, 1, now)) {
+            cycles += kf.cycles();
+            updates++;
+        }
+        raw.update(lat, lon, 1.0, 1);
+
+        // VTG: the direction of travel, meaningless when stood still.
+        float ve = 0.0f, vn = 0.0f, track_deg;
+        if (i > 0) {
+            float de, dn;
+            track(t + 0.05f, &de, &dn, &v);
+            ve = de - e;
+            vn = dn - n;
+        }
+        track_deg = atan2f(ve, vn) * 180.0f / PI_F + gauss() * 5.0f;
+        if (track_deg < 0.0f) track_deg += 360.0f;
+        float kph = (v + gauss() * 0.2f) * 3.6f;
+        if (kph < 0.0f) kph = 0.0f;
+        if (vtg && kf.velocity(kph, track_deg, now)) {
+            cycles += kf.cycles();
+            updates++;
+        }
+        now += FIX_US;
+    }
+    kf.advance(now);
+
+    kf_err = kf.metres() - truth;
+    *raw_err = raw.metres() - truth;
+    printf("%-10s truth %6.1f m  kf %6.1f m (%+5.1f)  raw %6.1f m (%+5.1f)  %u cyc avg %u max\r\n",
+        name, truth, kf.metres(), kf_err, raw.metres(), *raw_err,
+        updates ? cycles / updates : 0, kf.maxCycles());
+
+    CHECK(kf.maxCycles() <= KF_CYCLE_BUDGET, "%s: %u cycles, budget %d", name, kf.maxCycles(), KF_CYCLE_BUDGET);
+    CHECK(kf.overBudget() == 0, "%s: %d updates over budget", name, kf.overBudget());
+    return kf_err;
+}
+
+// North at 3 m/s, no noise. Each fix is stamped when it was measured
+// but picked up after an output LATE_US later, as when readGPS wakes on
+// its timeout just before the sentence is parsed.
+static void
+late(void)
+{
+    KalmanTracker kf;
+    uint32_t start = 1000000, t = start;
+    float before = 0.0f, after = 0.0f, d;
+
+    for (int i = 0; i <= 300; i++) {
+        t = start + i * FIX_US;
+        kf.advance(t + LATE_US);
+        // Once the filter has the speed, where the output says against
+        // where the player is at the output's time.
+        d = fabsf(kf.north() - 3.0f * (i * FIX_US + LATE_US) * 1e-6f);
+        if (i > 20 && d > before) before = d;
+        kf.position(LAT0 + 3.0 * i * FIX_US * 1e-6 / M_PER_DEG, LON0, 1.0, 1, t);
+        kf.velocity(3.0 * 3.6, 0.0, t);
+        d = fabsf(kf.north() - 3.0f * (i * FIX_US + LATE_US) * 1e-6f);
+        if (i > 20 && d > after) after = d;
+    }
+    kf.advance(t + LATE_US);
+
+    d = kf.metres() - 3.0f * (t + LATE_US - start) * 1e-6f;
+    printf("late       output %.3f m out before a fix, %.3f m after  distance %+.2f m\r\n", before, after, d);
+    CHECK(before <= 0.05f && after <= 0.05f, "late: output %.3f / %.3f m from the player", before, after);
+    CHECK(fabsf(d) <= 0.5f, "late: distance %.2f m out", d);
+}
+
+int
+main(void)
+{
+    float kf, raw;
+
+    // With VTG: within 3% of the distance, and a few metres for the stops.
+    kf = evaluate("stand", stand, 120.0f, true, &raw);
+    CHECK(fabsf(kf) <= 5.0f, "stand: %.1f m out", kf);
+    kf = evaluate("straight", straight, 120.0f, true, &raw);
+    CHECK(fabsf(kf) <= 0.03f * 360.0f, "straight: %.1f m out", kf);
+    kf = evaluate("loop", loop, 240.0f, true, &raw);
+    CHECK(fabsf(kf) <= 0.03f * 840.0f, "loop: %.1f m out", kf);
+    kf = evaluate("intervals", intervals, 120.0f, true, &raw);
+    CHECK(fabsf(kf) <= 0.03f * 279.0f + 5.0f, "intervals: %.1f m out", kf);
+
+    // Positions only, as from the phone. The filter can't tell the slow
+    // wander from walking, it only has to do better than the raw sum.
+    kf = evaluate("stand/pos", stand, 120.0f, false, &raw);
+    CHECK(fabsf(kf) < fabsf(raw) / 2.0f, "stand/pos: %.1f m out, raw %.1f m", kf, raw);
+    kf = evaluate("loop/pos", loop, 240.0f, false, &raw);
+    CHECK(fabsf(kf) < fabsf(raw) / 2.0f, "loop/pos: %.1f m out, raw %.1f m", kf, raw);
+
+    late();
+
+    test_done();
+}
@@ -0,0 +1,103 @@
+// Replays a module and a phone stream through PositionSource.
+//
+// The player runs north at 3 m/s for 60 s. The module sends 10 fixes a
+// second with a few tens of cm of noise and loses its fix from 20 to 35 s.
+// The phone sends one a second, 4 m north and 3 m east of the module.
+// The fixes put out must stay in time order, come from one source at a
+// time, keep coming through the outage and never step by the offset.
+
+#include "mbed.h"
+#include "PositionSource.h"
+#include "../../test.h"
+
+#define RUN_US      60000000
+#define OUTAGE_FROM 20000000
+#define OUTAGE_TO   35000000
+#define SPEED_E7    270         // 3 m/s north, 1e-7 degree is 1.11 cm
+#define START_LAT   337756000
+#define START_LON   -843963000
+#define PHONE_LAT   360         // 4 m
+#define PHONE_LON   320         // 3 m at 33.8 degrees north
+
+struct Replay {
+    PositionSource position;
+    GPS_Geodetic   fix;
+    bool           started;
+    uint32_t       last_us;
+    int32_t        last_lat;
+    int            last_source;
+    uint32_t       max_gap_us;
+    int32_t        max_step_e7;
+    int            interleaved;
+    
+    Replay() : started(false), last_us(0), last_lat(0), last_source(-1),
+        max_gap_us(0), max_step_e7(0), interleaved(0) {}
+    
+    void offer(int source, const PositionSample *s) {
+        if (!position.ingest(source, s, &fix)) return;
+        if (started) {
+            CHECK(fix.timestamp_us > last_us, "fix at %u us after one at %u us", fix.timestamp_us, last_us);
+            uint32_t gap = fix.timestamp_us - last_us;
+            if (gap > max_gap_us) max_gap_us = gap;
+            // What the fix moved beyond what the player ran in between.
+            int32_t step = fix.lat_e7 - last_lat - (int32_t)((uint64_t)gap * SPEED_E7 / 1000000);
+            if (step < 0) step = -step;
+            if (step > max_step_e7) max_step_e7 = step;
+            if (source != last_source && gap < 200000) interleaved++;
+        }
+        started = true;
+        last_us = fix.timestamp_us;
+        last_lat = fix.lat_e7;
+        last_source = source;
+    }
+};
+
+int
+main(void)
+{
+    Replay r;
+    PositionSample s;
+    int32_t lat_e7, lon_e7;
+    
+    for (uint32_t t = 0; t < RUN_US; t += 10000) {
+        int32_t lat = START_LAT + (int32_t)((uint64_t)t * SPEED_E7 / 1000000);
+        
+        if (t % 100000 == 0 && (t < OUTAGE_FROM || t >= OUTAGE_TO)) {
+            s.lat_e7 = lat + noise(20);
+            s.lon_e7 = START_LON + noise(20);
+            s.alt = 300.0f;
+            s.hdop = 1.2f;
+            s.quality = 1;
+            s.stamp_us = t + 1;
+            r.offer(positionModule, &s);
+        }
+        if (t % 1000000 == 30000) {
+            s.lat_e7 = lat + PHONE_LAT + noise(30);
+            s.lon_e7 = START_LON + PHONE_LON + noise(30);
+            s.alt = 310.0f;
+            s.hdop = 0.0f;
+            s.quality = 1;
+            s.stamp_us = t + 1;
+            r.offer(positionPhone, &s);
+        }
+    }
+    
+    printf("fixes %u  module %u/%u  phone %u/%u used/dropped  switches %u\r\n",
+        r.position.fixes(), r.position.used(positionModule), r.position.dropped(positionModule),
+        r.position.used(positionPhone), r.position.dropped(positionPhone), r.position.switches());
+    printf("longest gap %u us  worst step %d e-7 deg\r\n", r.max_gap_us, r.max_step_e7);
+    
+    CHECK(r.position.offset(&lat_e7, &lon_e7), "no offset measured");
+    CHECK(lat_e7 > PHONE_LAT - 30 && lat_e7 < PHONE_LAT + 30, "offset lat %d", lat_e7);
+    CHECK(lon_e7 > PHONE_LON - 30 && lon_e7 < PHONE_LON + 30, "offset lon %d", lon_e7);
+    // Into the outage and back out of it.
+    CHECK(r.position.switches() == 2, "%u switches", r.position.switches());
+    CHECK(r.interleaved == 0, "%d fixes alternated between the sources", r.interleaved);
+    // The module stops, its last fix is stale 1.5 s later and the phone's
+    // next one comes at most a second after that.
+    CHECK(r.max_gap_us <= POSITION_STALE_US + 1000000, "gap of %u us", r.max_gap_us);
+    // Noise and the lag of the phone's offset, 1 m, not the 4 m offset.
+    CHECK(r.max_step_e7 < 90, "step of %d e-7 deg", r.max_step_e7);
+    
+    test_done();
+}
@@ -0,0 +1,161 @@
+// Benchmarks Route::find() on routes of 10, 100 and 1000 checkpoints
+// and checks it against testing every checkpoint, then walks routes
+// through Route::update().
+//
+// Routes wander north-east with checkpoints 20-40 m apart. Fixes are
+// within 20 m of a random checkpoint, so most are inside one radius and
+// the rest just outside. Cycles are counted with the DWT cycle counter
+// on the target, wall clock ns on both. Route file coordinates must be
+// within 90 degrees for a latitude and 180 for a longitude.
+
+#include "mbed.h"
+#include "Route.h"
+#include "../../test.h"
+
+#define START_LAT   337756000
+#define START_LON   -843963000
+#define STEP_E7     1800        // 20 m north and east between checkpoints
+#define WANDER_E7   900         // and up to 10 m either way of that
+#define FIX_E7      1800        // fixes up to 20 m each way from one
+#define FINDS       2000
+
+// Testing every checkpoint, what the grid saves.
+class ScanRoute : public Route {
+public:
+    int scan(int32_t lat_e7, int32_t lon_e7) {
+        int32_t x, y;
+        int64_t dx, dy, d, best_d = (int64_t)_r_mm * _r_mm + 1;
+        int best = -1;
+
+        to_mm(lat_e7, lon_e7, &x, &y);
+        for (int i = 0; i < _count; i++) {
+            dx = x - _x[i];
+            dy = y - _y[i];
+            d = dx * dx + dy * dy;
+            if (d < best_d) {
+                best_d = d;
+                best = i;
+            }
+        }
+        return best;
+    }
+};
+
+// Too big for the stack.
+static ScanRoute route;
+static int32_t lat[1000], lon[1000];
+static int32_t fix_lat[FINDS], fix_lon[FINDS];
+
+static void
+walk(int n)
+{
+    route.clear();
+    lat[0] = START_LAT;
+    lon[0] = START_LON;
+    for (int i = 0; i < n; i++) {
+        if (i > 0) {
+            lat[i] = lat[i - 1] + STEP_E7 + noise(WANDER_E7);
+            lon[i] = lon[i - 1] + STEP_E7 + noise(WANDER_E7);
+        }
+        route.add(lat[i], lon[i]);
+    }
+    route.build();
+}
+
+static void
+bench(int n)
+{
+    uint32_t find_cyc = 0, scan_cyc = 0, t;
+    uint64_t ns, find_ns, scan_ns;
+    volatile int sink;
+    int j, a, b, hits = 0, wrong = 0, tested = 0, most = 0;
+    int32_t fa, fb;
+
+    walk(n);
+    for (int k = 0; k < FINDS; k++) {
+        j = (int)((uint32_t)(noise(0x7fff) + 0x7fff) % n);
+        fa = fix_lat[k] = lat[j] + noise(FIX_E7);
+        fb = fix_lon[k] = lon[j] + noise(FIX_E7);
+
+        t = DWT->CYCCNT;
+        a = route.find(fa, fb);
+        find_cyc += DWT->CYCCNT - t;
+        t = DWT->CYCCNT;
+        b = route.scan(fa, fb);
+        scan_cyc += DWT->CYCCNT - t;
+
+        if (a != b) wrong++;
+        if (a >= 0) hits++;
+        tested += route.tested();
+        if (route.tested() > most) most = route.tested();
+    }
+    // Wall clock over whole loops, the clock costs more than a find.
+    ns = test_ns();
+    for (int k = 0; k < FINDS; k++) sink = route.find(fix_lat[k], fix_lon[k]);
+    find_ns = test_ns() - ns;
+    ns = test_ns();
+    for (int k = 0; k < FINDS; k++) sink = route.scan(fix_lat[k], fix_lon[k]);
+    scan_ns = test_ns() - ns;
+    printf("%4d points: %d%% hits  %.2f tested (%d max)  %u cyc %u ns/find  scan %u cyc %u ns\r\n",
+        n, hits * 100 / FINDS, (float)tested / FINDS, most, find_cyc / FINDS,
+        (uint32_t)(find_ns / FINDS), scan_cyc / FINDS, (uint32_t)(scan_ns / FINDS));
+
+    CHECK(wrong == 0, "%d points: %d finds differ from the scan", n, wrong);
+    CHECK(hits > FINDS / 4, "%d points: only %d hits", n, hits);
+    // The work per fix doesn't grow with the route.
+    CHECK((float)tested / FINDS < 8.0f, "%d points: %.2f tested per find", n, (float)tested / FINDS);
+}
+
+int
+main(void)
+{
+    int n;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    bench(10);
+    bench(100);
+    bench(1000);
+
+    // Every checkpoint in turn, one fix at each.
+    walk(1000);
+    for (n = 0; n < 1000; n++) route.update(lat[n], lon[n]);
+    CHECK(route.finished(), "walked %d of 1000", route.reached());
+
+    // Fixes lost at one checkpoint, then at ROUTE_SKIP + 1 in a row.
+    route.restart();
+    for (n = 0; n < 1000; n++) {
+        if (n != 100) route.update(lat[n], lon[n]);
+    }
+    CHECK(route.finished(), "walked %d of 1000 missing one", route.reached());
+    route.restart();
+    for (n = 0; n < 200; n++) {
+        if (n <= 100 || n > 101 + ROUTE_SKIP) route.update(lat[n], lon[n]);
+    }
+    CHECK(route.reached() == 101, "reached %d missing %d", route.reached(), ROUTE_SKIP + 1);
+
+    // Out and back through the same spots: each way in its turn, and
+    // standing at the start doesn't finish the return.
+    route.clear();
+    for (n = 0; n < 10; n++) route.add(START_LAT + n * 2700, START_LON);
+    for (n = 9; n >= 0; n--) route.add(START_LAT + n * 2700, START_LON);
+    route.build();
+    route.update(START_LAT, START_LON);
+    CHECK(route.reached() == 1, "start reached %d", route.reached());
+    for (n = 0; n < 10; n++) route.update(START_LAT + n * 2700, START_LON);
+    CHECK(route.reached() == 10, "out reached %d", route.reached());
+    for (n = 9; n >= 0; n--) route.update(START_LAT + n * 2700, START_LON);
+    CHECK(route.finished(), "back reached %d", route.reached());
+
+    // A latitude past the pole is refused, a longitude that far isn't.
+    int32_t v;
+    CHECK(Route::parse_deg_e7("-84.3963012", 180, &v) && v == -843963012, "longitude read as %ld", (long)v);
+    CHECK(Route::parse_deg_e7("90", 90, &v) && v == 900000000, "90 N read as %ld", (long)v);
+    CHECK(!Route::parse_deg_e7("90.0000001", 90, &v), "latitude 90.0000001 taken");
+    CHECK(!Route::parse_deg_e7("-120.5", 90, &v), "latitude -120.5 taken");
+    CHECK(Route::parse_deg_e7("-120.5", 180, &v) && v == -1205000000, "longitude -120.5 read as %ld", (long)v);
+    CHECK(!Route::parse_deg_e7("180.5", 180, &v), "longitude 180.5 taken");
+
+    test_done();
+}
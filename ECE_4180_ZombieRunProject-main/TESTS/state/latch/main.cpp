@@ -0,0 +1,152 @@
+// Stress test for StateLatch: writers and readers preempting each other
+// at every point of a publish and a consume, no reader may see a torn
+// value or go back to an older one.
+//
+// A value is 16 words that are all the publish number. Three stages of
+// STAGE_MS each:
+// - low: the writer publishes flat out below the first reader, which
+//   wakes every ms and lands in the middle of its copies, and takes
+//   turns with the second as RTX round robins them.
+// - high: a Ticker wakes a writer thread above the readers every
+//   WAKE_US, which lands in the middle of their copies.
+// - isr: the Ticker publishes itself, the tightest a reader is ever
+//   preempted.
+
+#include "mbed.h"
+#include "rtos.h"
+#include "GameState.h"
+#include "../../test.h"
+
+#define WORDS       16
+#define STAGE_MS    5000
+#define WAKE_US     97          // not a multiple of anything the readers do
+#define SIG_WAKE    0x1
+
+struct Block {
+    uint32_t w[WORDS];
+};
+
+static StateLatch<Block> latch;
+static volatile int stage;
+static volatile bool stop;
+
+// Only the stage's writer touches it.
+static uint32_t number;
+
+static Thread writer_thread(osPriorityHigh, 512);
+static Thread spin_thread(osPriorityLow, 512);
+static Thread reader0_thread(osPriorityAboveNormal, 512);
+static Thread reader1_thread(osPriorityLow, 512);
+static Ticker ticker;
+
+static volatile uint32_t reads[2];
+static volatile uint32_t torn[2];
+static volatile uint32_t backwards[2];
+
+static void
+write_one(void)
+{
+    Block b;
+
+    number++;
+    for (int i = 0; i < WORDS; i++) b.w[i] = number;
+    latch.publish(b);
+}
+
+// One reader. The first wakes each ms, the second spins.
+static void
+read_loop(int r)
+{
+    Block b;
+    uint32_t last = 0;
+
+    while (!stop) {
+        latch.consume(&b);
+        for (int i = 1; i < WORDS; i++) {
+            if (b.w[i] != b.w[0]) {
+                torn[r]++;
+                break;
+            }
+        }
+        if (b.w[0] < last) backwards[r]++;
+        last = b.w[0];
+        reads[r]++;
+        if (r == 0) Thread::wait(1);
+    }
+}
+
+static void reader0(void) { read_loop(0); }
+static void reader1(void) { read_loop(1); }
+
+// Stage low, flat out at the second reader's priority.
+static void
+spin(void)
+{
+    while (!stop) {
+        if (stage == 0) write_one();
+        else Thread::wait(1);
+    }
+}
+
+// Stage high, a publish each time the Ticker says.
+static void
+writer(void)
+{
+    while (!stop) {
+        Thread::signal_wait(SIG_WAKE);
+        if (stage == 1) write_one();
+    }
+}
+
+static void
+tick(void)
+{
+    if (stage == 1) writer_thread.signal_set(SIG_WAKE);
+    if (stage == 2) write_one();
+}
+
+static void
+run(int s, const char *name)
+{
+    uint32_t seq = latch.sequence();
+    uint32_t r0 = reads[0], r1 = reads[1];
+
+    stage = s;
+    Thread::wait(STAGE_MS);
+    // Park the writers before the next one starts, one at a time.
+    stage = -1;
+    Thread::wait(10);
+
+    printf("%-4s %7u publishes  reads %6u + %7u\r\n", name,
+        latch.sequence() - seq, reads[0] - r0, reads[1] - r1);
+    CHECK(latch.sequence() - seq > 1000, "%s: only %u publishes", name, latch.sequence() - seq);
+    CHECK(reads[0] - r0 > STAGE_MS / 2, "%s: reader 0 only read %u", name, reads[0] - r0);
+    CHECK(reads[1] - r1 > 1000, "%s: reader 1 only read %u", name, reads[1] - r1);
+}
+
+int
+main(void)
+{
+    stage = -1;
+    reader0_thread.start(reader0);
+    reader1_thread.start(reader1);
+    spin_thread.start(spin);
+    writer_thread.start(writer);
+    ticker.attach_us(&tick, WAKE_US);
+
+    run(0, "low");
+    run(1, "high");
+    run(2, "isr");
+
+    ticker.detach();
+    stop = true;
+    writer_thread.signal_set(SIG_WAKE);
+    Thread::wait(10);
+
+    for (int r = 0; r < 2; r++) {
+        CHECK(torn[r] == 0, "reader %d saw %u torn values", r, torn[r]);
+        CHECK(backwards[r] == 0, "reader %d went back %u times", r, backwards[r]);
+    }
+
+    test_done();
+}
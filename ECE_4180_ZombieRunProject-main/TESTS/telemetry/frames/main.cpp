@@ -0,0 +1,157 @@
+// Telemetry frames through decode(), and Telemetry on the game's clock
+// across the wrap, counting what goes out on the UART.
+//
+// Round trip: random walks of samples, some with jumps too big for a
+// byte delta, must come back as the encoder rebuilt them, and a frame
+// with any one byte changed must be refused.
+//
+// Clock: readGPS samples every 200 ms with a ms clock that runs to 2^32
+// and wraps. Sampling must carry on through that wrap and stay inside
+// TELEMETRY_BYTES_PER_S. us_ticker_read() / 1000, which the game used
+// to pass, jumps back at 4294967 ms instead; how long that silences
+// telemetry is printed for comparison.
+
+#include "mbed.h"
+#include "Telemetry.h"
+#include "../../test.h"
+
+#define FRAMES      5000
+#define WAKE_MS     200         // readGPS's wakes, the tracker's 5 Hz
+#define RUN_MS      600000      // 10 minutes each side of a wrap
+
+static RawSerial blue(p13, p14);
+static uint32_t sent;
+
+static void
+on_tx(int c)
+{
+    sent++;
+}
+
+// Up to +-n from v, kept inside 0..65535.
+static uint16_t
+walk(uint16_t v, int32_t n)
+{
+    int32_t w = (int32_t)v + noise(n);
+
+    return (uint16_t)(w < 0 ? 0 : w > 65535 ? 65535 : w);
+}
+
+static int32_t
+clamp_byte(int32_t d)
+{
+    return d > 127 ? 127 : d < -128 ? -128 : d;
+}
+
+static void
+round_trip(void)
+{
+    TelemetrySample in[TELEMETRY_BATCH], out[TELEMETRY_BATCH];
+    char frame[TELEMETRY_FRAME];
+    uint16_t v[4] = { 0, 0, 500, 600 };
+    uint8_t seq;
+    int off = 0, missed = 0, taken = 0;
+
+    for (int f = 0; f < FRAMES; f++) {
+        int n = 1 + f % TELEMETRY_BATCH;
+        // One frame in ten jumps further than a byte delta reaches.
+        int32_t step = f % 10 ? 100 : 3000;
+
+        for (int i = 0; i < n; i++) {
+            for (int k = 0; k < 4; k++) v[k] = walk(v[k], step);
+            in[i].distance_dm = v[0];
+            in[i].speed_cms = v[1];
+            in[i].gap_dm = v[2];
+            in[i].remaining_s = v[3];
+        }
+        Telemetry::encode(in, n, (uint8_t)f, frame);
+        if (Telemetry::decode(frame, out, &seq) != n || seq != (uint8_t)f) {
+            missed++;
+            continue;
+        }
+        // The key sample is exact, each after it moves towards the truth
+        // by as much as a byte allows.
+        for (int i = 0; i < n; i++) {
+            const uint16_t *want = &in[i].distance_dm, *got = &out[i].distance_dm;
+            const uint16_t *last = i ? &out[i - 1].distance_dm : want;
+            for (int k = 0; k < 4; k++) {
+                int32_t expect = i ? last[k] + clamp_byte((int32_t)want[k] - last[k]) : want[k];
+                if (got[k] != expect) off++;
+            }
+        }
+        // Every byte of the frame matters.
+        for (int b = 0; b < TELEMETRY_FRAME; b++) {
+            char keep = frame[b];
+            frame[b] ^= (char)(1 + lcg() % 255);
+            if (Telemetry::decode(frame, out) >= 0) taken++;
+            frame[b] = keep;
+        }
+    }
+    printf("round trip: %d frames, %d not decoded, %d values off, %d damaged frames taken\r\n",
+        FRAMES, missed, off, taken);
+    CHECK(missed == 0, "%d frames not decoded", missed);
+    CHECK(off == 0, "%d values not as the encoder rebuilt them", off);
+    CHECK(taken == 0, "%d damaged frames taken", taken);
+}
+
+// Runs RUN_MS of readGPS's wakes, as clock() gives the time, and
+// returns the frames sent and bytes in the last RUN_MS / 2.
+static uint32_t
+run(Telemetry &t, uint32_t (*clock)(uint32_t wake), uint32_t *bytes)
+{
+    uint32_t frames = 0;
+
+    sent = 0;
+    for (uint32_t wake = 0; wake < RUN_MS; wake += WAKE_MS) {
+        if (wake == RUN_MS / 2) {
+            frames = t.frames();
+            sent = 0;
+        }
+        t.sample(clock(wake), 12.5f, 3.1f, 25.0f, 60000);
+        blue.host_irq(SerialBase::TxIrq);
+    }
+    *bytes = sent;
+    return t.frames() - frames;
+}
+
+// The clocks start RUN_MS / 2 and a wake before the wrap, so it falls
+// in the middle of a frame's samples.
+#define WRAP_MS     (RUN_MS / 2 + WAKE_MS)
+
+// The game's clock.
+static uint32_t
+ms_clock(uint32_t wake)
+{
+    return (uint32_t)(0x100000000ULL - WRAP_MS + wake);
+}
+
+// us_ticker_read() / 1000.
+static uint32_t
+us_clock(uint32_t wake)
+{
+    return (uint32_t)(0x100000000ULL - WRAP_MS * 1000ULL + wake * 1000ULL) / 1000;
+}
+
+int
+main(void)
+{
+    Telemetry ms(blue), us(blue);
+    uint32_t bytes, frames, us_frames, want = RUN_MS / 2 / WAKE_MS / TELEMETRY_BATCH;
+
+    host_on_tx = on_tx;
+    round_trip();
+
+    frames = run(ms, ms_clock, &bytes);
+    printf("ms clock: %u frames and %u bytes in the %u s after the wrap, %u B/s of %u, %u skipped\r\n",
+        frames, bytes, RUN_MS / 2000, bytes * 1000 / (RUN_MS / 2), TELEMETRY_BYTES_PER_S, ms.skipped());
+    CHECK(frames == want, "%u frames after the wrap, %u wanted", frames, want);
+    CHECK(bytes == frames * TELEMETRY_FRAME, "%u bytes for %u frames", bytes, frames);
+    CHECK(bytes * 1000 / (RUN_MS / 2) <= TELEMETRY_BYTES_PER_S, "%u B/s", bytes * 1000 / (RUN_MS / 2));
+    printf("%d bytes for %d samples, %d as %d absolute ones\r\n", TELEMETRY_FRAME, TELEMETRY_BATCH,
+        4 + 8 * TELEMETRY_BATCH + 1, TELEMETRY_BATCH);
+
+    us_frames = run(us, us_clock, &bytes);
+    printf("us_ticker_read() / 1000: %u frames in the %u s after the wrap\r\n", us_frames, RUN_MS / 2000);
+
+    test_done();
+}
@@ -0,0 +1,77 @@
+// What every case shares: the checks, a repeatable random sequence, a
+// clock for benchmarks and the end of a run.
+
+#ifndef TESTS_TEST_H
+#define TESTS_TEST_H
+
+#include "mbed.h"
+#include "us_ticker_api.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL " __VA_ARGS__); printf("\r\n"); } } while (0)
+
+static uint32_t seed = 1;
+
+static inline uint32_t
+lcg(void)
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 16;
+}
+
+// Noise of up to +-n.
+static inline int32_t
+noise(int32_t n)
+{
+    return (int32_t)lcg() % (2 * n + 1) - n;
+}
+
+// Roughly normal, mean 0 and standard deviation 1.
+static inline float
+gauss(void)
+{
+    float sum = 0.0f;
+
+    for (int i = 0; i < 12; i++) {
+        seed = seed * 1664525 + 1013904223;
+        sum += (float)(seed >> 8) / 16777216.0f;
+    }
+    return sum - 6.0f;
+}
+
+// Wall clock ns for benchmarks. The host's own clock, the target's
+// us_ticker (so only to the us) run on past its 32 bit wrap.
+static inline uint64_t
+test_ns(void)
+{
+#ifdef TEST_HOST
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    static uint32_t last = 0;
+    static uint64_t us = 0;
+    uint32_t now = us_ticker_read();
+
+    us += now - last;
+    last = now;
+    return us * 1000;
+#endif
+}
+
+// The last line, PASS or FAIL. The target stops there, the host exits
+// with 1 on a failure.
+static inline void
+test_done(void)
+{
+    printf("%s\r\n", failures ? "FAIL" : "PASS");
+#ifdef TEST_HOST
+    exit(failures ? 1 : 0);
+#else
+    while (1) {}
+#endif
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include "Telemetry.h"
+#include "Profiler.h"
+
+static uint16_t
+clamp_u16(float x)
+{
+    if (x <= 0.0f) return 0;
+    if (x >= 65535.0f) return 65535;
+    return (uint16_t)(x + 0.5f);
+}
+
+static void
+put_u16(char *p, uint16_t v)
+{
+    p[0] = (char)(v & 0xFF);
+    p[1] = (char)(v >> 8);
+}
+
+static uint16_t
+get_u16(const char *p)
+{
+    return (uint16_t)((uint8_t)p[0] | ((uint8_t)p[1] << 8));
+}
+
+// Delta from the rebuilt value, clamped to a byte, and the value rebuilt.
+static int8_t
+delta(uint16_t want, uint16_t *have)
+{
+    int32_t d = (int32_t)want - (int32_t)*have;
+    
+    if (d > 127) d = 127;
+    if (d < -128) d = -128;
+    *have = (uint16_t)(*have + d);
+    return (int8_t)d;
+}
+
+Telemetry::Telemetry(RawSerial &serial) : _serial(serial)
+{
+    _head = _tail = 0;
+    _seq = 0;
+    _frames = _skipped = 0;
+    _budget = 2 * TELEMETRY_FRAME;
+    _budget_ms = 0;
+    reset();
+}
+
+void
+Telemetry::reset(void)
+{
+    _n = 0;
+    _next_ms = 0;
+}
+
+int
+Telemetry::encode(const TelemetrySample *batch, int n, uint8_t seq, char *frame)
+{
+    TelemetrySample have = batch[0];
+    char sum = 0;
+    int i, k = 12;
+    
+    memset(frame, 0, TELEMETRY_FRAME);
+    frame[0] = '!';
+    frame[1] = 'T';
+    frame[2] = (char)seq;
+    frame[3] = (char)n;
+    put_u16(&frame[4], batch[0].distance_dm);
+    put_u16(&frame[6], batch[0].speed_cms);
+    put_u16(&frame[8], batch[0].gap_dm);
+    put_u16(&frame[10], batch[0].remaining_s);
+    for (i = 1; i < n; i++) {
+        frame[k++] = (char)delta(batch[i].distance_dm, &have.distance_dm);
+        frame[k++] = (char)delta(batch[i].speed_cms, &have.speed_cms);
+        frame[k++] = (char)delta(batch[i].gap_dm, &have.gap_dm);
+        frame[k++] = (char)delta(batch[i].remaining_s, &have.remaining_s);
+    }
+    for (i = 0; i < TELEMETRY_FRAME - 1; i++) sum += frame[i];
+    frame[TELEMETRY_FRAME - 1] = ~sum;
+    return TELEMETRY_FRAME;
+}
+
+int
+Telemetry::decode(const char *frame, TelemetrySample *batch, uint8_t *seq)
+{
+    char sum = 0;
+    int i, n, k = 12;
+    
+    if (frame[0] != '!' || frame[1] != 'T') return -1;
+    for (i = 0; i < TELEMETRY_FRAME - 1; i++) sum += frame[i];
+    if ((char)~sum != frame[TELEMETRY_FRAME - 1]) return -1;
+    n = (uint8_t)frame[3];
+    if (n < 1 || n > TELEMETRY_BATCH) return -1;
+    
+    if (seq) *seq = (uint8_t)frame[2];
+    batch[0].distance_dm = get_u16(&frame[4]);
+    batch[0].speed_cms = get_u16(&frame[6]);
+    batch[0].gap_dm = get_u16(&frame[8]);
+    batch[0].remaining_s = get_u16(&frame[10]);
+    for (i = 1; i < n; i++) {
+        batch[i].distance_dm = (uint16_t)(batch[i - 1].distance_dm + (int8_t)frame[k++]);
+        batch[i].speed_cms = (uint16_t)(batch[i - 1].speed_cms + (int8_t)frame[k++]);
+        batch[i].gap_dm = (uint16_t)(batch[i - 1].gap_dm + (int8_t)frame[k++]);
+        batch[i].remaining_s = (uint16_t)(batch[i - 1].remaining_s + (int8_t)frame[k++]);
+    }
+    return n;
+}
+
+bool
+Telemetry::sample(uint32_t now_ms, float distance_m, float speed_ms, float gap_m, uint32_t remaining_ms)
+{
+    TelemetrySample *s;
+    
+    if (_n > 0 && (int32_t)(now_ms - _next_ms) < 0) return false;
+    _next_ms = now_ms + TELEMETRY_SAMPLE_MS;
+    
+    s = &_batch[_n++];
+    s->distance_dm = clamp_u16(distance_m * 10.0f);
+    s->speed_cms = clamp_u16(speed_ms * 100.0f);
+    s->gap_dm = clamp_u16(gap_m * 10.0f);
+    s->remaining_s = clamp_u16((float)remaining_ms * 0.001f);
+    if (_n < TELEMETRY_BATCH) return false;
+    _n = 0;
+    
+    // Refill the bucket for the time since the last frame, at most two
+    // frames' worth so a quiet spell doesn't turn into a burst.
+    _budget += (now_ms - _budget_ms) * TELEMETRY_BYTES_PER_S / 1000;
+    _budget_ms = now_ms;
+    if (_budget > 2 * TELEMETRY_FRAME) _budget = 2 * TELEMETRY_FRAME;
+    if (_budget < TELEMETRY_FRAME || !send()) {
+        _skipped++;
+        return false;
+    }
+    _budget -= TELEMETRY_FRAME;
+    _frames++;
+    return true;
+}
+
+bool
+Telemetry::send(void)
+{
+    char frame[TELEMETRY_FRAME];
+    uint32_t used = (_head - _tail) & (TELEMETRY_TX_BUFFER - 1);
+    
+    if (TELEMETRY_TX_BUFFER - 1 - used < TELEMETRY_FRAME) return false;
+    encode(_batch, TELEMETRY_BATCH, _seq++, frame);
+    for (int i = 0; i < TELEMETRY_FRAME; i++) {
+        _tx[_head] = frame[i];
+        _head = (_head + 1) & (TELEMETRY_TX_BUFFER - 1);
+    }
+    // The interrupt comes as soon as the transmitter has room.
+    _serial.attach(mbed::Callback<void()>(this, &Telemetry::tx_irq), SerialBase::TxIrq);
+    return true;
+}
+
+void
+Telemetry::tx_irq(void)
+{
+    PROFILE_ISR(profileIsrBlueTx);
+    while (_tail != _head && _serial.writeable()) {
+        _serial.putc(_tx[_tail]);
+        _tail = (_tail + 1) & (TELEMETRY_TX_BUFFER - 1);
+    }
+    if (_tail == _head) _serial.attach(mbed::Callback<void()>(), SerialBase::TxIrq);
+}
@@ -0,0 +1,126 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "mbed.h"
+
+// Samples per frame, the first absolute and the rest deltas.
+#define TELEMETRY_BATCH 4
+
+// '!' 'T' seq count, 8 byte key sample, 4 bytes per delta, checksum.
+#define TELEMETRY_FRAME (4 + 8 + 4 * (TELEMETRY_BATCH - 1) + 1)
+
+// Time between samples, ms.
+#ifndef TELEMETRY_SAMPLE_MS
+#define TELEMETRY_SAMPLE_MS 100
+#endif
+
+// Share of the link telemetry may use, bytes/s. 240 is a quarter of 9600 baud.
+#ifndef TELEMETRY_BYTES_PER_S
+#define TELEMETRY_BYTES_PER_S 240
+#endif
+
+// Transmit ring, must be a power of two.
+#ifndef TELEMETRY_TX_BUFFER
+#define TELEMETRY_TX_BUFFER 64
+#endif
+
+/** One telemetry sample, in the units sent. */
+struct TelemetrySample {
+    //! Distance made good, dm.
+    uint16_t distance_dm;
+    //! Speed, cm/s.
+    uint16_t speed_cms;
+    //! Gap to the closest zombie, dm.
+    uint16_t gap_dm;
+    //! Time left in the phase, s.
+    uint16_t remaining_s;
+};
+
+/** Telemetry sends the run's progress to the phone over the Bluefruit UART.
+ *
+ * Samples are taken every TELEMETRY_SAMPLE_MS and sent TELEMETRY_BATCH
+ * to a fixed size frame, framed like the app's own packets so the phone
+ * side can use the same parser:
+ *
+ *   '!' 'T' seq count | key sample, 4 x uint16 LE | 3 x (4 x int8 delta) | ~sum
+ *
+ * Each delta is from the previous sample as the decoder will rebuild it,
+ * so a delta that has to be clamped is made up by the next one. 4 samples
+ * cost 25 bytes rather than 40.
+ *
+ * Frames go out of a ring from the TX interrupt, the caller never waits
+ * on the UART. A token bucket holds telemetry to TELEMETRY_BYTES_PER_S,
+ * leaving the rest of the link free, and frames over the budget are
+ * skipped rather than queued up late.
+ *
+ * encode() and decode() are plain functions, so the phone or a host can
+ * use decode() as it is.
+ *
+ * The clock given to sample() must run on to 2^32 ms before it wraps.
+ * us_ticker_read() / 1000 goes back to 0 after 4294967 ms and would
+ * leave a frame's samples waiting for that time to come round again.
+ * main.cpp's now_ms() is such a clock.
+ *
+ * Example:
+ * @code
+ * Telemetry telemetry(blue);
+ *
+ * while (running) {
+ *     telemetry.sample(now_ms(), course.best(), tracker.speed(),
+ *         horde.closest(), session.remainingMs());
+ *     Thread::wait(50);
+ * }
+ * @endcode
+ */
+class Telemetry {
+public:
+
+    Telemetry(RawSerial &serial);
+    
+    //! Start a new run, the next sample starts a frame.
+    void reset(void);
+    
+    /** Offer the current state, sampled every TELEMETRY_SAMPLE_MS.
+     *
+     * @return true if this completed a frame and it was queued.
+     */
+    bool sample(uint32_t now_ms, float distance_m, float speed_ms, float gap_m, uint32_t remaining_ms);
+    
+    //! Build a frame from n (1..TELEMETRY_BATCH) samples, returns its length.
+    static int encode(const TelemetrySample *batch, int n, uint8_t seq, char *frame);
+    
+    //! Unpack a frame, returns the number of samples or -1 if it is bad.
+    static int decode(const char *frame, TelemetrySample *batch, uint8_t *seq = NULL);
+    
+    //! Frames queued.
+    uint32_t frames(void) { return _frames; }
+    
+    //! Frames skipped to stay inside the budget.
+    uint32_t skipped(void) { return _skipped; }
+
+protected:
+
+    RawSerial &_serial;
+    
+    TelemetrySample _batch[TELEMETRY_BATCH];
+    int      _n;
+    uint8_t  _seq;
+    uint32_t _next_ms;
+    
+    // Token bucket, bytes.
+    uint32_t _budget;
+    uint32_t _budget_ms;
+    
+    // Filled by the caller, emptied by the TX interrupt.
+    char              _tx[TELEMETRY_TX_BUFFER];
+    volatile uint32_t _head;
+    volatile uint32_t _tail;
+    
+    uint32_t _frames;
+    uint32_t _skipped;
+    
+    bool send(void);
+    void tx_irq(void);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "ToneSequencer.h"
+#include "Profiler.h"
+
+ToneSequencer::ToneSequencer(PwmOut &pwm) : _pwm(pwm)
+{
+    _notes = NULL;
+    _n = _i = 0;
+    _loop = false;
+    _due_us = 0;
+    _pulsing = false;
+    _pulse_cur = 0;
+    _pulse_seq = _pulse_seen = 0;
+    memset(_pulse, 0, sizeof(_pulse));
+    _phase_ms = _slice_ms = 0;
+    _sounding = 0.0f;
+    resetStats();
+}
+
+void
+ToneSequencer::sound(const Note *note)
+{
+    if (note->hz > 0.0f) {
+        _pwm.period(1.0f / note->hz);
+        _pwm = note->duty;
+    } else {
+        _pwm = 0.0f;
+    }
+}
+
+void
+ToneSequencer::play(const Note *notes, int n, bool loop)
+{
+    _timeout.detach();
+    _pulsing = false;
+    if (notes == NULL || n < 1) {
+        stop();
+        return;
+    }
+    _notes = notes;
+    _n = n;
+    _i = 0;
+    _loop = loop;
+    sound(&_notes[0]);
+    _due_us = us_ticker_read() + _notes[0].ms * 1000;
+    _timeout.attach_us(this, &ToneSequencer::next, _notes[0].ms * 1000);
+}
+
+void
+ToneSequencer::stop(void)
+{
+    _timeout.detach();
+    _pulsing = false;
+    _notes = NULL;
+    _pwm = 0.0f;
+}
+
+void
+ToneSequencer::setPulse(const TonePulse *p)
+{
+    int i = 1 - _pulse_cur;
+    
+    _pulse[i] = *p;
+    _pulse_cur = i;
+    _pulse_seq = _pulse_seq + 1;
+}
+
+void
+ToneSequencer::startPulse(void)
+{
+    _timeout.detach();
+    _notes = NULL;
+    _pwm = 0.0f;
+    _sounding = 0.0f;
+    _phase_ms = 0;
+    _slice_ms = 0;
+    _pulsing = true;
+    _due_us = us_ticker_read();
+    pulse_step(_due_us);
+}
+
+// One slice of the pulse pattern, from startPulse() and the Timeout.
+void
+ToneSequencer::pulse_step(uint32_t now)
+{
+    const TonePulse *p = &_pulse[_pulse_cur];
+    uint32_t seq = _pulse_seq;
+    
+    if (seq != _pulse_seen) {
+        _pulse_seen = seq;
+        uint32_t latency = now - p->stamp_us;
+        if (latency > _max_pulse_latency) _max_pulse_latency = latency;
+    }
+    
+    _phase_ms += _slice_ms;
+    if (_phase_ms >= p->period_ms) _phase_ms = 0;
+    bool on = p->hz > 0.0f && _phase_ms < p->on_ms;
+    
+    // Only touch the PWM on a change, setting the period restarts it.
+    float hz = on ? p->hz : 0.0f;
+    if (hz != _sounding) {
+        if (on) {
+            _pwm.period(1.0f / hz);
+            _pwm = p->duty;
+        } else {
+            _pwm = 0.0f;
+        }
+        _sounding = hz;
+    }
+    
+    uint32_t edge = on ? p->on_ms : p->period_ms;
+    _slice_ms = edge > _phase_ms ? edge - _phase_ms : TONE_SLICE_MS;
+    if (_slice_ms > TONE_SLICE_MS) _slice_ms = TONE_SLICE_MS;
+    _due_us += _slice_ms * 1000;
+    
+    int32_t wait = (int32_t)(_due_us - now);
+    if (wait < 1) wait = 1;
+    _timeout.attach_us(this, &ToneSequencer::next, wait);
+}
+
+// Timeout interrupt, one per note change.
+void
+ToneSequencer::next(void)
+{
+    PROFILE_ISR(profileIsrTones);
+    uint32_t now = us_ticker_read();
+    uint32_t late = now - _due_us;
+    
+    // Early would be a wrapped negative, count it as on time.
+    if ((int32_t)late < 0) late = 0;
+    _last_jitter = late;
+    if (late > _max_jitter) _max_jitter = late;
+    _transitions++;
+    
+    if (_pulsing) {
+        pulse_step(now);
+        return;
+    }
+    if (_notes == NULL) return;
+    if (++_i >= _n) {
+        if (!_loop) {
+            _notes = NULL;
+            _pwm = 0.0f;
+            return;
+        }
+        _i = 0;
+    }
+    sound(&_notes[_i]);
+    _due_us += _notes[_i].ms * 1000;
+    
+    // Running a whole note late only shortens the next one.
+    int32_t wait = (int32_t)(_due_us - now);
+    if (wait < 1) wait = 1;
+    _timeout.attach_us(this, &ToneSequencer::next, wait);
+}
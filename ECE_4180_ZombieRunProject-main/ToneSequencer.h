@@ -0,0 +1,124 @@
+#ifndef TONE_SEQUENCER_H
+#define TONE_SEQUENCER_H
+
+#include "mbed.h"
+
+// Longest a pulse pattern runs before it looks for new settings, ms.
+#ifndef TONE_SLICE_MS
+#define TONE_SLICE_MS 50
+#endif
+
+/** One note of a melody. */
+struct Note {
+    //! Frequency, Hz, 0 for a rest.
+    float    hz;
+    //! How long it lasts, ms.
+    uint16_t ms;
+    //! PWM duty, which sets the loudness.
+    float    duty;
+};
+
+/** A repeating beep, see ToneSequencer::setPulse(). */
+struct TonePulse {
+    float    hz;
+    uint16_t on_ms;
+    uint16_t period_ms;
+    float    duty;
+    //! When the reading behind these settings arrived, us_ticker_read().
+    uint32_t stamp_us;
+};
+
+/** ToneSequencer plays melodies on a PwmOut speaker in the background.
+ *
+ * play() sets up the first note and returns, a Timeout interrupt moves
+ * to each next note. Each note is timed from when the last one was due,
+ * not from when its interrupt ran, so lateness never adds up over a
+ * melody. How late each transition actually was is measured, the worst
+ * case is in maxJitterUs().
+ *
+ * Melodies are static const Note arrays, they stay in flash and must
+ * outlive the playing.
+ *
+ * It can also beep a pulse pattern whose pitch and rate are changed on
+ * the fly. setPulse() never waits, it fills the copy the interrupt is
+ * not using and flips to it; the interrupt runs the pattern in slices
+ * of at most TONE_SLICE_MS and picks up new settings at the next one.
+ * A change is heard at most TONE_SLICE_MS (plus jitter) after it is
+ * set, the worst seen from the settings' stamp is maxPulseLatencyUs().
+ *
+ * Example:
+ * @code
+ * static const Note beep[] = { { 500.0f, 500, 0.05f }, { 0.0f, 500, 0.0f } };
+ * ToneSequencer tones(speaker);
+ *
+ * tones.play(beep, 2, true);
+ * Thread::wait(3000);
+ * tones.stop();
+ * @endcode
+ */
+class ToneSequencer {
+public:
+
+    ToneSequencer(PwmOut &pwm);
+    
+    //! Start a melody of n notes, replacing anything playing. loop repeats it until stop().
+    void play(const Note *notes, int n, bool loop = false);
+    
+    //! Silence the speaker now.
+    void stop(void);
+    
+    //! Start beeping the pulse pattern, replacing anything playing.
+    void startPulse(void);
+    
+    //! Change the pulse pattern, safe to call at any rate, only heard after startPulse().
+    void setPulse(const TonePulse *p);
+    
+    //! Worst time from a pulse's stamp to it sounding, us.
+    uint32_t maxPulseLatencyUs(void) { return _max_pulse_latency; }
+    
+    //! True until the last note has finished.
+    bool playing(void) { return _notes != NULL; }
+    
+    //! Worst and last lateness of a note change, us.
+    uint32_t maxJitterUs(void) { return _max_jitter; }
+    uint32_t lastJitterUs(void) { return _last_jitter; }
+    
+    //! Note changes since the start.
+    uint32_t transitions(void) { return _transitions; }
+    
+    //! Forget the jitter measurements.
+    void resetStats(void) { _max_jitter = 0; _last_jitter = 0; _transitions = 0; _max_pulse_latency = 0; }
+
+protected:
+
+    PwmOut  &_pwm;
+    Timeout  _timeout;
+    
+    const Note * volatile _notes;
+    int      _n;
+    int      _i;
+    bool     _loop;
+    uint32_t _due_us;
+    
+    volatile uint32_t _max_jitter;
+    volatile uint32_t _last_jitter;
+    volatile uint32_t _transitions;
+    
+    // Pulse settings, two copies so the writer never touches the one
+    // the interrupt reads.
+    TonePulse         _pulse[2];
+    volatile int      _pulse_cur;
+    volatile uint32_t _pulse_seq;
+    volatile bool     _pulsing;
+    uint32_t          _pulse_seen;
+    uint32_t          _phase_ms;
+    uint32_t          _slice_ms;
+    float             _sounding;
+    volatile uint32_t _max_pulse_latency;
+    
+    void sound(const Note *note);
+    void next(void);
+    void pulse_step(uint32_t now);
+};
+
+#endif
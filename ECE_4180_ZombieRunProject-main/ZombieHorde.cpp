@@ -0,0 +1,185 @@
+#include "ZombieHorde.h"
+
+// Longest tick taken in one step, a stalled caller doesn't teleport the horde.
+#define HORDE_MAX_DT_MS 500
+
+// Point i of the track counting from the oldest.
+#define TRACK(i) ((_head - _points + 1 + (i) + HORDE_TRACK) % HORDE_TRACK)
+
+static uint32_t
+isqrt(uint64_t v)
+{
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+    
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+static int32_t
+hypot_mm(int32_t dx, int32_t dy)
+{
+    return (int32_t)isqrt((uint64_t)((int64_t)dx * dx + (int64_t)dy * dy));
+}
+
+ZombieHorde::ZombieHorde()
+{
+    reset(0, 0.0f);
+}
+
+void
+ZombieHorde::reset(int n, float speed)
+{
+    int32_t v = (int32_t)(speed * 1000.0f);
+    int i;
+    
+    if (n < 0) n = 0;
+    if (n > HORDE_MAX) n = HORDE_MAX;
+    _n = n;
+    _started = false;
+    _caught = false;
+    _last_ms = 0;
+    _t_ms = 0;
+    _closest = 0;
+    _leader = 0;
+    _player = 0;
+    _head = 0;
+    _points = 0;
+    
+    for (i = 0; i < HORDE_MAX; i++) {
+        // 45/50/55% walkers, 90% lungers, rhythms that drift apart.
+        _prof[i].walk       = v * (45 + 5 * (i % 3)) / 100;
+        _prof[i].sprint     = v * 90 / 100;
+        _prof[i].accel      = 1500;
+        _prof[i].period_ms  = 6000 + 1300 * i;
+        _prof[i].sprint_ms  = 1500;
+        _prof[i].head_start = 3000 + 2000 * i;
+        _pos[i] = -_prof[i].head_start;
+        _vel[i] = 0;
+    }
+    if (_n) _closest = _prof[0].head_start;
+}
+
+bool
+ZombieHorde::setProfile(int i, const ZombieProfile *p)
+{
+    // tick() takes the time modulo the period.
+    if (i < 0 || i >= HORDE_MAX || p->period_ms == 0) return false;
+    _prof[i] = *p;
+    _pos[i] = -p->head_start;
+    return true;
+}
+
+void
+ZombieHorde::record(int32_t x, int32_t y)
+{
+    int32_t s = _points ? _ts[_head] + hypot_mm(x - _tx[_head], y - _ty[_head]) : 0;
+    
+    _head = (_head + 1) % HORDE_TRACK;
+    if (_points < HORDE_TRACK) _points++;
+    _tx[_head] = x;
+    _ty[_head] = y;
+    _ts[_head] = s;
+}
+
+// Straight line mm from the player to the spot s along the track.
+int32_t
+ZombieHorde::distance(int32_t s)
+{
+    int lo, hi, mid, a, b;
+    int32_t zx, zy, len;
+    
+    a = TRACK(0);
+    if (s <= _ts[a]) {
+        return hypot_mm(_px - _tx[a], _py - _ty[a]) + (_ts[a] - s);
+    }
+    
+    if (s >= _ts[_head]) {
+        // Between the last point and the player.
+        a = _head;
+        len = _player - _ts[a];
+        zx = _tx[a];
+        zy = _ty[a];
+        if (len > 0) {
+            zx += (int32_t)((int64_t)(_px - _tx[a]) * (s - _ts[a]) / len);
+            zy += (int32_t)((int64_t)(_py - _ty[a]) * (s - _ts[a]) / len);
+        }
+        return hypot_mm(_px - zx, _py - zy);
+    }
+    
+    // The last point at or before s, then part way to the next.
+    lo = 0;
+    hi = _points - 1;
+    while (hi - lo > 1) {
+        mid = (lo + hi) / 2;
+        if (_ts[TRACK(mid)] <= s) lo = mid;
+        else hi = mid;
+    }
+    a = TRACK(lo);
+    b = TRACK(hi);
+    len = _ts[b] - _ts[a];
+    zx = _tx[a] + (int32_t)((int64_t)(_tx[b] - _tx[a]) * (s - _ts[a]) / len);
+    zy = _ty[a] + (int32_t)((int64_t)(_ty[b] - _ty[a]) * (s - _ts[a]) / len);
+    return hypot_mm(_px - zx, _py - zy);
+}
+
+void
+ZombieHorde::tick(uint32_t now_ms, float east_m, float north_m)
+{
+    int32_t target, dv, gap;
+    uint32_t dt;
+    int i;
+    
+    _px = (int32_t)(east_m * 1000.0f);
+    _py = (int32_t)(north_m * 1000.0f);
+    if (!_started) {
+        _started = true;
+        _last_ms = now_ms;
+        record(_px, _py);
+        return;
+    }
+    dt = now_ms - _last_ms;
+    _last_ms = now_ms;
+    if (dt > HORDE_MAX_DT_MS) dt = HORDE_MAX_DT_MS;
+    _t_ms += dt;
+    
+    // A step far enough from the last point is part of the track, until
+    // then the player is that far past it.
+    gap = hypot_mm(_px - _tx[_head], _py - _ty[_head]);
+    if (gap >= HORDE_STEP_MM) {
+        record(_px, _py);
+        gap = 0;
+    }
+    _player = _ts[_head] + gap;
+    
+    _closest = 0x7FFFFFFF;
+    for (i = 0; i < _n; i++) {
+        ZombieProfile *p = &_prof[i];
+        
+        target = (_t_ms % p->period_ms) < p->sprint_ms ? p->sprint : p->walk;
+        dv = (int32_t)((int64_t)p->accel * dt / 1000);
+        if (_vel[i] < target) { _vel[i] += dv; if (_vel[i] > target) _vel[i] = target; }
+        else                  { _vel[i] -= dv; if (_vel[i] < target) _vel[i] = target; }
+        
+        _pos[i] += (int32_t)((int64_t)_vel[i] * dt / 1000);
+        if (_pos[i] >= _player) {
+            _pos[i] = _player;
+            _caught = true;
+        }
+        
+        gap = distance(_pos[i]);
+        if (gap < _closest) {
+            _closest = gap;
+            _leader = i;
+        }
+    }
+    if (_n == 0) _closest = 0;
+}
@@ -0,0 +1,142 @@
+#ifndef ZOMBIE_HORDE_H
+#define ZOMBIE_HORDE_H
+
+#include "mbed.h"
+
+// Most zombies in a horde, one per Bluefruit button.
+#define HORDE_MAX 8
+
+// Points of the player's track kept, 12 bytes each. Zombies further
+// back than the oldest are placed by the distance to it.
+#ifndef HORDE_TRACK
+#define HORDE_TRACK 128
+#endif
+
+// Moves shorter than this are GPS wander, not a step along the track.
+#ifndef HORDE_STEP_MM
+#define HORDE_STEP_MM 2000
+#endif
+
+/** How one zombie moves, all integer mm and ms. */
+struct ZombieProfile {
+    //! Shambling speed, mm/s.
+    int32_t  walk;
+    //! Lunge speed, mm/s.
+    int32_t  sprint;
+    //! How fast it changes speed, mm/s/s.
+    int32_t  accel;
+    //! A lunge every period ms (not 0), lasting sprint_ms.
+    uint32_t period_ms;
+    uint32_t sprint_ms;
+    //! How far behind the player it starts, mm.
+    int32_t  head_start;
+};
+
+/** ZombieHorde chases the player along the player's own track.
+ *
+ * Each tick records where the player is, east/north of anywhere fixed,
+ * as a point of the track once they are HORDE_STEP_MM from the last
+ * one, with its distance along the track. Zombies follow in the
+ * player's footsteps, a zombie is just a distance along the track and a
+ * speed. Each tick every zombie accelerates towards its walk or lunge
+ * speed, moves, and stops if it reaches the player's distance: only
+ * following the track catches anyone, zig-zags and loops included.
+ *
+ * The closest zombie is the nearest in a straight line from the player
+ * to its spot on the track, what the player would see looking round:
+ * a loop or an out and back brings the horde close without it being
+ * any nearer to catching them. Zombies still behind the start, or
+ * behind the oldest point kept, are placed that much further back.
+ *
+ * Everything is fixed size integer arithmetic, there is no allocation
+ * and a tick costs the same for a given number of zombies (a zombie is
+ * found on the track by binary search), so a replayed GPS track gives
+ * the same chase on a host as on the mbed.
+ *
+ * Example:
+ * @code
+ * ZombieHorde horde;
+ *
+ * horde.reset(num_zombies, input_speed);
+ * while (running) {
+ *     horde.tick(now_ms(), tracker.east(), tracker.north());
+ *     if (horde.caught()) break;
+ *     pc.printf("closest %.1f m\r\n", horde.closest());
+ * }
+ * @endcode
+ */
+class ZombieHorde {
+public:
+
+    ZombieHorde();
+    
+    /** Start a new chase with n zombies (1..HORDE_MAX).
+     *
+     * The profiles are made from the chosen zombie speed: the horde
+     * walks at about half of it, like the old fixed threshold, and
+     * lunges at nearly all of it, each zombie on its own rhythm.
+     *
+     * @param n Number of zombies.
+     * @param speed The chosen zombie speed, m/s.
+     */
+    void reset(int n, float speed);
+    
+    //! Replace the profile of zombie i, call after reset(). False, and
+    //! the old one kept, for no zombie i or a period_ms of 0.
+    bool setProfile(int i, const ZombieProfile *p);
+    
+    //! Advance the horde to now_ms with the player at east_m/north_m.
+    void tick(uint32_t now_ms, float east_m, float north_m);
+    
+    //! Metres in a straight line from the player to the closest zombie (0 once caught).
+    float closest(void) { return (float)_closest * 0.001f; }
+    
+    //! Metres the player has come along the track.
+    float travelled(void) { return (float)_player * 0.001f; }
+    
+    //! Index of the closest zombie.
+    int leader(void) { return _leader; }
+    
+    //! True once any zombie has reached the player.
+    bool caught(void) { return _caught; }
+    
+    //! Number of zombies.
+    int size(void) { return _n; }
+    
+    //! Metres along the track of zombie i.
+    float position(int i) { return (float)_pos[i] * 0.001f; }
+    
+    //! Metres along the track from zombie i to the player.
+    float behind(int i) { return (float)(_player - _pos[i]) * 0.001f; }
+
+protected:
+
+    int           _n;
+    bool          _started;
+    bool          _caught;
+    uint32_t      _last_ms;
+    uint32_t      _t_ms;
+    int32_t       _closest;
+    int           _leader;
+    
+    ZombieProfile _prof[HORDE_MAX];
+    int32_t       _pos[HORDE_MAX];
+    int32_t       _vel[HORDE_MAX];
+    
+    //! The player now, mm, and how far along the track.
+    int32_t       _px;
+    int32_t       _py;
+    int32_t       _player;
+    
+    //! The track, a ring of points: mm east/north and along the track.
+    int32_t       _tx[HORDE_TRACK];
+    int32_t       _ty[HORDE_TRACK];
+    int32_t       _ts[HORDE_TRACK];
+    int           _head;
+    int           _points;
+    
+    void record(int32_t x, int32_t y);
+    int32_t distance(int32_t s);
+};
+
+#endif
@@ -1,9 +1,28 @@
+// The game. A test case is built with MBED_TEST_MODE defined and brings
+// its own main(), see TESTS/README.md.
+#ifndef MBED_TEST_MODE
+
 #include "mbed.h"
 #include "rtos.h"
 #include "PinDetect.h"
 #include "uLCD_4DGL.h"
 #include "SDFileSystem.h"
 #include "GPS.h"
+#include "DistanceEngine.h"
+#include "KalmanTracker.h"
+#include "CourseEngine.h"
+#include "ZombieHorde.h"
+#include "Route.h"
+#include "GameSession.h"
+#include "BlueParser.h"
+#include "PositionSource.h"
+#include "Telemetry.h"
+#include "GameState.h"
+#include "DisplayServer.h"
+#include "ToneSequencer.h"
+#include "SamplePlayer.h"
+#include "ProximityAudio.h"
+#include "Profiler.h"
 // #include "icm20948.h"
 
 /**
@@ -14,7 +33,7 @@ Keep a pushbutton function so that the game can be ended any time
     a. Give 10 seconds to enter the zombie numbers or choose 4 by default
 2. Player B gets countdown
     a. Also displays # of zombies
-3. Player B has to run (10 seconds)
+3. Player B has to run (10 seconds, or the intervals in rounds[])
     a. Keep a gps function thread that runs concurrently with the main thread
     b. During the 10 seconds, constantly take readings from GPS function and add to total_distance
     c. After the 10 seconds, if total_distance < input, "YOU GOT BIT :(", else "YOU SURVIVED!"
@@ -30,45 +49,69 @@ Keep a pushbutton function so that the game can be ended any time
 uLCD_4DGL uLCD(p9,p10,p11);
 // RawSerial gps(p13, p14);
 RawSerial blue(p13, p14);
+BlueParser bluefruit(blue);
+Telemetry telemetry(blue);
 PinDetect pb(p8);
 BusOut myled(LED1,LED2,LED3,LED4);
 RawSerial  pc(USBTX, USBRX); // computer
 PwmOut speaker(p26);
-GPS gps(NC, p27);
-
-union f_or_char {
-    float f;
-    char  c[4];
-};
-
-int quit_game = 0;
-
-float run_time = 10; // seconds to run
+// Owns the uLCD and pc, everything else posts to it.
+DisplayServer display(uLCD, pc);
+// Plays the beeps and tunes in the background.
+ToneSequencer tones(speaker);
+// Beeps faster and higher as the zombies close in.
+ProximityAudio proximity(tones);
+// Growls and heartbeats from the SD card, DAC on p18 into the amp.
+SDFileSystem sd(p5, p6, p7, p12, "sd");
+SamplePlayer audio(p18);
+GPS gps(p28, p27);
+Thread gps_thread;
+Thread blue_thread;
+// RTC discipline and profile reports, whenever nothing else wants the CPU.
+Thread service_thread(osPriorityLow, 1024);
+DistanceEngine distance;
+KalmanTracker tracker;
+CourseEngine course;
+PositionSource position;
+ZombieHorde horde;
+// Checkpoints from /sd/route.txt, 14KB so it has the spare AHB bank to itself.
+Route route __attribute__((section("AHBSRAM1")));
+Timer game_clock;
+GameSession session;
+
+// Shared between the game, GPS and Bluefruit threads and the quit button.
+GameState state;
+
+// Run/rest intervals of a round in ms, e.g. three one minute runs with
+// half a minute to recover between them:
+// { { 60000, 30000 }, { 60000, 30000 }, { 60000, 0 } }
+const SessionInterval rounds[] = { { 10000, 0 } };
 
 // OPTION 1 -- GPS MODULE
 char ns, ew, tf, status, c;
 int fq, nst, fix, date;                                     // fix quality, Number of satellites being tracked, 3D fix
-float latitude, longitude, old_lat, old_lon, timefix, speed, altitude;
+float latitude, longitude, timefix, speed, altitude;
 char cDataBuffer[500];
 
 float gps_reading = 0.0;
 #define PI 3.14159
+#define GPS_SIG_GGA 0x1
+#define GPS_SIG_VTG 0x2
+#define GPS_SIG_PHONE 0x4
+#define SERVICE_SIG_PROFILE 0x1
+#define SERVICE_SIG_RESET 0x2
+#define RTC_SYNC_MS 10000
+
+// Location packets from the app on their way to readGPS.
+Mail<BlueEvent, 4> phone_fixes;
 unsigned long p_buff[4];
 
 // OPTION 2 -- IMU
 float prevAccX = 0.0f, prevAccY = 0.0f, prevAccZ = 0.0f;
 
 int count = 0;
-Mutex lcd_mutex;
 
 Timer timer;
-int num_zombies = 4;
-
-/*
-0 = picking zombies
-1 = running
-*/
-int game_mode = 0;
 
 /**
 Speeds to select from
@@ -83,10 +126,6 @@ float s6 = 2.2;
 float s7 = 2.4;
 float s8 = 2.6;
 
-float input_speed = s4;
-
-float ran;
-
 /** SPEAKER TONES */
 #define NOTE_C4  261.63
 #define NOTE_E4  329.63
@@ -95,281 +134,368 @@ float ran;
 #define NOTE_E3  164.81
 #define NOTE_D3  146.83
 
+static const Note countdown_beeps[] = {
+    { 500.0f, 500, 0.05f }, { 0.0f, 500, 0.0f },
+    { 500.0f, 500, 0.05f }, { 0.0f, 500, 0.0f },
+    { 500.0f, 500, 0.05f }, { 0.0f, 500, 0.0f },
+    { 500.0f, 500, 0.05f }, { 0.0f, 500, 0.0f },
+    { 500.0f, 500, 0.05f }, { 0.0f, 500, 0.0f },
+};
+
+static const Note caught_tune[] = {
+    { NOTE_A3, 1000, 0.05f },
+    { NOTE_E3, 1000, 0.05f },
+    { NOTE_D3, 1000, 0.05f },
+};
+
+static const Note safe_tune[] = {
+    { NOTE_C4, 1000, 0.05f },
+    { NOTE_E4, 1000, 0.05f },
+    { NOTE_G4, 1000, 0.05f },
+};
+
+#define NOTES(tune) (sizeof(tune) / sizeof(tune[0]))
+
 void quit(void) {
     myled[3] = 1;
-    quit_game = 1;
+    state.setQuit();
+    session.signal(SESSION_SIG_QUIT);
 }
 
 // WELCOME SCREEN
 void setup_screen(void) {
-    lcd_mutex.lock();
-    uLCD.background_color(WHITE);
-    uLCD.cls();
-
-    uLCD.color(GREEN);
-    uLCD.text_width(2);
-    uLCD.text_height(2);
-
-    // Print the welcome message
-    uLCD.printf("\n\nZOMBIE\nGAME");
-    wait(5);
-    lcd_mutex.unlock();
+    // Print the welcome message, green on white
+    display.screen(WHITE, GREEN, 2, "\n\nZOMBIE\nGAME");
+    Thread::wait(5000);
 }
 
 /** https://os.mbed.com/users/4180_1/notebook/adafruit-bluefruit-le-uart-friend---bluetooth-low-/ */
-void blue_thread_button(const void args) {
-    char bnum=0;
-    char bhit=0;
-    char bchecksum=0;
-    char temp=0;
-    union f_or_char x,y,z;
-    float a;
+// Applies player A's control pad presses, sleeps until bluefruit has one.
+void blue_thread_button() {
+    BlueEvent evt;
+    GameSettings set;
 
+    Profiler::attach("blue", &blue_thread);
     while(1) {
-        while (!blue.readable()) {
-            //pc.printf("Unreadable\n");
-        }
-        // pc.printf("Readable\n");
-        // lcd_mutex.lock();        
-        if (blue.getc()=='!') {
-            myled[0] = 1;
-            if ((blue.getc()=='B')) { //button data packet
-                // pc.printf("Receiving button input\n");
-                bnum = blue.getc(); //button number
-                bhit = blue.getc(); //1=hit, 0=release
-                myled[1] = 1;
-                if (blue.getc()==char(~('!' + 'B' + bnum + bhit))) { //checksum OK?
-                    myled = bnum - '0'; //current button number will appear on LEDs
-                    switch (bnum) {
-                        case '1': //number button 1
-                            if (bhit == '1') {
-                                input_speed = s1;
-                                num_zombies = 1;
-                                // myled[1] = 1;
-                            } else {
-                                // myled[1] = 0;
-                            }
-                            
-                            // myled[1]=1;
-                            break;
-                        case '2': //number button 2
-                            if (bhit == '1') {
-                                input_speed = s2;
-                                num_zombies = 2;
-                                // myled[2] = 1;
-                            } else {
-                                // myled[2] = 0;
-                            }
-                            // myled[bnum-'1']=blue.getc()-'0';
-                            break;
-                        case '3': //number button 3
-                            if (bhit == '1') {
-                                input_speed = s3;
-                                num_zombies = 3;
-                                // myled[3] = 1;
-                            } else {
-                                // myled[3] = 0;
-                            }
-                            // myled[bnum-'1']=blue.getc()-'0';
-                            break;
-                        case '4': //number button 4
-                            if (bhit == '1') {
-                                input_speed = s4;
-                                num_zombies = 4;
-                                // myled[3] = 1;
-                            } else {
-                                // myled[3] = 0;
-                            }
-                            // myled[bnum-'1']=blue.getc()-'0';
-                            break;
-                        case '5': //button 5 up arrow
-                            if (bhit=='1') {
-                                input_speed = s5;
-                                num_zombies = 5;
-                            }
-                            break;
-                        case '6': //button 6 down arrow
-                            if (bhit=='1') {
-                                input_speed = s6;
-                                num_zombies = 6;
-                            }
-                            break;
-                        case '7': //button 7 left arrow
-                            if (bhit=='1') {
-                                input_speed = s7;
-                                num_zombies = 7;
-                            }
-                            break;
-                        case '8': //button 8 right arrow
-                            if (bhit=='1') {
-                                input_speed = s8;
-                                num_zombies = 8;
-                            }
-                            break;
-                        default:
-                            input_speed = s4;
-                            num_zombies = 4;
-                            break;
-                    }
-                }
+        if (!bluefruit.get(&evt)) continue;
+        if (evt.type == 'L') {
+            BlueEvent *loc = phone_fixes.alloc(0);
+            if (loc != NULL) {
+                *loc = evt;
+                phone_fixes.put(loc);
+                gps_thread.signal_set(GPS_SIG_PHONE);
             }
+            continue;
+        }
+        if (evt.type != 'B') continue;
+        myled = evt.button - '0'; //current button number will appear on LEDs
+        if (!evt.pressed) continue;
+        switch (evt.button) {
+            case '1': //number button 1
+                set.speed = s1;
+                set.zombies = 1;
+                break;
+            case '2': //number button 2
+                set.speed = s2;
+                set.zombies = 2;
+                break;
+            case '3': //number button 3
+                set.speed = s3;
+                set.zombies = 3;
+                break;
+            case '4': //number button 4
+                set.speed = s4;
+                set.zombies = 4;
+                break;
+            case '5': //button 5 up arrow
+                set.speed = s5;
+                set.zombies = 5;
+                break;
+            case '6': //button 6 down arrow
+                set.speed = s6;
+                set.zombies = 6;
+                break;
+            case '7': //button 7 left arrow
+                set.speed = s7;
+                set.zombies = 7;
+                break;
+            case '8': //button 8 right arrow
+                set.speed = s8;
+                set.zombies = 8;
+                break;
+            default:
+                set.speed = s4;
+                set.zombies = 4;
+                break;
         }
+        // The zombie count and speed always change together.
+        state.settings.publish(set);
     }
 }  
 
 void zombie_select_screen() {
-    lcd_mutex.lock();
-    uLCD.background_color(WHITE); // set background color to white
-    uLCD.cls(); // clear the screen
-    Timer t1;
-
-    // Set the font color and size
-    uLCD.color(GREEN);
-    uLCD.text_width(2);
-    uLCD.text_height(2);
-
     // Print the message
-    uLCD.printf("\n\n Select number\nof zombies...");
-    lcd_mutex.unlock();
+    display.screen(WHITE, GREEN, 2, "\n\n Select number\nof zombies...");
 
-    t1.start();
     speed = s4;
 
-    while (t1.read() < 10) {
-        // collect player A's inputs from the blue_thread
-        wait(0.1);
-    }
-
-    t1.stop();
-    
+    // collect player A's inputs from the blue_thread
+    session.sleep(10000);
 }
 
 void run_countdown_screen() {
-    lcd_mutex.lock();
-    uLCD.background_color(WHITE); // set background color to white
-    uLCD.cls(); // clear the screen
-
-    // Set the font color and size
-    uLCD.color(GREEN);
-    uLCD.text_width(2);
-    uLCD.text_height(2);
+    GameSettings set;
+    state.settings.consume(&set);
+    int num_zombies = set.zombies;
 
     // Display the initial message
-    uLCD.printf("\n\nThere are %d Zombies\n chasing you!", num_zombies);
-    wait(1.0);
-
-    speaker.period(1.0/500);
-    speaker = 0.05;
+    display.screen(WHITE, GREEN, 2, "\n\nThere are %d Zombies\n chasing you!", num_zombies);
+    Thread::wait(1000);
 
-    // Countdown loop
+    // Countdown loop, a beep each second in the background
+    tones.play(countdown_beeps, NOTES(countdown_beeps));
     for (int i = 5; i > 0; i--) {
-        uLCD.cls(); // clear the screen
-        uLCD.printf("\n\nThere are %d Zombies\n chasing you!\n\n %d", num_zombies, i);
-        wait(0.5);
-        speaker = 0.0;
-        wait(0.5);
-        speaker = 0.05;
+        display.screen(WHITE, GREEN, 2, "\n\nThere are %d Zombies\n chasing you!\n\n %d", num_zombies, i);
+        Thread::wait(1000);
     }
 
-    speaker = 0.0;
-
     // Display final message
-    uLCD.cls(); // clear the screen
-    uLCD.printf("\n\nThere are %d Zombies\n chasing you!\n\n Go!", num_zombies);
-    game_mode = 1;
-    wait(1.0);
-    lcd_mutex.unlock();
+    display.screen(WHITE, GREEN, 2, "\n\nThere are %d Zombies\n chasing you!\n\n Go!", num_zombies);
+    Thread::wait(1000);
 }
 
 void running() {
-    lcd_mutex.lock();
-    uLCD.cls();
-    uLCD.printf("\n\n    RUN!    \n\n");
-    lcd_mutex.unlock();
-    ran = 0.0; // distance covered by player B
-    Timer t1;
-    Timer t2;
-    game_mode = 1;
-
-    // wait(60);
-    t1.start();
-    while (t1.read() < run_time) {
-        // pc.printf("Ran: %f", ran);
+    display.screen(WHITE, GREEN, 2, "\n\n    RUN!    \n\n");
+    GameProgress progress = { 0.0f, 0.0f, 0.0f, false };
+    // readGPS resets the engines and the horde when it sees the new run.
+    state.startRun();
+    game_clock.reset();
+    GameSession::idleStart();
+
+    // Sleep through each phase, the timer, the quit button or the horde
+    // wakes us. The zombies stand still while player B rests.
+    for (int i = 0; i < session.intervals() && !state.quit(); i++) {
+        const SessionInterval *iv = session.interval(i);
+
+        if (i > 0) {
+            display.screen(WHITE, GREEN, 2, "\n\n    RUN!    \n\n");
+        }
+        game_clock.start();
+        proximity.start();
+        state.setMode(1);
+        session.arm(iv->run_ms);
+        int32_t why = session.waitFor(SESSION_SIG_PHASE | SESSION_SIG_QUIT | SESSION_SIG_CAUGHT);
+        session.disarm();
+        state.setMode(0);
+        game_clock.stop();
+        tones.stop();
+
+        state.progress.consume(&progress);
+        if (why != SESSION_SIG_PHASE || progress.caught) break;
+        if (iv->rest_ms > 0 && i + 1 < session.intervals()) {
+            display.screen(WHITE, GREEN, 2, "\n\n    REST    \n\n");
+            session.sleep(iv->rest_ms);
+        }
     }
-    t1.stop();
-    ran *= 10000;
-    
-    // pc.printf("Player B ran: %f\n", ran);
-    game_mode = 0;
 
-    lcd_mutex.lock();
-    if (ran < (input_speed * run_time)/2) {
-        uLCD.cls();
-        uLCD.printf("\n\n   YOU GOT CAUGHT :(   \n\n");
-        speaker.period(1.0 / NOTE_A3);
-        speaker = 0.05; 
-        wait(1);
+    // The current is modelled from the idle time, see modelMa().
+    display.log(DISPLAY_SLOT_NONE, "Ran %.0f s  idle %.1f%%  board ~%.0f mA (model)\n\r",
+        game_clock.read(), GameSession::idlePercent(), GameSession::modelMa());
+
+    if (progress.caught) {
+        display.screen(WHITE, GREEN, 2, "\n\n   YOU GOT CAUGHT :(   \n\n");
+        tones.play(caught_tune, NOTES(caught_tune));
+        audio.play("/sd/growl.wav");
+    } else {
+        display.screen(WHITE, GREEN, 2, "\n\n   GOOD JOB! You reached safety   \n\n");
+        tones.play(safe_tune, NOTES(safe_tune));
+    }
+    // 3 s of tune then the result stays up
+    Thread::wait(10000);
+
+    display.screen(WHITE, GREEN, 2, "\n\n   COOLDOWN    \n\nPress button to Quit\n");
+    session.sleep(5000);
+    display.log(DISPLAY_SLOT_NONE, "display: queue %d  %u us max  %u dropped  %u coalesced\n\r",
+        display.maxDepth(), display.maxLatencyUs(), display.dropped(), display.coalesced());
+    display.log(DISPLAY_SLOT_NONE, "tones: %u changes  jitter %u us max  proximity %u updates  %u us max\n\r",
+        tones.transitions(), tones.maxJitterUs(), proximity.changes(), tones.maxPulseLatencyUs());
+    display.log(DISPLAY_SLOT_NONE, "audio: %u underruns  %u over budget  %u%% worst refill\n\r",
+        audio.underruns(), audio.overBudget(), audio.maxLoadPct());
+}
+
+// Called from the MODGPS ticker once a GGA sentence has been parsed.
+void gga_received(void) {
+    gps_thread.signal_set(GPS_SIG_GGA);
+}
 
-        speaker.period(1.0 / NOTE_E3);
-        wait(1);
+// Called from the MODGPS ticker once a VTG sentence has been parsed.
+void vtg_received(void) {
+    gps_thread.signal_set(GPS_SIG_VTG);
+}
 
-        speaker.period(1.0 / NOTE_D3);
-        wait(1);
+// 'p' on the pc terminal prints the profile, 'r' starts it over.
+void pc_received(void) {
+    while (pc.readable()) {
+        char c = pc.getc();
+        if (c == 'p') service_thread.signal_set(SERVICE_SIG_PROFILE);
+        if (c == 'r') service_thread.signal_set(SERVICE_SIG_RESET);
+    }
+}
 
-        speaker = 0.0;
+void print_profile() {
+    char line[PROFILE_LINE];
 
-        wait(7);
-        
-    } else {
-        uLCD.cls();
-        uLCD.printf("\n\n   GOOD JOB! You reached safety   \n\n");
-        speaker.period(1.0 / NOTE_C4);
-        speaker = 0.05; 
-        wait(1);
-        
-        speaker.period(1.0 / NOTE_E4);
-        wait(1);
-        
-        speaker.period(1.0 / NOTE_G4);
-        wait(1);
+    for (int i = 0; i < Profiler::lines(); i++) {
+        Profiler::line(i, line, sizeof(line));
+        display.log(DISPLAY_SLOT_NONE, "%s\n\r", line);
+    }
+}
 
-        speaker = 0.0;
+// Keeps the RTC on GPS time, well away from the GPS ticker interrupt,
+// and prints the profile when asked.
+void service() {
+    osEvent evt;
+    uint32_t synced_us = us_ticker_read();
 
-        wait(7);
+    Profiler::attach("service", &service_thread);
+    while(1) {
+        uint32_t since_ms = (us_ticker_read() - synced_us) / 1000;
+        evt = Thread::signal_wait(0, since_ms < RTC_SYNC_MS ? RTC_SYNC_MS - since_ms : 0);
+        if (evt.status != osEventSignal) {
+            gps.rtcDiscipline();
+            synced_us = us_ticker_read();
+            continue;
+        }
+        if (evt.value.signals & SERVICE_SIG_PROFILE) print_profile();
+        if (evt.value.signals & SERVICE_SIG_RESET) Profiler::reset();
     }
+}
 
-    uLCD.cls();
-    uLCD.printf("\n\n   COOLDOWN    \n\nPress button to Quit\n");
-    t2.start();
-    while (t2.read() < 5) {
-        wait(0.1);
+// ms since boot, wrapping at 2^32 ms rather than with us_ticker, whose
+// us_ticker_read() / 1000 jumps back to 0 at 4294967 ms (71.6 minutes).
+// Only readGPS calls it, and at least once each wrap of us_ticker.
+uint32_t now_ms() {
+    static uint32_t last_us = 0;
+    static uint64_t us = 0;
+    uint32_t now = us_ticker_read();
+
+    us += now - last_us;
+    last_us = now;
+    return (uint32_t)(us / 1000);
+}
+
+// Runs one fix, from the module or the phone, through the distance pipeline.
+void use_fix(GPS_Geodetic *fix) {
+    // Fixes carry the time they were measured and the filter only moves
+    // between those stamps, so dt is true even when this thread was late
+    // picking them up.
+    tracker.position(fix->lat, fix->lon, fix->hdop, fix->gps_satellite_quality, fix->timestamp_us);
+
+    // Only fixes good enough to beat the jitter count towards the raw distance.
+    // The game is won on the progress along the course, zig-zags don't count.
+    if (state.mode() == 1) {
+        distance.update(fix->lat, fix->lon, fix->hdop, fix->gps_satellite_quality);
+        course.update(fix->lat_e7, fix->lon_e7, (int)(fix->hdop * 10.0 + 0.5), fix->gps_satellite_quality);
+        if (route.update(fix->lat_e7, fix->lon_e7)) {
+            display.log(DISPLAY_SLOT_NONE, "checkpoint %d of %d\n\r", route.reached(), route.size());
+        }
     }
-    t2.stop();
 
-    lcd_mutex.unlock();
-    
+    // Each status line replaces one the display server has not printed yet.
+    display.log(DISPLAY_SLOT_STATUS, "Latitude = %f  Longitude = %f  HDOP = %.1f  raw = %.1f m  kf = %.1f m  course = %.1f m  zombie = %.1f m  %.2f m/s  %u cyc\n\r",
+        fix->lat, fix->lon, fix->hdop, distance.metres(), tracker.metres(), course.best(), horde.closest(), tracker.speed(), tracker.maxCycles());
+}
+
+// A new run, readGPS owns everything that tracks it so it resets it all here.
+void start_run() {
+    GameSettings set;
+    GameProgress progress = { 0.0f, 0.0f, 0.0f, false };
+
+    state.settings.consume(&set);
+    distance.reset();
+    tracker.resetDistance();
+    course.reset(); // the safe zone is wherever player B first heads
+    route.restart();
+    horde.reset(set.zombies, set.speed);
+    telemetry.reset();
+    state.progress.publish(progress);
 }
 
 //Read GPS to get current longitude and latitude and also calculate distance traveled
 void readGPS() {
+    GPS_Geodetic fix;
+    GPS_VTG vel;
+    osEvent evt;
+    osEvent mail;
+    PositionSample s;
+    GameProgress progress;
+    uint32_t run = state.run();
+
+    Profiler::attach("gps", &gps_thread);
     while(1) {
-        // if (gps) {
-        lcd_mutex.lock();
-        double latitude  = gps.latitude();
-        double longitude = gps.longitude();
-        double altitude  = gps.altitude();
-        pc.printf("Latitude = %f  Longitude = %f  Altitude = %f\n\r",latitude, longitude,altitude);
-        lcd_mutex.unlock();
-
-        if(latitude != 0 && longitude != 0 && old_lat != 0 && old_lon != 0) {
-            float a = sinf(old_lat)*sinf(latitude)+cosf(old_lat)*cosf(latitude)*cosf(longitude-old_lon);
-            if(a > 1) a = 0.5;
-            ran += (.75*acosf(a));
+        // Sleep until a sentence has been parsed or it is time to output.
+        evt = Thread::signal_wait(0, tracker.outputPeriodMs());
+        // When the newest reading used was stamped, the wake if there was
+        // none, it may have been the output timeout.
+        uint32_t reading_us = us_ticker_read();
+        if (state.run() != run) {
+            run = state.run();
+            start_run();
+        }
+
+        if (evt.status == osEventSignal && (evt.value.signals & GPS_SIG_GGA)) {
+            gps.geodetic(&fix);
+            s.lat_e7 = fix.lat_e7;
+            s.lon_e7 = fix.lon_e7;
+            s.alt = fix.alt;
+            s.hdop = fix.hdop;
+            s.quality = fix.gps_satellite_quality;
+            s.stamp_us = fix.timestamp_us;
+            if (position.ingest(positionModule, &s, &fix)) {
+                use_fix(&fix);
+                reading_us = s.stamp_us;
+            }
+        }
+        // Both sources go to the selector, it follows one at a time.
+        if (evt.status == osEventSignal && (evt.value.signals & GPS_SIG_PHONE)) {
+            while ((mail = phone_fixes.get(0)).status == osEventMail) {
+                BlueEvent *loc = (BlueEvent *)mail.value.p;
+                s.lat_e7 = (int32_t)(loc->v[0] * 1e7);
+                s.lon_e7 = (int32_t)(loc->v[1] * 1e7);
+                s.alt = loc->v[2];
+                s.hdop = 0.0f; // the app doesn't send its accuracy
+                s.quality = 1;
+                s.stamp_us = loc->stamp_us;
+                phone_fixes.free(loc);
+                if (position.ingest(positionPhone, &s, &fix)) {
+                    use_fix(&fix);
+                    reading_us = s.stamp_us;
+                }
+            }
+        }
+        if (evt.status == osEventSignal && (evt.value.signals & GPS_SIG_VTG)) {
+            gps.vtg(&vel);
+            tracker.velocity(vel.velocity_kph(), vel.track_true(), vel.timestamp_us);
+        }
+
+        // Outputs for now, extrapolated; the filter stays at the last fix's stamp.
+        tracker.advance(us_ticker_read());
+        
+        // The horde moves on every wake, not just on fixes, following
+        // the filtered track so the fix noise doesn't add to it.
+        if (state.mode() == 1) {
+            horde.tick(game_clock.read_ms(), tracker.east(), tracker.north());
+            progress.ran = course.best(); // metres made good towards the safe zone
+            progress.gap = horde.closest();
+            progress.speed = tracker.speed();
+            progress.caught = horde.caught();
+            state.progress.publish(progress);
+            if (progress.caught) session.signal(SESSION_SIG_CAUGHT);
+            proximity.update(progress.gap, reading_us);
+            // Progress to the phone, the uplink keeps itself inside its budget.
+            telemetry.sample(now_ms(), progress.ran, progress.speed, progress.gap, session.remainingMs());
         }
-        old_lat = latitude;
-        old_lon = longitude;
     }
-    Thread::wait(1000);
 }
     
 int main() {
@@ -377,30 +503,69 @@ int main() {
     pb.mode(PullUp);
     pb.attach_deasserted(&quit);
     pb.setSampleFrequency();
+    session.attach(osThreadGetId());
+    session.configure(rounds, sizeof(rounds) / sizeof(rounds[0]));
 
     uLCD.cls();
-    quit_game = 0;
     
     blue.baud(9600);
     gps.baud(9600);
-    pc.baud(9600);
+    pc.baud(115200); // fast enough for the 10Hz GPS log
+    display.start();
+    // SDFileSystem reads at 1MHz, where a 512 byte sector takes over 4ms,
+    // a quarter of the 16ms a 256 sample half plays for at 16kHz and past
+    // the player's 15% refill budget. At 12MHz it is about 0.4ms, and
+    // TESTS/audio/player checks the refills stay on budget.
+    sd.set_transfer_sck(12000000);
+    audio.start();
+
+    // An escape route on the card, the run shows its checkpoints as they
+    // are reached. Loaded before the GPS thread that follows it starts.
+    FILE *fp = fopen("/sd/route.txt", "r");
+    if (fp != NULL) {
+        display.log(DISPLAY_SLOT_NONE, "route: %d checkpoints\n\r", route.load(fp));
+        fclose(fp);
+    }
+
+    // The GT-U7 is a u-blox 7. 10Hz does not fit in 9600 baud, so raise
+    // that first. Prefer the binary NAV-PVT solution, fall back to text
+    // if the firmware does not have it: GGA+VTG for the fix, and RMC, the
+    // only sentence with the date, for the clock, RTC and time fixes.
+    gps.setConfigProtocol(GPS::cfgUBX);
+    bool gps_ok = gps.setReceiverBaud(38400);
+    if (gps_ok) {
+        if (gps.setUbxPvt(true)) {
+            gps_ok = gps.setSentences(0);
+        } else {
+            gps_ok = gps.setSentences(GPS_MSG_GGA | GPS_MSG_VTG | GPS_MSG_RMC);
+        }
+    }
+    if (!gps_ok || !gps.setUpdateRate(10)) {
+        display.log(DISPLAY_SLOT_NONE, "GPS configuration failed, using receiver defaults\n\r");
+    }
 
     
 
     speaker.period(1.0/500.0);
 
-    Thread t1;
-    Thread t2;
-
-    t1.start(readGPS);
-    t2.start(blue_thread_button);
+    // GT-U7 1PPS (rising edge), sharpens the fix timestamps if wired.
+    gps.ppsAttach(p29);
+    gps.attach_gga(&gga_received);
+    gps.attach_vtg(&vtg_received);
+    Profiler::attach("main");
+    Profiler::start();
+    gps_thread.start(readGPS);
+    service_thread.start(service);
+    bluefruit.start();
+    blue_thread.start(blue_thread_button);
+    pc.attach(&pc_received);
 
-    wait(3);
+    Thread::wait(3000);
 
     setup_screen();
 
     // Wait for player A's input every 15 seconds
-    while (quit_game == 0) {
+    while (!state.quit()) {
         // // 1. Player A enters number of zombies
         // //      a. Give 10 seconds or enter 4 by default
         zombie_select_screen();
@@ -413,13 +578,9 @@ int main() {
         running();
     }
     
-    lcd_mutex.lock();
-    uLCD.cls();
-    uLCD.color(GREEN);
-    uLCD.text_height(1);
-    uLCD.text_width(1);
-    uLCD.printf("\n\nThanks For Playing!\n\n");
-    lcd_mutex.unlock();
+    display.screen(WHITE, GREEN, 1, "\n\nThanks For Playing!\n\n");
 
     return 0;
 }
+
+#endif // MBED_TEST_MODE